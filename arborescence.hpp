@@ -17,11 +17,42 @@
 #define GROUND_HEIGHT 32
 #define GROUND_LEVEL  (SCREEN_HEIGHT - GROUND_HEIGHT - GROUND_HEIGHT)
 #define BRANCHES_MAX  3
-#define TREES_MAX     8
+
+/* The world is wider than the screen; the frame wraps around horizontally. */
+#define FRAME_WIDTH   (SCREEN_WIDTH + 80)
+#define TITLE_HEIGHT  18
+#define CAMERA_STEP   1
+#define SCROLL_GROUP_WORLD  1
+
+/* And it's endless; generated in chunks, as the camera reaches them. */
+#define WORLD_SEED          0x41524230
+#define CHUNK_WIDTH         240
+#define CHUNK_CACHE_SIZE    6
+#define CHUNK_TREES_MAX     3
+#define CHUNK_STARS_MAX     34
+#define TERRAIN_RISE_MAX    16
+#define GROUND_TOP          (GROUND_LEVEL - TERRAIN_RISE_MAX)
 
 #define AGE_GROWTH    20
 #define AGE_DEATH     80
 
+/* Outer branches come from a shared library of patterns, rather than each tree. */
+#define FOREST_PATTERNS 1
+
+#define STATS_INTERVAL  600
+#define BENCH_AT_BOOT   0     /* Otherwise, send a 'b' over the UART. */
+#define PROFILE_AT_BOOT 0     /* Or a 'p', to start and stop profiling. */
+
+/* Drop the system clock when frames are quiet; trace prints every decision. */
+#define CLOCK_GOVERNOR  1
+#define GOVERNOR_TRACE  0
+
+/* Keep the last few frames in a ring, and send them over the UART if one runs slow. */
+#define FLIGHT_RECORDER 1
+
+/* Step along curves with the interpolators, rather than in software. */
+#define RASTER_INTERP   1
+
 #define SPRITE_SUN    0
 #define SPRITE_MOON   1
 #define SPRITE_CLOUDL 2
@@ -30,6 +61,15 @@
 #define SPRITE_BIRD1  4
 #define SPRITE_BIRD2  5
 #define SPRITE_BIRD3  6
+#define SPRITE_TITLE  8     /* The title is cut into tiles, one sprite each. */
+#define SPRITE_HALO_SUN   20  /* And the halos are four tiles each. */
+#define SPRITE_HALO_MOON  24
+#define HALO_TILE_SIZE    32
+
+/* The moon steps through its phases, one a day. */
+#define MOON_PHASES   16
+#define MOON_SIZE     32
+#define MOON_RADIUS   14
 
 
 /* Structures. */
@@ -44,5 +84,10 @@ typedef struct
 
 /* Function prototypes. */
 
+uint32_t  random_hash( uint32_t, uint32_t );
+uint32_t  random_next( uint32_t * );
+void      halo_generate( uint16_t *, uint8_t, uint8_t, uint8_t, int_fast16_t );
+void      moon_phase( uint16_t *, const uint16_t *, uint_fast8_t );
+
 
 /* End of file arborescence.hpp */
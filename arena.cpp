@@ -0,0 +1,134 @@
+/*
+ * arena.cpp - part of Arborescence
+ *
+ * Implements the FrameArena class. Anything that needs scratch memory while
+ * a frame is being built takes it from here, rather than going anywhere near
+ * malloc in the frame loop; it's all given back in one go when the arena is
+ * reset at the top of the main loop.
+ *
+ * There are two banks, used by alternate frames. The drawing of one frame on
+ * core 1 overlaps with the building of the next on core 0, so anything handed
+ * to the render queue stays valid until the frame after next starts.
+ *
+ * Running out is not fatal; alloc returns nullptr, and callers are expected
+ * to fall back to something slower, or simply try again next frame.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "arena.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; starts off with an empty first bank.
+ */
+
+FrameArena::FrameArena( void )
+{
+  this->mBank = 0;
+  this->mUsed = 0;
+  this->mPeak = 0;
+  this->mOverflows = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * reset; switches over to the other bank, and empties it. This must only be
+ *        called once the frame that last used that bank has been drawn.
+ */
+
+void FrameArena::reset( void )
+{
+  this->mBank = ( this->mBank + 1 ) % ARENA_BANKS;
+  this->mUsed = 0;
+}
+
+
+/*
+ * alloc; hands out a block of the current bank, word aligned. Returns nullptr
+ *        (and counts the overflow) if there isn't enough room left.
+ */
+
+void *FrameArena::alloc( uint32_t pSize )
+{
+  void *lBlock;
+
+  /* Round up, so that the next block is aligned too. */
+  pSize = ( pSize + 3 ) & ~3u;
+  if ( pSize > ARENA_SIZE - this->mUsed )
+  {
+    this->mOverflows++;
+    return nullptr;
+  }
+
+  /* Bump along, and keep track of the most we've ever needed. */
+  lBlock = &this->mBanks[this->mBank][this->mUsed / 4];
+  this->mUsed += pSize;
+  if ( this->mUsed > this->mPeak )
+  {
+    this->mPeak = this->mUsed;
+  }
+
+  return lBlock;
+}
+
+
+/*
+ * mark; returns the current position in the bank, so that short-lived
+ *       scratch space can be handed back with release.
+ */
+
+uint32_t FrameArena::mark( void )
+{
+  return this->mUsed;
+}
+
+
+/*
+ * release; hands back everything allocated since the given mark. Nothing in
+ *          there must have been passed on to the render queue.
+ */
+
+void FrameArena::release( uint32_t pMark )
+{
+  if ( pMark < this->mUsed )
+  {
+    this->mUsed = pMark;
+  }
+}
+
+
+/*
+ * stats; reports the size of each bank, the most that has been used and how
+ *        often we've run out. Optionally resets the peak and overflow count.
+ */
+
+void FrameArena::stats( arena_stats_t *pStats, bool pReset )
+{
+  pStats->size = ARENA_SIZE;
+  pStats->peak = this->mPeak;
+  pStats->overflows = this->mOverflows;
+
+  if ( pReset )
+  {
+    this->mPeak = this->mUsed;
+    this->mOverflows = 0;
+  }
+}
+
+/* End of file arena.cpp */
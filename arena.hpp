@@ -0,0 +1,56 @@
+/*
+ * arena.hpp - part of Arborescence
+ *
+ * This header declares the FrameArena class; a pair of fixed blocks of
+ * scratch memory, handed out a bump at a time while a frame is being built,
+ * and thrown away wholesale once that frame has been drawn.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define ARENA_SIZE        8192      /* Per bank; must be a multiple of four. */
+#define ARENA_BANKS       2
+
+
+/* Structures. */
+
+typedef struct
+{
+  uint32_t        size;
+  uint32_t        peak;
+  uint32_t        overflows;
+} arena_stats_t;
+
+
+/* Class declaration. */
+
+class FrameArena
+{
+private:
+  uint32_t                              mBanks[ARENA_BANKS][ARENA_SIZE/4];
+  uint_fast8_t                          mBank;
+  uint32_t                              mUsed;
+  uint32_t                              mPeak;
+  uint32_t                              mOverflows;
+
+public:
+                  FrameArena( void );
+
+  void            reset( void );
+  void           *alloc( uint32_t );
+  uint32_t        mark( void );
+  void            release( uint32_t );
+  void            stats( arena_stats_t *, bool );
+};
+
+/* End of file arena.hpp */
@@ -0,0 +1,488 @@
+/*
+ * bench.cpp - part of Arborescence
+ *
+ * Implements the Bench class. Each workload draws through the render queue,
+ * exactly as the world does, and is timed from the moment the queue is idle
+ * until core 1 has drawn the last of it; so the timings include the real
+ * PSRAM and display driver costs, not just our own code.
+ *
+ * Every workload is seeded the same way, so runs on different boards (or
+ * different builds) can be compared directly. Each is run a few times, and
+ * the fastest run is reported.
+ *
+ * Workloads are counted in cycles by SysTick, which is borrowed from the
+ * profiler (if it's running) for the duration. It's only 24 bits though, so
+ * anything longer than that can only be worked out from the microseconds;
+ * those are marked with a ~.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "arena.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
+#include "tree.hpp"
+#include "bench.hpp"
+
+#include "sprite_moon.hpp"
+
+
+/* Module variables. */
+
+static const bench_workload_t m_workloads[] =
+{
+  { "sky fill",         &Bench::sky_fill,         1 },
+  { "ground gradient",  &Bench::ground_gradient,  1 },
+  { "thick lines",      &Bench::thick_lines,      200 },
+  { "thick curves",     &Bench::thick_curves,     200 },
+  { "thin lines",       &Bench::thin_lines,       400 },
+  { "thin curves",      &Bench::thin_curves,      400 },
+  { "leaf circles",     &Bench::leaf_circles,     200 },
+  { "forest age 8",     &Bench::forest,           8 },
+  { "forest age 12",    &Bench::forest,           12 },
+  { "forest age 20",    &Bench::forest,           20 },
+  { "forest age 60",    &Bench::forest,           60 },
+  { "moon phase",       &Bench::moon_phases,      1 },
+};
+
+
+/* Functions. */
+
+
+/*
+ * constructor; saves the queue we draw through, and the arena for scratch.
+ */
+
+Bench::Bench( RenderQueue *pQueue, FrameArena *pArena )
+{
+  /* Save the references we're given. */
+  this->mQueue = pQueue;
+  this->mArena = pArena;
+  this->mRandom = BENCH_SEED;
+  this->mStarted = this->mElapsed = 0;
+  this->mCycles = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * begin; waits for the queue to drain, and starts the clock; and SysTick,
+ *        counting down from the top, without interrupting anyone.
+ */
+
+void Bench::begin( void )
+{
+  this->mQueue->wait_for_idle();
+
+  this->mSavedCSR = systick_hw->csr;
+  this->mSavedRVR = systick_hw->rvr;
+  systick_hw->csr = 0;
+  systick_hw->rvr = BENCH_SYSTICK_MAX;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;
+
+  this->mStarted = time_us_64();
+}
+
+
+/*
+ * end; waits for everything queued since begin to be drawn, and stops the
+ *      clock. SysTick's count is only any good if it hasn't wrapped, which
+ *      it flags in bit 16; either way, it goes back to what it was doing.
+ */
+
+void Bench::end( void )
+{
+  uint32_t lCount, lFlags;
+
+  this->mQueue->wait_for_idle();
+  lCount = systick_hw->cvr;
+  lFlags = systick_hw->csr;
+  this->mElapsed = time_us_64() - this->mStarted;
+
+  this->mCycles = ( lFlags & 0x10000 ) ? 0 : BENCH_SYSTICK_MAX - lCount;
+
+  systick_hw->csr = 0;
+  systick_hw->rvr = this->mSavedRVR;
+  systick_hw->cvr = 0;
+  systick_hw->csr = this->mSavedCSR;
+}
+
+
+/*
+ * run; works through every workload, reporting the fastest of each. Whatever
+ *      was in the frame is trashed, so the world must repaint afterwards.
+ */
+
+void Bench::run( void )
+{
+  uint64_t lBest, lCycles;
+  uint32_t lPixels, lMhz = clock_get_hz( clk_sys ) / 1000000;
+  bool     lCounted;
+
+  printf( "bench: start, sys clock %" PRIu32 " MHz, %d repeats\n", lMhz, BENCH_REPEATS );
+
+  /* The curve timings depend on how they're stepped; core 1 checked its interpolators when it started. */
+  printf( "bench: curves stepped by %s\n", this->mQueue->interpolated() ? "interpolators" : "software" );
+
+  for ( uint_fast8_t lIndex = 0; lIndex < sizeof( m_workloads ) / sizeof( m_workloads[0] ); lIndex++ )
+  {
+    /* Every workload sees the same random numbers, every time. */
+    lBest = UINT64_MAX;
+    lCycles = 0;
+    lPixels = 0;
+    for ( uint_fast8_t lRepeat = 0; lRepeat < BENCH_REPEATS; lRepeat++ )
+    {
+      this->mRandom = BENCH_SEED;
+      lPixels = ( this->*m_workloads[lIndex].workload )( m_workloads[lIndex].param );
+      if ( this->mElapsed < lBest )
+      {
+        lBest = this->mElapsed;
+        lCycles = this->mCycles;
+      }
+    }
+    if ( lBest == 0 )
+    {
+      lBest = 1;
+    }
+
+    /* Cycles come from SysTick if they can, or the clock speed if not; pixel rates to two places. */
+    lCounted = ( lCycles > 0 );
+    if ( !lCounted )
+    {
+      lCycles = lBest * lMhz;
+    }
+    printf( "bench: %-16s %8" PRIu32 " us %c%10" PRIu64 " cycles %8" PRIu32 " px %5" PRIu32 ".%02" PRIu32 " px/us\n",
+            m_workloads[lIndex].name, (uint32_t)lBest, lCounted ? ' ' : '~', lCycles, lPixels,
+            (uint32_t)( lPixels / lBest ), (uint32_t)( ( (uint64_t)lPixels * 100 / lBest ) % 100 ) );
+  }
+
+  printf( "bench: done\n" );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * sky_fill; fills the whole frame with a single colour, as a full sky repaint
+ *           does.
+ */
+
+uint32_t Bench::sky_fill( uint_fast16_t pParam )
+{
+  this->begin();
+  this->mQueue->set_depth( 0 );
+  this->mQueue->set_pen( 40, 60, 120 );
+  this->mQueue->rectangle( pimoroni::Rect( 0, 0, FRAME_WIDTH, SCREEN_HEIGHT ) );
+  this->end();
+
+  return FRAME_WIDTH * SCREEN_HEIGHT;
+}
+
+
+/*
+ * ground_gradient; draws the ground as the world does, with a pen change and
+ *                  a span on every row.
+ */
+
+uint32_t Bench::ground_gradient( uint_fast16_t pParam )
+{
+  this->begin();
+  this->mQueue->set_depth( 1 );
+  for ( int32_t lRow = GROUND_TOP; lRow < SCREEN_HEIGHT; lRow++ )
+  {
+    this->mQueue->set_pen( 0, 80 + ( lRow - GROUND_TOP ), 30 );
+    this->mQueue->pixel_span( pimoroni::Point( 0, lRow ), FRAME_WIDTH );
+  }
+  this->end();
+
+  return FRAME_WIDTH * ( SCREEN_HEIGHT - GROUND_TOP );
+}
+
+
+/*
+ * branch; picks a random, branch sized, line, and a control point that bends
+ *         it about as much as the trees do; the line is the same whether or
+ *         not the control point is used. Returns the length, roughly.
+ */
+
+uint32_t Bench::branch( pimoroni::Point *pStart, pimoroni::Point *pControl, pimoroni::Point *pEnd )
+{
+  int32_t lBend;
+
+  pStart->x = random_next( &this->mRandom ) % SCREEN_WIDTH;
+  pStart->y = random_next( &this->mRandom ) % SCREEN_HEIGHT;
+  pEnd->x = pStart->x + ( random_next( &this->mRandom ) % 81 ) - 40;
+  pEnd->y = pStart->y - ( random_next( &this->mRandom ) % 80 );
+  lBend = (int32_t)( random_next( &this->mRandom ) % ( BRANCH_BEND_MAX * 2 + 1 ) ) - BRANCH_BEND_MAX;
+  pControl->x = ( pStart->x + pEnd->x ) / 2 - ( pEnd->y - pStart->y ) * lBend / 64;
+  pControl->y = ( pStart->y + pEnd->y ) / 2 + ( pEnd->x - pStart->x ) * lBend / 64;
+
+  return (uint32_t)sqrtf( ( pEnd->x - pStart->x ) * ( pEnd->x - pStart->x ) +
+                          ( pEnd->y - pStart->y ) * ( pEnd->y - pStart->y ) );
+}
+
+
+/*
+ * thick_lines; draws a number of random, branch sized, thick lines. The pixel
+ *              count is the length times the thickness, which is close enough.
+ */
+
+uint32_t Bench::thick_lines( uint_fast16_t pCount )
+{
+  pimoroni::Point lStart, lControl, lEnd;
+  uint32_t        lPixels = 0;
+
+  this->begin();
+  this->mQueue->set_depth( 1 );
+  this->mQueue->set_pen( 92, 64, 51 );
+  for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+  {
+    lPixels += 6 * this->branch( &lStart, &lControl, &lEnd );
+    this->mQueue->thick_line( lStart, lEnd, 6 );
+  }
+  this->end();
+
+  return lPixels;
+}
+
+
+/*
+ * thick_curves; draws the same branches as thick_lines, but bent into the
+ *               curves that the trees use.
+ */
+
+uint32_t Bench::thick_curves( uint_fast16_t pCount )
+{
+  pimoroni::Point lStart, lControl, lEnd;
+  uint32_t        lPixels = 0;
+
+  this->begin();
+  this->mQueue->set_depth( 1 );
+  this->mQueue->set_pen( 92, 64, 51 );
+  for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+  {
+    lPixels += 6 * this->branch( &lStart, &lControl, &lEnd );
+    this->mQueue->curve( lStart, lControl, lEnd, 6 );
+  }
+  this->end();
+
+  return lPixels;
+}
+
+
+/*
+ * thin_lines; draws a number of random, branch sized, single pixel lines, as
+ *             the outermost twigs are.
+ */
+
+uint32_t Bench::thin_lines( uint_fast16_t pCount )
+{
+  pimoroni::Point lStart, lControl, lEnd;
+  uint32_t        lPixels = 0;
+
+  this->begin();
+  this->mQueue->set_depth( 1 );
+  this->mQueue->set_pen( 92, 64, 51 );
+  for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+  {
+    lPixels += this->branch( &lStart, &lControl, &lEnd );
+    this->mQueue->line( lStart, lEnd );
+  }
+  this->end();
+
+  return lPixels;
+}
+
+
+/*
+ * thin_curves; draws the same twigs as thin_lines, but curved.
+ */
+
+uint32_t Bench::thin_curves( uint_fast16_t pCount )
+{
+  pimoroni::Point lStart, lControl, lEnd;
+  uint32_t        lPixels = 0;
+
+  this->begin();
+  this->mQueue->set_depth( 1 );
+  this->mQueue->set_pen( 92, 64, 51 );
+  for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+  {
+    lPixels += this->branch( &lStart, &lControl, &lEnd );
+    this->mQueue->curve( lStart, lControl, lEnd, 1 );
+  }
+  this->end();
+
+  return lPixels;
+}
+
+
+/*
+ * leaf_circles; draws a number of random, leaf sized, filled circles.
+ */
+
+uint32_t Bench::leaf_circles( uint_fast16_t pCount )
+{
+  const int32_t lRadius = 11;
+
+  this->begin();
+  this->mQueue->set_depth( 1 );
+  this->mQueue->set_pen( 68, 110, 21 );
+  for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+  {
+    this->mQueue->circle(
+      pimoroni::Point( random_next( &this->mRandom ) % SCREEN_WIDTH, random_next( &this->mRandom ) % SCREEN_HEIGHT ),
+      lRadius
+    );
+  }
+  this->end();
+
+  return pCount * ( lRadius * lRadius * 355 / 113 );
+}
+
+
+/*
+ * forest; plants a row of trees across the screen, grows them to the given
+ *         age, and then times drawing them all. Only the drawing is timed.
+ *         The pixel count is the leaf pixels actually written.
+ */
+
+uint32_t Bench::forest( uint_fast16_t pAge )
+{
+  SpatialIndex       *lIndex = new SpatialIndex();
+  PatternLibrary     *lPatterns = nullptr;
+  Tree               *lTrees[BENCH_TREES];
+  const primitive_t **lFound, **lOwned;
+  canopy_span_t      *lSpans;
+  uint_fast16_t       lCount, lOwnedCount;
+  uint32_t            lMark, lDiscPixels, lSpanPixels, lDropped;
+
+#if FOREST_PATTERNS
+  lPatterns = new PatternLibrary( BENCH_SEED );
+  if ( !lPatterns->ready() )
+  {
+    delete lPatterns;
+    lPatterns = nullptr;
+  }
+#endif
+
+  /* Plant and grow the forest, evenly spaced along the ground. */
+  for ( uint_fast8_t lTree = 0; lTree < BENCH_TREES; lTree++ )
+  {
+    lTrees[lTree] = new Tree(
+      this->mQueue, lIndex, lPatterns, nullptr,
+      pimoroni::Point( ( lTree * 2 + 1 ) * SCREEN_WIDTH / ( BENCH_TREES * 2 ), SCREEN_HEIGHT - GROUND_HEIGHT ),
+      random_next( &this->mRandom )
+    );
+    for ( uint_fast16_t lAge = 1; lAge < pAge; lAge++ )
+    {
+      lTrees[lTree]->update();
+    }
+    lTrees[lTree]->animate( GROWTH_FRAMES );
+  }
+
+  /* Find everything on screen, with scratch space from the arena. */
+  lMark = this->mArena->mark();
+  lFound = (const primitive_t **)this->mArena->alloc( sizeof( const primitive_t * ) * SPATIAL_PRIMITIVES_MAX );
+  lOwned = (const primitive_t **)this->mArena->alloc( sizeof( const primitive_t * ) * SPATIAL_PRIMITIVES_MAX );
+  lSpans = (canopy_span_t *)this->mArena->alloc( sizeof( canopy_span_t ) * CANOPY_SPANS_MAX );
+  lSpanPixels = 0;
+  if ( ( lFound != nullptr ) && ( lOwned != nullptr ) )
+  {
+    lCount = lIndex->query( pimoroni::Rect( 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT ), lFound, SPATIAL_PRIMITIVES_MAX );
+    Tree::canopy_stats( &lDiscPixels, &lSpanPixels, &lDropped, true );
+
+    this->begin();
+    this->mQueue->set_depth( 1 );
+    for ( uint_fast8_t lTree = 0; lTree < BENCH_TREES; lTree++ )
+    {
+      /* Each tree wants its own branches, level by level. */
+      lOwnedCount = 0;
+      for ( uint_fast8_t lLevel = 1; lLevel <= AGE_GROWTH / 4 + 1; lLevel++ )
+      {
+        for ( uint_fast16_t lPrimitive = 0; lPrimitive < lCount; lPrimitive++ )
+        {
+          if ( ( lFound[lPrimitive]->owner == lTrees[lTree] ) && ( lFound[lPrimitive]->level == lLevel ) )
+          {
+            lOwned[lOwnedCount++] = lFound[lPrimitive];
+          }
+        }
+      }
+      lTrees[lTree]->render( lOwned, lOwnedCount, 900, 0, lSpans, lSpans == nullptr ? 0 : CANOPY_SPANS_MAX );
+    }
+    this->end();
+
+    Tree::canopy_stats( &lDiscPixels, &lSpanPixels, &lDropped, true );
+    if ( lDropped > 0 )
+    {
+      printf( "bench: forest dropped %" PRIu32 " canopy spans\n", lDropped );
+    }
+  }
+  this->mArena->release( lMark );
+
+  /* And clear it all away again. */
+  for ( uint_fast8_t lTree = 0; lTree < BENCH_TREES; lTree++ )
+  {
+    delete lTrees[lTree];
+  }
+  delete lPatterns;
+  delete lIndex;
+
+  return lSpanPixels;
+}
+
+
+/*
+ * moon_phases; generates the given number of moon phase sprites, which the
+ *              world does once a day; this is all core 0, and has to fit in
+ *              the time it would otherwise spend waiting for core 1.
+ */
+
+uint32_t Bench::moon_phases( uint_fast16_t pCount )
+{
+  uint16_t *lSprite;
+  uint32_t  lMark;
+
+  /* Somewhere to put it, which needn't outlive the benchmark. */
+  lMark = this->mArena->mark();
+  lSprite = (uint16_t *)this->mArena->alloc( sizeof( uint16_t ) * MOON_SIZE * MOON_SIZE );
+  if ( lSprite == nullptr )
+  {
+    this->mElapsed = 0;
+    this->mCycles = 0;
+    return 0;
+  }
+
+  this->begin();
+  for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+  {
+    moon_phase( lSprite, sprite_moon_data, lIndex % MOON_PHASES );
+  }
+  this->end();
+
+  this->mArena->release( lMark );
+  return pCount * MOON_SIZE * MOON_SIZE;
+}
+
+/* End of file bench.cpp */
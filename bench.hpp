@@ -0,0 +1,72 @@
+/*
+ * bench.hpp - part of Arborescence
+ *
+ * This header declares the Bench class; a self-benchmark which runs a fixed
+ * set of drawing workloads through the real display drivers, and reports how
+ * long each took over the UART.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "arena.hpp"
+
+
+/* Constants. */
+
+#define BENCH_TRIGGER       'b'
+#define BENCH_REPEATS       3
+#define BENCH_SEED          0x42454E43
+#define BENCH_TREES         6
+#define BENCH_SYSTICK_MAX   0x00FFFFFF  /* SysTick is 24 bits, so 134ms at 125MHz. */
+
+
+/* Class declaration. */
+
+class Bench
+{
+private:
+  RenderQueue                          *mQueue;
+  FrameArena                           *mArena;
+  uint32_t                              mRandom;
+  uint64_t                              mStarted, mElapsed;
+  uint32_t                              mCycles;    /* Zero if the workload outran SysTick. */
+  uint32_t                              mSavedCSR, mSavedRVR;
+
+  void            begin( void );
+  void            end( void );
+  uint32_t        branch( pimoroni::Point *, pimoroni::Point *, pimoroni::Point * );
+
+public:
+                  Bench( RenderQueue *, FrameArena * );
+
+  void            run( void );
+
+  uint32_t        sky_fill( uint_fast16_t );
+  uint32_t        ground_gradient( uint_fast16_t );
+  uint32_t        thick_lines( uint_fast16_t );
+  uint32_t        thick_curves( uint_fast16_t );
+  uint32_t        thin_lines( uint_fast16_t );
+  uint32_t        thin_curves( uint_fast16_t );
+  uint32_t        leaf_circles( uint_fast16_t );
+  uint32_t        forest( uint_fast16_t );
+  uint32_t        moon_phases( uint_fast16_t );
+};
+
+
+/* Structures. */
+
+typedef struct
+{
+  const char     *name;
+  uint32_t        (Bench::*workload)( uint_fast16_t );
+  uint_fast16_t   param;
+} bench_workload_t;
+
+/* End of file bench.hpp */
@@ -0,0 +1,356 @@
+/*
+ * ecosystem.cpp - part of Arborescence
+ *
+ * Implements the Ecosystem class. Every plant from the camera to ECO_CHUNKS
+ * ahead of it is a handful of bytes in a set of parallel arrays; where it
+ * stands, the seed it will grow from, and its age. Once a second they all get
+ * a year older, and the mature ones drop seeds nearby, which only take if the
+ * ground around where they land isn't already crowded.
+ *
+ * Chunks coming into range start out with a scattering of wild plants of all
+ * ages, and plants which fall behind the camera are simply forgotten; so the
+ * population (and the cost of a tick) stays about the same, however far we
+ * travel.
+ *
+ * None of this is drawn. The Landscape picks a few plants in each chunk it
+ * holds, to be grown into full Trees; those are marked as shown, and live
+ * until their Tree has died, rather than by their age.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdint.h>
+#include <string.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "ecosystem.hpp"
+
+
+/* Module variables. */
+
+static uint16_t m_eco_plants = 0;
+static uint16_t m_eco_shown = 0;
+static uint32_t m_eco_seeds = 0;
+static uint32_t m_eco_sprouted = 0;
+static uint32_t m_eco_crowded = 0;
+static uint32_t m_eco_full = 0;
+static uint32_t m_eco_deaths = 0;
+
+
+/* Functions. */
+
+
+/*
+ * constructor; starts with empty ground; nothing grows until we're told
+ *              where the camera is.
+ */
+
+Ecosystem::Ecosystem( uint32_t pSeed )
+{
+  this->mWorldSeed = pSeed;
+  this->mRandom = random_hash( pSeed ^ 0x45434f53, 0 ) | 1;
+  this->mLeft = 0;
+  this->mFrontier = INT32_MIN;
+  this->mCursor = 0;
+
+  memset( this->mAge, 0, sizeof( this->mAge ) );
+  memset( this->mFlags, 0, sizeof( this->mFlags ) );
+  memset( this->mCrowd, 0, sizeof( this->mCrowd ) );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * claim; finds a free record, carrying on from where the last one was found.
+ *        Returns ECO_NONE if every record is in use.
+ */
+
+int_fast16_t Ecosystem::claim( void )
+{
+  for ( uint_fast16_t lCount = 0; lCount < ECO_PLANTS_MAX; lCount++ )
+  {
+    uint_fast16_t lIndex = this->mCursor;
+
+    this->mCursor = ( this->mCursor + 1 ) % ECO_PLANTS_MAX;
+    if ( this->mAge[lIndex] == 0 )
+    {
+      return lIndex;
+    }
+  }
+  return ECO_NONE;
+}
+
+
+/*
+ * colonise; scatters wild plants, of all ages, across a chunk which has just
+ *           come into range. These come from the world seed and the chunk
+ *           index, just like its terrain.
+ */
+
+void Ecosystem::colonise( int32_t pIndex )
+{
+  uint32_t     lRandom = random_hash( this->mWorldSeed ^ 0x57494c44, (uint32_t)pIndex ) | 1;
+  int_fast16_t lPlant;
+
+  for ( uint_fast8_t lCount = 0; lCount < ECO_WILD_PLANTS; lCount++ )
+  {
+    lPlant = this->claim();
+    if ( lPlant == ECO_NONE )
+    {
+      m_eco_full++;
+      return;
+    }
+    this->mX[lPlant] = ( pIndex * CHUNK_WIDTH ) + ( random_next( &lRandom ) % CHUNK_WIDTH );
+    this->mSeed[lPlant] = random_next( &lRandom );
+    this->mAge[lPlant] = 1 + ( random_next( &lRandom ) % ( AGE_DEATH - 1 ) );
+    this->mFlags[lPlant] = 0;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * advance; moves the simulated stretch of the world on to start at the given
+ *          chunk, colonising whatever has come into range at the far end.
+ *          Called every frame; there's rarely anything to do.
+ */
+
+void Ecosystem::advance( int32_t pFirst )
+{
+  this->mLeft = pFirst * CHUNK_WIDTH;
+
+  /* Anything we've skipped past never needs colonising at all. */
+  if ( this->mFrontier < pFirst - 1 )
+  {
+    this->mFrontier = pFirst - 1;
+  }
+  while( this->mFrontier < pFirst + ECO_CHUNKS - 1 )
+  {
+    this->colonise( ++this->mFrontier );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * tick; a second in the life of every plant. The first pass ages them all,
+ *       lets go of the dead and the left behind, and counts how crowded each
+ *       cell is, mature plants counting double; the second has the mature
+ *       ones drop their seeds.
+ */
+
+void Ecosystem::tick( void )
+{
+  int32_t       lRight = this->mLeft + ( ECO_CHUNKS * CHUNK_WIDTH );
+  int32_t       lX;
+  uint_fast16_t lCell, lCrowd, lPlants = 0, lShown = 0;
+  int_fast16_t  lPlant;
+
+  memset( this->mCrowd, 0, sizeof( this->mCrowd ) );
+
+  for ( uint_fast16_t lIndex = 0; lIndex < ECO_PLANTS_MAX; lIndex++ )
+  {
+    if ( this->mAge[lIndex] == 0 )
+    {
+      continue;
+    }
+
+    /* Shown plants are in the Landscape's hands; it tells us when they go. */
+    if ( ( this->mFlags[lIndex] & ECO_FLAG_SHOWN ) == 0 )
+    {
+      if ( this->mAge[lIndex] >= AGE_DEATH )
+      {
+        this->mAge[lIndex] = 0;
+        m_eco_deaths++;
+        continue;
+      }
+      if ( this->mX[lIndex] < this->mLeft )
+      {
+        this->mAge[lIndex] = 0;
+        continue;
+      }
+    }
+    else
+    {
+      lShown++;
+    }
+
+    /* Same as a Tree, it stops counting once it's dead. */
+    if ( this->mAge[lIndex] <= AGE_DEATH )
+    {
+      this->mAge[lIndex]++;
+    }
+    lPlants++;
+
+    if ( ( this->mX[lIndex] >= this->mLeft ) && ( this->mX[lIndex] < lRight ) )
+    {
+      this->mCrowd[( this->mX[lIndex] - this->mLeft ) / ECO_CELL_WIDTH] += ( this->mAge[lIndex] >= AGE_GROWTH ) ? 2 : 1;
+    }
+  }
+
+  for ( uint_fast16_t lIndex = 0; lIndex < ECO_PLANTS_MAX; lIndex++ )
+  {
+    /* Only mature, living, plants have seeds; and not every second. */
+    if ( ( this->mAge[lIndex] < AGE_GROWTH ) || ( this->mAge[lIndex] > AGE_DEATH ) ||
+         ( random_next( &this->mRandom ) % ECO_SEED_CHANCE != 0 ) )
+    {
+      continue;
+    }
+    m_eco_seeds++;
+
+    /* See where it lands, and whether there's space for it to grow there. */
+    lX = this->mX[lIndex] + (int32_t)( random_next( &this->mRandom ) % ( ECO_SEED_SPREAD * 2 + 1 ) ) - ECO_SEED_SPREAD;
+    if ( ( lX < this->mLeft ) || ( lX >= lRight ) )
+    {
+      m_eco_crowded++;
+      continue;
+    }
+    lCell = ( lX - this->mLeft ) / ECO_CELL_WIDTH;
+    lCrowd = this->mCrowd[lCell];
+    lCrowd += ( lCell > 0 ) ? this->mCrowd[lCell - 1] : 0;
+    lCrowd += ( lCell < ECO_CELLS - 1 ) ? this->mCrowd[lCell + 1] : 0;
+    if ( lCrowd >= ECO_CROWD_LIMIT )
+    {
+      m_eco_crowded++;
+      continue;
+    }
+    lPlant = this->claim();
+    if ( lPlant == ECO_NONE )
+    {
+      m_eco_full++;
+      continue;
+    }
+
+    /* A seedling; young enough that it won't be dropping seeds of its own this time round. */
+    this->mX[lPlant] = lX;
+    this->mSeed[lPlant] = random_next( &this->mRandom );
+    this->mAge[lPlant] = 1;
+    this->mFlags[lPlant] = 0;
+    this->mCrowd[lCell]++;
+    m_eco_sprouted++;
+    lPlants++;
+  }
+
+  m_eco_plants = lPlants;
+  m_eco_shown = lShown;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * choose; picks the oldest plant, not already shown, standing between the
+ *         given world columns and no older than the given age. Returns
+ *         ECO_NONE if there isn't one.
+ */
+
+int_fast16_t Ecosystem::choose( int32_t pLeft, int32_t pRight, uint_fast8_t pMaxAge )
+{
+  int_fast16_t lBest = ECO_NONE;
+
+  for ( uint_fast16_t lIndex = 0; lIndex < ECO_PLANTS_MAX; lIndex++ )
+  {
+    if ( ( this->mAge[lIndex] == 0 ) || ( this->mAge[lIndex] > pMaxAge ) ||
+         ( this->mX[lIndex] < pLeft ) || ( this->mX[lIndex] >= pRight ) ||
+         ( this->mFlags[lIndex] & ECO_FLAG_SHOWN ) )
+    {
+      continue;
+    }
+    if ( ( lBest == ECO_NONE ) || ( this->mAge[lIndex] > this->mAge[lBest] ) )
+    {
+      lBest = lIndex;
+    }
+  }
+
+  return lBest;
+}
+
+
+/*
+ * show; marks a plant as grown into a full Tree, or not. A plant that stops
+ *       being shown goes back to living (and dying) by its age alone.
+ */
+
+void Ecosystem::show( int_fast16_t pPlant, bool pShown )
+{
+  if ( pShown )
+  {
+    this->mFlags[pPlant] |= ECO_FLAG_SHOWN;
+  }
+  else
+  {
+    this->mFlags[pPlant] &= ~ECO_FLAG_SHOWN;
+  }
+}
+
+
+/*
+ * fell; called when a shown plant's Tree has died, to let go of its record.
+ */
+
+void Ecosystem::fell( int_fast16_t pPlant )
+{
+  this->mAge[pPlant] = 0;
+  this->mFlags[pPlant] = 0;
+  m_eco_deaths++;
+}
+
+
+/*
+ * x, seed, age; simple accessors for a single plant.
+ */
+
+int32_t Ecosystem::x( int_fast16_t pPlant )
+{
+  return this->mX[pPlant];
+}
+
+uint32_t Ecosystem::seed( int_fast16_t pPlant )
+{
+  return this->mSeed[pPlant];
+}
+
+uint_fast8_t Ecosystem::age( int_fast16_t pPlant )
+{
+  return this->mAge[pPlant];
+}
+
+
+/*
+ * stats; reports how many plants there are, and how many of them are shown,
+ *        as of the last tick, and what became of the seeds dropped since the
+ *        last reset. Optionally resets the counts.
+ */
+
+void Ecosystem::stats( eco_stats_t *pStats, bool pReset )
+{
+  pStats->plants = m_eco_plants;
+  pStats->shown = m_eco_shown;
+  pStats->seeds = m_eco_seeds;
+  pStats->sprouted = m_eco_sprouted;
+  pStats->crowded = m_eco_crowded;
+  pStats->full = m_eco_full;
+  pStats->deaths = m_eco_deaths;
+
+  if ( pReset )
+  {
+    m_eco_seeds = m_eco_sprouted = m_eco_crowded = m_eco_full = m_eco_deaths = 0;
+  }
+}
+
+/* End of file ecosystem.cpp */
@@ -0,0 +1,81 @@
+/*
+ * ecosystem.hpp - part of Arborescence
+ *
+ * This header declares the Ecosystem class; a cheap simulation of every plant
+ * in a long stretch of the world ahead of the camera, only a few of which are
+ * ever grown into full Trees.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define ECO_PLANTS_MAX      2048
+#define ECO_CHUNKS          48      /* How much of the world is simulated, from the camera on. */
+#define ECO_CELL_WIDTH      8       /* Plants are counted in cells this many columns wide... */
+#define ECO_CELLS           ( ECO_CHUNKS * CHUNK_WIDTH / ECO_CELL_WIDTH )
+#define ECO_CROWD_LIMIT     4       /* ...and a seed won't take if its cell and neighbours hold this much. */
+#define ECO_WILD_PLANTS     24      /* Already growing in a chunk as it comes into range. */
+#define ECO_SEED_CHANCE     8       /* A mature plant drops a seed one second in this many. */
+#define ECO_SEED_SPREAD     40      /* And it lands within this many columns. */
+#define ECO_SPROUT_AGE      4       /* Young enough to appear in view, and be seen to grow. */
+#define ECO_NONE            -1
+
+#define ECO_FLAG_SHOWN      0x01    /* Grown into a full Tree in some chunk. */
+
+
+/* Structures. */
+
+typedef struct
+{
+  uint16_t        plants;         /* Alive right now... */
+  uint16_t        shown;          /* ...and how many of those are full Trees. */
+  uint32_t        seeds;          /* Dropped, since the last reset... */
+  uint32_t        sprouted;       /* ...that took... */
+  uint32_t        crowded;        /* ...or didn't, for lack of space... */
+  uint32_t        full;           /* ...or of records. */
+  uint32_t        deaths;
+} eco_stats_t;
+
+
+/* Class declaration. */
+
+class Ecosystem
+{
+private:
+  int32_t                               mX[ECO_PLANTS_MAX];
+  uint32_t                              mSeed[ECO_PLANTS_MAX];
+  uint8_t                               mAge[ECO_PLANTS_MAX];     /* Zero for a free record. */
+  uint8_t                               mFlags[ECO_PLANTS_MAX];
+  uint8_t                               mCrowd[ECO_CELLS];
+  uint32_t                              mWorldSeed;
+  uint32_t                              mRandom;
+  int32_t                               mLeft, mFrontier;
+  uint_fast16_t                         mCursor;
+
+  int_fast16_t    claim( void );
+  void            colonise( int32_t );
+
+public:
+                  Ecosystem( uint32_t );
+
+  void            advance( int32_t );
+  void            tick( void );
+  int_fast16_t    choose( int32_t, int32_t, uint_fast8_t );
+  void            show( int_fast16_t, bool );
+  void            fell( int_fast16_t );
+  int32_t         x( int_fast16_t );
+  uint32_t        seed( int_fast16_t );
+  uint_fast8_t    age( int_fast16_t );
+  static void     stats( eco_stats_t *, bool );
+};
+
+/* End of file ecosystem.hpp */
@@ -0,0 +1,153 @@
+/*
+ * governor.cpp - part of Arborescence
+ *
+ * Implements the Governor class. Each frame it is given the frame's phase
+ * timings, and returns the clock level it wants for the next one:
+ *
+ *  - if the next frame is expected to be heavy (a sky colour step, a forest
+ *    redraw) it goes straight to full speed, and stays there for a while;
+ *  - if the busier core has used more than GOVERNOR_UP_PERCENT of the frame
+ *    budget for a couple of frames, it steps up a level;
+ *  - if, for a good couple of seconds, the load scaled to the next level down
+ *    would still be under GOVERNOR_DOWN_PERCENT, it steps down a level.
+ *
+ * The gap between the two thresholds, and the very different frame counts,
+ * stop it from hunting between levels. There is nothing here but arithmetic,
+ * so it behaves exactly the same on a host, fed with recorded traces.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "governor.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; takes the table of clock speeds (slowest first, in kHz) that
+ *              we can choose between, and the one we're starting at.
+ */
+
+Governor::Governor( const uint32_t *pLevels, uint_fast8_t pLevel )
+{
+  this->mLevels = pLevels;
+  this->mLevel = pLevel < GOVERNOR_LEVELS ? pLevel : GOVERNOR_LEVELS - 1;
+  this->mUpFrames = this->mDownFrames = this->mBoostFrames = 0;
+  this->mRefused = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * decide; works out the level we want for the next frame, given the timings
+ *         of the last one.
+ */
+
+uint_fast8_t Governor::decide( const governor_sample_t *pSample )
+{
+  uint32_t lBusy, lPercent, lProjected;
+
+  /* Heavy work coming up gets everything we have, straight away. */
+  if ( pSample->heavy_ahead )
+  {
+    this->mLevel = GOVERNOR_LEVELS - 1;
+    this->mBoostFrames = GOVERNOR_BOOST_FRAMES;
+    this->mUpFrames = this->mDownFrames = 0;
+    return this->mLevel;
+  }
+  if ( this->mBoostFrames > 0 )
+  {
+    this->mBoostFrames--;
+    return this->mLevel;
+  }
+
+  /* The load is set by whichever core is busiest, against the frame budget. */
+  lBusy = pSample->busy_us > pSample->raster_us ? pSample->busy_us : pSample->raster_us;
+  lPercent = lBusy * 100 / GOVERNOR_BUDGET_US;
+
+  /* Struggling? Then speed up, once we're sure it's not a one-off. */
+  if ( lPercent > GOVERNOR_UP_PERCENT )
+  {
+    this->mDownFrames = 0;
+    if ( ( ++this->mUpFrames >= GOVERNOR_UP_FRAMES ) && ( this->mLevel < GOVERNOR_LEVELS - 1 ) &&
+         ( ( this->mRefused & ( 1 << ( this->mLevel + 1 ) ) ) == 0 ) )
+    {
+      this->mLevel++;
+      this->mUpFrames = 0;
+    }
+    return this->mLevel;
+  }
+  this->mUpFrames = 0;
+
+  /* Otherwise, see if we'd be comfortable one level down. */
+  if ( ( this->mLevel == 0 ) || ( this->mRefused & ( 1 << ( this->mLevel - 1 ) ) ) )
+  {
+    return this->mLevel;
+  }
+  lProjected = lPercent * this->mLevels[this->mLevel] / this->mLevels[this->mLevel-1];
+  if ( lProjected < GOVERNOR_DOWN_PERCENT )
+  {
+    if ( ++this->mDownFrames >= GOVERNOR_DOWN_FRAMES )
+    {
+      this->mLevel--;
+      this->mDownFrames = 0;
+    }
+  }
+  else
+  {
+    this->mDownFrames = 0;
+  }
+
+  return this->mLevel;
+}
+
+
+/*
+ * refuse; called when the clock couldn't be set to the level we last asked
+ *         for, to go back to the one it's still at. We won't ask for that
+ *         level again.
+ */
+
+void Governor::refuse( uint_fast8_t pLevel )
+{
+  this->mRefused |= 1 << this->mLevel;
+  this->mLevel = pLevel;
+  this->mUpFrames = this->mDownFrames = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * level; returns the level we're currently at.
+ */
+
+uint_fast8_t Governor::level( void )
+{
+  return this->mLevel;
+}
+
+
+/*
+ * khz; returns the clock speed of the level we're currently at.
+ */
+
+uint32_t Governor::khz( void )
+{
+  return this->mLevels[this->mLevel];
+}
+
+/* End of file governor.cpp */
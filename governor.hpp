@@ -0,0 +1,67 @@
+/*
+ * governor.hpp - part of Arborescence
+ *
+ * This header declares the Governor class; it decides what speed the system
+ * clock should be running at, from how long recent frames took and whether
+ * the next one is expected to be heavy. It doesn't touch the hardware itself,
+ * so it can be fed recorded traces on a host.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define GOVERNOR_LEVELS       3
+#define GOVERNOR_LOW_PERCENT  50      /* Of whatever we booted at, which is the top level. */
+#define GOVERNOR_MID_PERCENT  75
+#define GOVERNOR_BUDGET_US    16667   /* One frame at 60Hz. */
+#define GOVERNOR_UP_PERCENT   85      /* Busier than this, and we speed up... */
+#define GOVERNOR_UP_FRAMES    2
+#define GOVERNOR_DOWN_PERCENT 60      /* ...but only slow down if we'd still be under this. */
+#define GOVERNOR_DOWN_FRAMES  120
+#define GOVERNOR_BOOST_FRAMES 30      /* How long to hold full speed for heavy frames. */
+
+/* Anything clocked from the system clock needs its rate resetting after a change. */
+#define DISPLAY_I2C           i2c1    /* The display driver talks over GPIO 6 and 7... */
+#define DISPLAY_I2C_BAUD      400000  /* ...at pimoroni_i2c's default rate. */
+
+
+/* Structures. */
+
+typedef struct
+{
+  uint32_t        frame_us;     /* Start of one frame to the start of the next. */
+  uint32_t        busy_us;      /* Time core 0 spent rendering and updating. */
+  uint32_t        raster_us;    /* Time core 1 spent drawing the last frame. */
+  bool            heavy_ahead;  /* The next frame is expected to be a big one. */
+} governor_sample_t;
+
+
+/* Class declaration. */
+
+class Governor
+{
+private:
+  const uint32_t                       *mLevels;
+  uint_fast8_t                          mLevel;
+  uint_fast16_t                         mUpFrames, mDownFrames, mBoostFrames;
+  uint_fast8_t                          mRefused;     /* Levels the clock couldn't be set to, as bits. */
+
+public:
+                  Governor( const uint32_t *, uint_fast8_t );
+
+  uint_fast8_t    decide( const governor_sample_t * );
+  void            refuse( uint_fast8_t );
+  uint_fast8_t    level( void );
+  uint32_t        khz( void );
+};
+
+/* End of file governor.hpp */
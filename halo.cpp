@@ -0,0 +1,96 @@
+/*
+ * halo.cpp - part of Arborescence
+ *
+ * Generates the glow that surrounds the sun and moon. Drawing a soft glow
+ * into the sky would mean repainting a gradient every frame as they move, so
+ * instead the glow is a ring of sprites that rides along with them, blended
+ * with whatever sky is behind it by the display itself.
+ *
+ * Sprites only have a single bit of alpha, so the falloff is done by
+ * dithering; the further from the centre, the fewer pixels are set. Each set
+ * pixel is blended half and half with the sky, so the result is a soft wash
+ * of colour that fades out to nothing. It's all computed once, at boot, in
+ * fixed point.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdint.h>
+
+
+/* Local header files. */
+
+#include "arborescence.hpp"
+
+
+/* Module variables. */
+
+static const uint8_t m_bayer[4][4] =
+{
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+
+/* Functions. */
+
+
+/*
+ * halo_generate; fills in the four quarter tiles (top left, top right, bottom
+ *                left, bottom right) of a halo, in the given colour. Inside
+ *                the inner radius is left clear for the body itself; from
+ *                there the glow falls away to nothing at the edge of the tiles.
+ */
+
+void halo_generate( uint16_t *pTiles, uint8_t pRed, uint8_t pGreen, uint8_t pBlue, int_fast16_t pInner )
+{
+  const int_fast16_t  lOuter = HALO_TILE_SIZE;
+  uint16_t            lColour;
+  int_fast32_t        lX, lY, lDistanceSq, lFalloff;
+
+  /* The colour is the same everywhere; it's the density that changes. */
+  lColour = 0x8000 | ( ( pRed >> 3 ) << 10 ) | ( ( pGreen >> 3 ) << 5 ) | ( pBlue >> 3 );
+
+  for ( uint_fast8_t lTile = 0; lTile < 4; lTile++ )
+  {
+    for ( uint_fast8_t lRow = 0; lRow < HALO_TILE_SIZE; lRow++ )
+    {
+      for ( uint_fast8_t lColumn = 0; lColumn < HALO_TILE_SIZE; lColumn++ )
+      {
+        /* Measure from the centre of the halo, in half pixels so it's symmetrical. */
+        lX = ( ( lTile & 1 ) * HALO_TILE_SIZE + lColumn ) * 2 + 1 - HALO_TILE_SIZE * 2;
+        lY = ( ( lTile >> 1 ) * HALO_TILE_SIZE + lRow ) * 2 + 1 - HALO_TILE_SIZE * 2;
+        lDistanceSq = ( lX * lX + lY * lY ) / 4;
+
+        /*
+         * The falloff is the square of how far we are from the edge, scaled
+         * to 0-255 over the width of the ring; distances stay squared, so
+         * there's no square root needed.
+         */
+        if ( ( lDistanceSq < pInner * pInner ) || ( lDistanceSq >= lOuter * lOuter ) )
+        {
+          lFalloff = 0;
+        }
+        else
+        {
+          lFalloff = ( ( lOuter * lOuter - lDistanceSq ) << 8 ) / ( lOuter * lOuter - pInner * pInner );
+          lFalloff = ( lFalloff * lFalloff ) >> 8;
+        }
+
+        /* And dither that into the single alpha bit. */
+        pTiles[( lTile * HALO_TILE_SIZE + lRow ) * HALO_TILE_SIZE + lColumn] =
+          ( lFalloff > m_bayer[lRow & 3][lColumn & 3] * 16 + 8 ) ? lColour : 0;
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+/* End of file halo.cpp */
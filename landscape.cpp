@@ -0,0 +1,502 @@
+/*
+ * landscape.cpp - part of Arborescence
+ *
+ * Implements the Landscape class. The world is divided into fixed width
+ * chunks, each of which is generated entirely from the world seed and the
+ * chunk index - so we can throw chunks away when the camera has moved on, and
+ * get exactly the same terrain and stars back if we ever return.
+ *
+ * Trees are different; where they grow is down to the Ecosystem, which keeps
+ * track of thousands of plants well ahead of the camera. Each chunk grows full
+ * Trees for just a few of the plants standing in it - the oldest, as it's
+ * generated, and after that seedlings, as trees die and leave gaps.
+ *
+ * Generation is spread over several frames, a stage at a time, and is done
+ * well before the chunk scrolls into view.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdlib.h>
+
+
+/* Local header files. */
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
+#include "offscreen.hpp"
+#include "tree.hpp"
+#include "ecosystem.hpp"
+#include "landscape.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; saves the render queue, spatial index, pattern library and
+ *              offscreen heap (for the trees) and the world seed, and marks
+ *              the whole cache as empty. The pattern library and offscreen
+ *              heap are optional.
+ */
+
+Landscape::Landscape( RenderQueue *pQueue, SpatialIndex *pIndex, PatternLibrary *pPatterns,
+                      OffscreenHeap *pOffscreen, uint32_t pSeed )
+{
+  /* Save the references we're given. */
+  this->mQueue = pQueue;
+  this->mIndex = pIndex;
+  this->mPatterns = pPatterns;
+  this->mOffscreen = pOffscreen;
+  this->mSeed = pSeed;
+  this->mClock = 0;
+  this->mPinFirst = this->mPinLast = 0;
+
+  /* The ecosystem is seeded from the world, too; and ready for the camera starting at the origin. */
+  this->mEcosystem = new Ecosystem( pSeed );
+  this->mEcosystem->advance( chunk_index( 0 ) - 1 );
+
+  /* Nothing in the cache yet. */
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    this->mChunks[lSlot].stage = CHUNK_STAGE_EMPTY;
+    for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+    {
+      this->mChunks[lSlot].trees[lIndex] = nullptr;
+      this->mChunks[lSlot].plants[lIndex] = ECO_NONE;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * destructor; empties every chunk, which frees up their trees.
+ */
+
+Landscape::~Landscape( void )
+{
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    this->empty_chunk( &this->mChunks[lSlot] );
+  }
+  delete this->mEcosystem;
+  return;
+}
+
+
+/*
+ * chunk_index; works out which chunk a world column falls into. This rounds
+ *              down, even for negative columns.
+ */
+
+int32_t Landscape::chunk_index( int32_t pColumn )
+{
+  if ( pColumn >= 0 )
+  {
+    return pColumn / CHUNK_WIDTH;
+  }
+  return -( ( CHUNK_WIDTH - 1 - pColumn ) / CHUNK_WIDTH );
+}
+
+
+/*
+ * edge_rise; returns how far the terrain rises above the ground level at the
+ *            left hand edge of the given chunk. Chunks share edges, so this
+ *            is derived from the index alone.
+ */
+
+int_fast8_t Landscape::edge_rise( int32_t pIndex )
+{
+  return random_hash( this->mSeed ^ 0x54455252, (uint32_t)pIndex ) % ( TERRAIN_RISE_MAX + 1 );
+}
+
+
+/*
+ * terrain_rise; returns how far the terrain rises above the ground level at
+ *               any world column; it slopes evenly between chunk edges.
+ */
+
+int32_t Landscape::terrain_rise( int32_t pColumn )
+{
+  int32_t lIndex = chunk_index( pColumn );
+  int32_t lLeft = this->edge_rise( lIndex );
+  int32_t lRight = this->edge_rise( lIndex + 1 );
+
+  return lLeft + ( ( lRight - lLeft ) * ( pColumn - ( lIndex * CHUNK_WIDTH ) ) ) / CHUNK_WIDTH;
+}
+
+
+/*
+ * ground_span; works out which world columns of a chunk are ground, on the
+ *              given screen row. The terrain slopes evenly, so this is always
+ *              a single span. Returns false if there's no ground on the row.
+ */
+
+bool Landscape::ground_span( const chunk_t *pChunk, int32_t pRow,
+                             int32_t *pStart, int32_t *pEnd )
+{
+  int32_t lLeft = pChunk->index * CHUNK_WIDTH;
+  int32_t lNeeded = GROUND_LEVEL - pRow;
+
+  /* Assume the whole chunk, to start with. */
+  *pStart = lLeft;
+  *pEnd = lLeft + CHUNK_WIDTH;
+
+  /* If the terrain reaches the row at both edges, it's all ground. */
+  if ( ( pChunk->rise_left >= lNeeded ) && ( pChunk->rise_right >= lNeeded ) )
+  {
+    return true;
+  }
+
+  /* And if it reaches at neither, it's all sky. */
+  if ( ( pChunk->rise_left < lNeeded ) && ( pChunk->rise_right < lNeeded ) )
+  {
+    return false;
+  }
+
+  /* Otherwise, we're on a slope; find where it crosses the row. */
+  if ( pChunk->rise_right > pChunk->rise_left )
+  {
+    *pStart = lLeft + ( ( lNeeded - pChunk->rise_left ) * CHUNK_WIDTH +
+                        ( pChunk->rise_right - pChunk->rise_left ) - 1 ) /
+                      ( pChunk->rise_right - pChunk->rise_left );
+  }
+  else
+  {
+    *pEnd = lLeft + 1 + ( ( pChunk->rise_left - lNeeded ) * CHUNK_WIDTH ) /
+                        ( pChunk->rise_left - pChunk->rise_right );
+  }
+
+  return true;
+}
+
+
+/*
+ * find_chunk; looks for a chunk in the cache, returning nullptr if it isn't.
+ */
+
+chunk_t *Landscape::find_chunk( int32_t pIndex )
+{
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    if ( ( this->mChunks[lSlot].stage != CHUNK_STAGE_EMPTY ) &&
+         ( this->mChunks[lSlot].index == pIndex ) )
+    {
+      return &this->mChunks[lSlot];
+    }
+  }
+  return nullptr;
+}
+
+
+/*
+ * claim_chunk; finds a slot in the cache for a new chunk. If there are no free
+ *              slots, the least recently used chunk outside of the pinned range
+ *              around the camera is thrown away.
+ */
+
+chunk_t *Landscape::claim_chunk( int32_t pIndex )
+{
+  chunk_t *lChunk = nullptr;
+
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    /* An empty slot is always the best choice. */
+    if ( this->mChunks[lSlot].stage == CHUNK_STAGE_EMPTY )
+    {
+      lChunk = &this->mChunks[lSlot];
+      break;
+    }
+
+    /* Never evict anything the camera needs. */
+    if ( ( this->mChunks[lSlot].index >= this->mPinFirst ) &&
+         ( this->mChunks[lSlot].index <= this->mPinLast ) )
+    {
+      continue;
+    }
+
+    /* Otherwise, look for the oldest. */
+    if ( ( lChunk == nullptr ) || ( this->mChunks[lSlot].last_used < lChunk->last_used ) )
+    {
+      lChunk = &this->mChunks[lSlot];
+    }
+  }
+
+  /* The cache is sized to hold the pinned range, but just in case... */
+  if ( lChunk == nullptr )
+  {
+    lChunk = &this->mChunks[0];
+    for ( uint_fast8_t lSlot = 1; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+    {
+      if ( this->mChunks[lSlot].last_used < lChunk->last_used )
+      {
+        lChunk = &this->mChunks[lSlot];
+      }
+    }
+  }
+
+  /* Clear out whatever was there, and set it up for the new chunk. */
+  this->empty_chunk( lChunk );
+  lChunk->index = pIndex;
+  lChunk->seed = random_hash( this->mSeed, (uint32_t)pIndex );
+  lChunk->last_used = this->mClock;
+  lChunk->stage = CHUNK_STAGE_TERRAIN;
+
+  return lChunk;
+}
+
+
+/*
+ * empty_chunk; releases everything held by a chunk, and marks it as empty.
+ *              The plants behind its trees carry on without them.
+ */
+
+void Landscape::empty_chunk( chunk_t *pChunk )
+{
+  for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+  {
+    if ( pChunk->trees[lIndex] != nullptr )
+    {
+      delete pChunk->trees[lIndex];
+      pChunk->trees[lIndex] = nullptr;
+      this->mEcosystem->show( pChunk->plants[lIndex], false );
+      pChunk->plants[lIndex] = ECO_NONE;
+    }
+  }
+  pChunk->stage = CHUNK_STAGE_EMPTY;
+}
+
+
+/*
+ * plant_tree; grows a full tree for one of the ecosystem's plants, in the
+ *             given slot of a chunk. It stands where the plant does, and is
+ *             grown to the same age; everything else comes from its seed.
+ */
+
+Tree *Landscape::plant_tree( chunk_t *pChunk, uint_fast8_t pSlot, int_fast16_t pPlant )
+{
+  pimoroni::Point lOrigin;
+  uint32_t        lRandom = this->mEcosystem->seed( pPlant ) | 1;
+  Tree           *lTree;
+
+  lOrigin.x = this->mEcosystem->x( pPlant );
+  lOrigin.y = SCREEN_HEIGHT - ( GROUND_HEIGHT / 2 ) - ( random_next( &lRandom ) % GROUND_HEIGHT )
+            - this->terrain_rise( lOrigin.x );
+
+  /* Plant it, and catch it up with the plant; a new tree is already a year old. */
+  lTree = new Tree( this->mQueue, this->mIndex, this->mPatterns, this->mOffscreen, lOrigin, random_next( &lRandom ) );
+  for ( uint_fast8_t lAge = this->mEcosystem->age( pPlant ); lAge > 1; lAge-- )
+  {
+    lTree->update();
+  }
+
+  pChunk->trees[pSlot] = lTree;
+  pChunk->plants[pSlot] = pPlant;
+  this->mEcosystem->show( pPlant, true );
+  return lTree;
+}
+
+
+/*
+ * fell_tree; called once a tree has died, to clear it out of its slot and let
+ *            the ecosystem forget its plant.
+ */
+
+void Landscape::fell_tree( chunk_t *pChunk, uint_fast8_t pSlot )
+{
+  delete pChunk->trees[pSlot];
+  pChunk->trees[pSlot] = nullptr;
+  this->mEcosystem->fell( pChunk->plants[pSlot] );
+  pChunk->plants[pSlot] = ECO_NONE;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * tick; called every second or so, to move the ecosystem on. Any gap in the
+ *       chunks around the camera can then be filled by a seedling, young
+ *       enough to be seen growing; just the one per tick, to keep the cost
+ *       of catching it up down, and the number of trees within what we can
+ *       afford to draw. Returns true if a tree was planted.
+ */
+
+bool Landscape::tick( void )
+{
+  chunk_t     *lChunk;
+  int_fast16_t lPlant;
+
+  this->mEcosystem->tick();
+
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    lChunk = &this->mChunks[lSlot];
+    if ( ( lChunk->stage != CHUNK_STAGE_READY ) ||
+         ( lChunk->index < this->mPinFirst ) || ( lChunk->index > this->mPinLast ) )
+    {
+      continue;
+    }
+
+    for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+    {
+      if ( lChunk->trees[lIndex] != nullptr )
+      {
+        continue;
+      }
+      lPlant = this->mEcosystem->choose( lChunk->index * CHUNK_WIDTH, ( lChunk->index + 1 ) * CHUNK_WIDTH,
+                                         ECO_SPROUT_AGE );
+      if ( lPlant == ECO_NONE )
+      {
+        break;
+      }
+      this->plant_tree( lChunk, lIndex, lPlant );
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+/*
+ * generate_step; does the next piece of work in generating a chunk; there's
+ *                one stage for the terrain and stars, and then one per tree.
+ */
+
+void Landscape::generate_step( chunk_t *pChunk )
+{
+  uint32_t     lRandom;
+  int_fast16_t lPlant;
+  Tree        *lTree;
+
+  /* The terrain and stars are cheap, so get done together. */
+  if ( pChunk->stage == CHUNK_STAGE_TERRAIN )
+  {
+    pChunk->rise_left = this->edge_rise( pChunk->index );
+    pChunk->rise_right = this->edge_rise( pChunk->index + 1 );
+
+    /* Stars are spread evenly across the columns, so that they're sorted by x. */
+    lRandom = pChunk->seed;
+    for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_STARS_MAX; lIndex++ )
+    {
+      pChunk->stars[lIndex].x = ( pChunk->index * CHUNK_WIDTH ) + ( lIndex * CHUNK_WIDTH / CHUNK_STARS_MAX )
+                              + ( random_next( &lRandom ) % ( CHUNK_WIDTH / CHUNK_STARS_MAX ) );
+      pChunk->stars[lIndex].y = TITLE_HEIGHT + ( random_next( &lRandom ) % ( GROUND_TOP - TITLE_HEIGHT ) );
+    }
+  }
+  else if ( pChunk->stage < CHUNK_STAGE_READY )
+  {
+    /* Each tree slot goes to the oldest plant left standing in the chunk, if there is one. */
+    lPlant = this->mEcosystem->choose( pChunk->index * CHUNK_WIDTH, ( pChunk->index + 1 ) * CHUNK_WIDTH,
+                                       AGE_DEATH - 1 );
+    if ( lPlant != ECO_NONE )
+    {
+      /* It's out of sight, so there's no need to watch it grow. */
+      lTree = this->plant_tree( pChunk, pChunk->stage - CHUNK_STAGE_TREES, lPlant );
+      lTree->animate( GROWTH_FRAMES );
+    }
+  }
+
+  /* Move on to the next stage. */
+  pChunk->stage++;
+  return;
+}
+
+
+/*
+ * update; called each frame with the camera position. Makes sure the chunks
+ *         around the camera are in the cache, and does one stage of work on
+ *         generating them - visible chunks first, then the one ahead, then
+ *         the one behind.
+ */
+
+void Landscape::update( int32_t pCamera )
+{
+  chunk_t *lChunk;
+  bool     lWorked = false;
+  int32_t  lIndex;
+
+  /* Tick the clock over, for the LRU. */
+  this->mClock++;
+
+  /* Work out the range of chunks that need to stay in the cache. */
+  this->mPinFirst = chunk_index( pCamera ) - 1;
+  this->mPinLast = chunk_index( pCamera + SCREEN_WIDTH - 1 ) + 1;
+
+  /* The ecosystem needs to be ahead of everything we might generate. */
+  this->mEcosystem->advance( this->mPinFirst );
+
+  /* Work through them in order of urgency; the one behind comes last. */
+  for ( lIndex = this->mPinFirst + 1; lIndex <= this->mPinLast + 1; lIndex++ )
+  {
+    lChunk = this->find_chunk( lIndex > this->mPinLast ? this->mPinFirst : lIndex );
+    if ( lChunk == nullptr )
+    {
+      lChunk = this->claim_chunk( lIndex > this->mPinLast ? this->mPinFirst : lIndex );
+    }
+    lChunk->last_used = this->mClock;
+
+    /* Only one stage of work per frame. */
+    if ( ( !lWorked ) && ( lChunk->stage != CHUNK_STAGE_READY ) )
+    {
+      this->generate_step( lChunk );
+      lWorked = true;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * chunk; fetches a chunk for rendering. If it isn't ready yet (which should
+ *        be rare, as we generate ahead of the camera) we have to finish the
+ *        job right now.
+ */
+
+chunk_t *Landscape::chunk( int32_t pIndex )
+{
+  chunk_t *lChunk = this->find_chunk( pIndex );
+
+  if ( lChunk == nullptr )
+  {
+    lChunk = this->claim_chunk( pIndex );
+  }
+  while( lChunk->stage != CHUNK_STAGE_READY )
+  {
+    this->generate_step( lChunk );
+  }
+
+  /* Remember it's been used, and return it. */
+  lChunk->last_used = this->mClock;
+  return lChunk;
+}
+
+
+/*
+ * cached; returns the chunk in the given cache slot, if it's ready for use;
+ *         this is how the world visits every live chunk.
+ */
+
+chunk_t *Landscape::cached( uint_fast8_t pSlot )
+{
+  if ( this->mChunks[pSlot].stage != CHUNK_STAGE_READY )
+  {
+    return nullptr;
+  }
+  return &this->mChunks[pSlot];
+}
+
+/* End of file landscape.cpp */
@@ -0,0 +1,84 @@
+/*
+ * landscape.hpp - part of Arborescence
+ *
+ * This header declares the Landscape class, which generates the endless world
+ * in chunks, and keeps a small cache of the chunks around the camera; along
+ * with the Ecosystem, which decides where its trees grow.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
+#include "offscreen.hpp"
+#include "tree.hpp"
+#include "ecosystem.hpp"
+
+
+/* Constants. */
+
+#define CHUNK_STAGE_EMPTY   0xFF
+#define CHUNK_STAGE_TERRAIN 0
+#define CHUNK_STAGE_TREES   1
+#define CHUNK_STAGE_READY   (CHUNK_STAGE_TREES + CHUNK_TREES_MAX)
+
+
+/* Structures. */
+
+typedef struct
+{
+  int32_t         index;
+  uint32_t        seed;
+  uint32_t        last_used;
+  uint_fast8_t    stage;
+  int_fast8_t     rise_left, rise_right;
+  pimoroni::Point stars[CHUNK_STARS_MAX];
+  Tree           *trees[CHUNK_TREES_MAX];
+  int16_t         plants[CHUNK_TREES_MAX];  /* The Ecosystem's record for each. */
+} chunk_t;
+
+
+/* Class declaration. */
+
+class Landscape
+{
+private:
+  RenderQueue                          *mQueue;
+  SpatialIndex                         *mIndex;
+  PatternLibrary                       *mPatterns;
+  OffscreenHeap                        *mOffscreen;
+  Ecosystem                            *mEcosystem;
+  uint32_t                              mSeed;
+  uint32_t                              mClock;
+  int32_t                               mPinFirst, mPinLast;
+  chunk_t                               mChunks[CHUNK_CACHE_SIZE];
+
+  chunk_t        *find_chunk( int32_t );
+  chunk_t        *claim_chunk( int32_t );
+  void            empty_chunk( chunk_t * );
+  void            generate_step( chunk_t * );
+  Tree           *plant_tree( chunk_t *, uint_fast8_t, int_fast16_t );
+  int_fast8_t     edge_rise( int32_t );
+
+public:
+                  Landscape( RenderQueue *, SpatialIndex *, PatternLibrary *, OffscreenHeap *, uint32_t );
+                 ~Landscape( void );
+
+  void            update( int32_t );
+  chunk_t        *chunk( int32_t );
+  chunk_t        *cached( uint_fast8_t );
+  bool            tick( void );
+  void            fell_tree( chunk_t *, uint_fast8_t );
+  bool            ground_span( const chunk_t *, int32_t, int32_t *, int32_t * );
+  int32_t         terrain_rise( int32_t );
+  static int32_t  chunk_index( int32_t );
+};
+
+/* End of file landscape.hpp */
@@ -9,6 +9,8 @@
 
 /* System header files. */
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -17,16 +19,46 @@
 
 #include "pico/rand.h"
 #include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/i2c.h"
+#include "hardware/uart.h"
 #include "drivers/dv_display/dv_display.hpp"
 #include "libraries/pico_graphics/pico_graphics_dv.hpp"
 
 #include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "arena.hpp"
+#include "bench.hpp"
+#include "ecosystem.hpp"
+#include "governor.hpp"
+#include "offscreen.hpp"
+#include "overlay.hpp"
+#include "profile.hpp"
+#include "recorder.hpp"
+#include "tree.hpp"
 #include "world.hpp"
 
 
 /* Functions. */
 
 
+/*
+ * clock_khz; finds the fastest clock speed, no faster than the one asked for,
+ *            that the PLL can actually make; not every speed is possible.
+ */
+
+static uint32_t clock_khz( uint32_t pKhz )
+{
+  uint lVco, lPostDiv1, lPostDiv2;
+
+  while( ( pKhz > 1000 ) && ( !check_sys_clock_khz( pKhz, &lVco, &lPostDiv1, &lPostDiv2 ) ) )
+  {
+    pKhz -= 1000;
+  }
+  return pKhz;
+}
+
+
 /*
  * main - the entry point to the program; this initialises the display,
  *        and provides the main render / update logic.
@@ -36,39 +68,280 @@ int main()
 {
   pimoroni::DVDisplay                  *lDisplay;
   pimoroni::PicoGraphics_PenDV_RGB555  *lGraphics;
+  RenderQueue                          *lQueue;
+  FrameArena                           *lArena;
+  OffscreenHeap                        *lOffscreen;
+  Profiler                             *lProfiler;
+  Governor                             *lGovernor;
+  FlightRecorder                       *lRecorder;
+  ClockOverlay                         *lClock;
   World                                *lWorld;
+  uint32_t                              lFrame = 0;
+  uint32_t                              lDiscPixels, lSpanPixels, lDropped;
+  uint32_t                              lRedirected, lShortened, lSuppressed;
+  eco_stats_t                           lEcoStats;
+  tree_tier_stats_t                     lTierStats;
+  arena_stats_t                         lArenaStats;
+  offscreen_stats_t                     lOffscreenStats;
+  rqstats_t                             lQueueStats;
+  int                                   lCommand;
+  int_fast8_t                           lClockDigits = CLOCK_IDLE;
+  uint_fast16_t                         lTime = 0;
+  uint32_t                              lClockTyped = 0;
+  uint32_t                              lClockLevels[GOVERNOR_LEVELS];
+  uint32_t                              lFrameStarted, lLastStarted, lRendered, lUpdated;
+  governor_sample_t                     lSample;
+  flight_frame_t                        lFlight;
+  uint_fast8_t                          lClockLevel;
 
   /* Normal Pico initialisation. */
   stdio_init_all();
 
-  /* Create the display, and the graphics driver. */
+  /* Create the display, and the graphics driver; the frame is wider than the screen. */
   lDisplay = new pimoroni::DVDisplay();
-  lGraphics = new pimoroni::PicoGraphics_PenDV_RGB555( SCREEN_WIDTH, SCREEN_HEIGHT, *lDisplay );
+  lGraphics = new pimoroni::PicoGraphics_PenDV_RGB555( FRAME_WIDTH, SCREEN_HEIGHT, *lDisplay );
 
   /* Now initialise the display. */
   lDisplay->preinit();
-  lDisplay->init( SCREEN_WIDTH, SCREEN_HEIGHT, pimoroni::DVDisplay::MODE_RGB555 );
+  lDisplay->init( SCREEN_WIDTH, SCREEN_HEIGHT, pimoroni::DVDisplay::MODE_RGB555, FRAME_WIDTH, SCREEN_HEIGHT );
 
   /* Initialise the random number generator (which ... will only be a bit random) */
   srand( get_rand_32() );
 
+  /* All the actual drawing is done on the other core, fed through a queue. */
+  lQueue = new RenderQueue( lDisplay, lGraphics );
+
+  /* Any scratch space needed while building a frame comes from the arena. */
+  lArena = new FrameArena();
+
+  /* And anything worth keeping longer can go in the PSRAM beyond the frame. */
+  lOffscreen = new OffscreenHeap( lQueue );
+
+  /* And the profiler sits idle until it's asked for. */
+  lProfiler = new Profiler();
+
+  /* The flight recorder, on the other hand, is always watching. */
+  lRecorder = new FlightRecorder();
+
+  /*
+   * The governor can drop the clock below whatever we booted at, but never
+   * above it; the PSRAM bus to the display driver is clocked from it. So the
+   * lower levels are fractions of it, rounded down to what the PLL can make.
+   */
+  lClockLevels[2] = clock_get_hz( clk_sys ) / 1000;
+  lClockLevels[1] = clock_khz( lClockLevels[2] * GOVERNOR_MID_PERCENT / 100 );
+  lClockLevels[0] = clock_khz( lClockLevels[2] * GOVERNOR_LOW_PERCENT / 100 );
+  lGovernor = new Governor( lClockLevels, GOVERNOR_LEVELS - 1 );
+  if ( GOVERNOR_TRACE )
+  {
+    /* A trace can't be replayed without knowing the speeds it was choosing between. */
+    printf( "@gov levels %" PRIu32 " %" PRIu32 " %" PRIu32 "\n", lClockLevels[0], lClockLevels[1], lClockLevels[2] );
+  }
+
+  /* The clock in the corner runs from the RTC. */
+  lClock = new ClockOverlay( lQueue, lGraphics );
+
   /* And finally, we need a World to handle everything. */
-  lWorld = new World( lDisplay, lGraphics );
+  lWorld = new World( lDisplay, lGraphics, lQueue, lArena, lOffscreen, lClock );
+
+  /* The World has finished setting up the display, so the queue can take over. */
+  lQueue->start();
+
+  /* If we've been built to, benchmark the drawing before we start. */
+  if ( BENCH_AT_BOOT )
+  {
+    Bench( lQueue, lArena ).run();
+    lWorld->invalidate();
+  }
+
+  /* Or profile it from the start. */
+  if ( PROFILE_AT_BOOT )
+  {
+    lProfiler->start();
+  }
 
   /* And enter into the display loop, forever! */
+  lLastStarted = time_us_32();
   while(true)
   {
-    /* We render first. */
+    lFrameStarted = time_us_32();
+    lFrame++;
+
+    /*
+     * The frame before last has been drawn, so its half of the arena is free
+     * again; this frame can have it.
+     */
+    lArena->reset();
+    lOffscreen->reset();
+
+    /* We render first; this just queues up the drawing for the other core. */
     lWorld->render();
+    lRendered = time_us_32();
 
-    /* Flip the display asynchronously. */
-    lDisplay->flip_async();
+    /* The flip goes into the queue too, once the frame is drawn. */
+    lQueue->flip();
 
     /* And we can update in parallel with that work. */
     lWorld->update();
+    lUpdated = time_us_32();
+    lSample.busy_us = lUpdated - lFrameStarted;
+
+    /* Make sure we don't get more than a frame ahead of the drawing. */
+    lQueue->wait_for_frame();
+
+    /* Keep a note of this frame, in case it (or one near it) turns out slow. */
+    if ( FLIGHT_RECORDER )
+    {
+      lFlight.frame = lFrame;
+      lFlight.frame_us = time_us_32() - lFrameStarted;
+      lFlight.render_us = lRendered - lFrameStarted;
+      lFlight.update_us = lUpdated - lRendered;
+      lFlight.raster_us = lQueue->raster_us();
+      lFlight.level = lGovernor->level();
+      lQueue->stats( &lQueueStats, false );
+      lFlight.commands = lQueueStats.commands;
+      Tree::canopy_stats( &lDiscPixels, &lSpanPixels, &lDropped, false );
+      lFlight.pixels = lSpanPixels;
+      lWorld->record( &lFlight );
+      lRecorder->record( &lFlight );
+    }
+
+    /* Every so often, report on how well we're doing; once the frame's been timed, so it's not held against it. */
+    if ( lFrame % STATS_INTERVAL == 0 )
+    {
+      Tree::canopy_stats( &lDiscPixels, &lSpanPixels, &lDropped, true );
+      if ( lDiscPixels > 0 )
+      {
+        printf( "Canopy: %" PRIu32 " pixels as spans, %" PRIu32 " as discs (%" PRIu32 "%% saved)\n",
+                lSpanPixels, lDiscPixels, 100 - (uint32_t)( (uint64_t)lSpanPixels * 100 / lDiscPixels ) );
+      }
+      if ( lDropped > 0 )
+      {
+        printf( "Canopy: %" PRIu32 " spans dropped for want of room; raise CANOPY_SPANS_MAX\n", lDropped );
+      }
+      Tree::light_stats( &lRedirected, &lShortened, &lSuppressed, true );
+      if ( lRedirected + lShortened + lSuppressed > 0 )
+      {
+        printf( "Light: %" PRIu32 " branches leant away, %" PRIu32 " cut short, %" PRIu32 " not grown\n",
+                lRedirected, lShortened, lSuppressed );
+      }
+      Ecosystem::stats( &lEcoStats, true );
+      printf( "Ecosystem: %d plants, %d shown, %" PRIu32 " seeds (%" PRIu32 " sprouted, %" PRIu32 " crowded, %" PRIu32
+              " no room), %" PRIu32 " died\n",
+              lEcoStats.plants, lEcoStats.shown, lEcoStats.seeds, lEcoStats.sprouted, lEcoStats.crowded,
+              lEcoStats.full, lEcoStats.deaths );
+      lArena->stats( &lArenaStats, true );
+      printf( "Arena: peak %" PRIu32 " of %" PRIu32 " bytes, %" PRIu32 " overflows\n",
+              lArenaStats.peak, lArenaStats.size, lArenaStats.overflows );
+      lOffscreen->stats( &lOffscreenStats, true );
+      printf( "Offscreen: %" PRIu32 " of %" PRIu32 " bytes in %d regions, peak %" PRIu32 ", %d evictions, %d failures\n",
+              lOffscreenStats.used, lOffscreenStats.size, lOffscreenStats.regions, lOffscreenStats.peak,
+              lOffscreenStats.evictions, lOffscreenStats.failures );
+      CanopyTier::stats( &lTierStats, true );
+      printf( "Residency: %d trees in PSRAM, canopy %" PRIu32 " bytes in SRAM, %" PRIu32 " in PSRAM; %" PRIu32
+              " evicted, %" PRIu32 " recalled, %" PRIu32 " bytes out, %" PRIu32 " in, %" PRIu32 " failures, %" PRIu32
+              " late\n",
+              lTierStats.trees, lTierStats.sram, lTierStats.psram, lTierStats.evictions, lTierStats.recalls,
+              lTierStats.written, lTierStats.read, lTierStats.failures, lTierStats.late );
+    }
+
+    /* Let the governor pick the clock speed for the next frame. */
+    if ( CLOCK_GOVERNOR )
+    {
+      lSample.frame_us = lFrameStarted - lLastStarted;
+      lSample.raster_us = lQueue->raster_us();
+      lSample.heavy_ahead = lWorld->heavy_ahead();
+      lLastStarted = lFrameStarted;
+      lClockLevel = lGovernor->level();
+      if ( lGovernor->decide( &lSample ) != lClockLevel )
+      {
+        /* Core 1 must be idle while the clock moves under it. */
+        lQueue->wait_for_idle();
+        if ( !set_sys_clock_khz( lGovernor->khz(), false ) )
+        {
+          /* Nothing has changed, so there's nothing to reset; just stay where we are. */
+          lGovernor->refuse( lClockLevel );
+        }
+        else
+        {
+          /* The UART and the display's I2C are clocked from the system clock too, so need resetting. */
+          uart_set_baudrate( uart_default, PICO_DEFAULT_UART_BAUD_RATE );
+          i2c_set_baudrate( DISPLAY_I2C, DISPLAY_I2C_BAUD );
+
+          /* As does the profiler's sample rate, if it's running. */
+          if ( lProfiler->running() )
+          {
+            lProfiler->stop();
+            lProfiler->start();
+          }
+        }
+      }
+      if ( GOVERNOR_TRACE )
+      {
+        printf( "@gov %" PRIu32 " %" PRIu32 " %" PRIu32 " %d %d\n", lSample.frame_us, lSample.busy_us,
+                lSample.raster_us, lSample.heavy_ahead ? 1 : 0, (int)lGovernor->level() );
+      }
+    }
+
+    /* Stream out a few profile samples, if we're collecting them. */
+    if ( lProfiler->running() )
+    {
+      lProfiler->drain( PROFILE_DRAIN_MAX );
+    }
+
+    /* And the flight recorder's last few frames, if something ran slow. */
+    if ( lRecorder->dumping() )
+    {
+      lRecorder->drain( RECORDER_DRAIN_MAX );
+    }
 
-    /* Last thing, wait for the flip to complete and keep us sync'd to VSYNC */
-    lDisplay->wait_for_flip();
+    /* A benchmark, profiling or setting the clock can be asked for over the UART at any time. */
+    lCommand = getchar_timeout_us( 0 );
+    if ( lClockDigits != CLOCK_IDLE )
+    {
+      /*
+       * Part way through setting the clock; the digits are picked up a frame
+       * at a time as they arrive, so that nothing waits for the typist. Give
+       * up on anything that isn't a digit, or if the next one is too long.
+       */
+      if ( ( lCommand >= '0' ) && ( lCommand <= '9' ) )
+      {
+        lTime = lTime * 10 + lCommand - '0';
+        lClockTyped = lFrameStarted;
+        if ( ++lClockDigits == CLOCK_DIGITS )
+        {
+          lClock->set( lTime / 100, lTime % 100 );
+          lClockDigits = CLOCK_IDLE;
+        }
+      }
+      else if ( ( lCommand != PICO_ERROR_TIMEOUT ) || ( lFrameStarted - lClockTyped > CLOCK_DIGIT_US ) )
+      {
+        lClockDigits = CLOCK_IDLE;
+      }
+    }
+    else if ( lCommand == BENCH_TRIGGER )
+    {
+      Bench( lQueue, lArena ).run();
+      lWorld->invalidate();
+    }
+    else if ( lCommand == PROFILE_TRIGGER )
+    {
+      if ( lProfiler->running() )
+      {
+        lProfiler->stop();
+      }
+      else
+      {
+        lProfiler->start();
+      }
+    }
+    else if ( lCommand == CLOCK_TRIGGER )
+    {
+      /* The time follows as four digits, HHMM. */
+      lTime = 0;
+      lClockDigits = 0;
+      lClockTyped = lFrameStarted;
+    }
   }
 }
 
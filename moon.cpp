@@ -0,0 +1,131 @@
+/*
+ * moon.cpp - part of Arborescence
+ *
+ * Generates the moon sprite for each phase. Only the one base image lives in
+ * flash; each phase is cut from it by working out, row by row, where the
+ * terminator (the line between day and night on the moon) falls, and only
+ * keeping the lit side. The base image is a crescent, so anywhere lit that
+ * the base doesn't cover is filled in with its average colour.
+ *
+ * Everything is done in integers, measured in half pixels from the centre of
+ * the disc, and is cheap enough to do in the idle time of a single frame.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdint.h>
+
+
+/* Local header files. */
+
+#include "arborescence.hpp"
+
+
+/* Module variables. */
+
+/* The cosine of each phase's angle through the cycle, in 8.8 fixed point. */
+static const int16_t m_phase_cos[MOON_PHASES] =
+{
+  256, 237, 181, 98, 0, -98, -181, -237, -256, -237, -181, -98, 0, 98, 181, 237
+};
+
+
+/* Functions. */
+
+
+/*
+ * moon_root; a small integer square root, good enough for the half widths
+ *            of the rows of the moon.
+ */
+
+static int_fast32_t moon_root( int_fast32_t pValue )
+{
+  int_fast32_t lRoot = 0;
+
+  while ( ( lRoot + 1 ) * ( lRoot + 1 ) <= pValue )
+  {
+    lRoot++;
+  }
+  return lRoot;
+}
+
+
+/*
+ * moon_phase; fills in a moon sprite for the given phase; zero is a new moon,
+ *             and halfway through the cycle is a full one. As seen from
+ *             the north, it's lit from the right as it waxes, and the dark
+ *             follows on from the right as it wanes.
+ */
+
+void moon_phase( uint16_t *pSprite, const uint16_t *pBase, uint_fast8_t pPhase )
+{
+  const int_fast32_t  lRadius = MOON_RADIUS * 2;
+  uint32_t            lRed = 0, lGreen = 0, lBlue = 0, lCount = 0;
+  uint16_t            lFill;
+  int_fast32_t        lX, lY, lHalfWidth, lTerminator;
+  bool                lLit;
+
+  /* Work out the average colour of the base image, for filling in with. */
+  for ( uint_fast16_t lPixel = 0; lPixel < MOON_SIZE * MOON_SIZE; lPixel++ )
+  {
+    if ( pBase[lPixel] & 0x8000 )
+    {
+      lRed += ( pBase[lPixel] >> 10 ) & 0x1F;
+      lGreen += ( pBase[lPixel] >> 5 ) & 0x1F;
+      lBlue += pBase[lPixel] & 0x1F;
+      lCount++;
+    }
+  }
+  lFill = lCount ? 0x8000 | ( ( lRed / lCount ) << 10 ) | ( ( lGreen / lCount ) << 5 ) | ( lBlue / lCount ) : 0;
+
+  /* Now work through the sprite, a row at a time. */
+  pPhase %= MOON_PHASES;
+  for ( uint_fast8_t lRow = 0; lRow < MOON_SIZE; lRow++ )
+  {
+    /* The terminator crosses each row at the cosine of the phase across it. */
+    lY = lRow * 2 + 1 - MOON_SIZE;
+    lHalfWidth = ( lY * lY < lRadius * lRadius ) ? moon_root( lRadius * lRadius - lY * lY ) : -1;
+    lTerminator = m_phase_cos[pPhase] * lHalfWidth;
+
+    for ( uint_fast8_t lColumn = 0; lColumn < MOON_SIZE; lColumn++ )
+    {
+      lX = lColumn * 2 + 1 - MOON_SIZE;
+
+      /* Outside the disc is never lit; inside, it depends which side of the terminator. */
+      if ( ( lX < -lHalfWidth ) || ( lX > lHalfWidth ) )
+      {
+        lLit = false;
+      }
+      else if ( pPhase <= MOON_PHASES / 2 )
+      {
+        lLit = lX * 256 > lTerminator;
+      }
+      else
+      {
+        lLit = -lX * 256 > lTerminator;
+      }
+
+      /* Lit pixels come from the base image, if it has one there. */
+      if ( !lLit )
+      {
+        pSprite[lRow * MOON_SIZE + lColumn] = 0;
+      }
+      else if ( pBase[lRow * MOON_SIZE + lColumn] & 0x8000 )
+      {
+        pSprite[lRow * MOON_SIZE + lColumn] = pBase[lRow * MOON_SIZE + lColumn];
+      }
+      else
+      {
+        pSprite[lRow * MOON_SIZE + lColumn] = lFill;
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+/* End of file moon.cpp */
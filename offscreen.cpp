@@ -0,0 +1,376 @@
+/*
+ * offscreen.cpp - part of Arborescence
+ *
+ * Implements the OffscreenHeap class. The PSRAM behind the display holds far
+ * more than the frame; everything between OFFSCREEN_BASE and the sprite data
+ * is handed out here, as regions aligned to suit the burst transfers that
+ * move data in and out of it.
+ *
+ * Only the bookkeeping happens on core 0; reads and writes go through the
+ * render queue, like everything else that touches the display. Note that the
+ * PSRAM is in two banks, just like the frame, and a write only lands in the
+ * bank currently being drawn into; anything needed in both must be written
+ * on two consecutive frames.
+ *
+ * Every region has a lifetime. Pinned ones stay until they're freed; cached
+ * ones may be evicted (least recently touched first) to make room, and the
+ * owner is told through its callback; frame ones are freed automatically,
+ * once the frame after next starts, just like the arena.
+ *
+ * The host tests have no PSRAM, or render queue, so the same space is stood
+ * in for by ordinary memory, and reads and writes are simple copies.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#if PICO_ON_DEVICE
+#include "renderqueue.hpp"
+#endif
+#include "offscreen.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; starts with every region free.
+ */
+
+OffscreenHeap::OffscreenHeap( RenderQueue *pQueue )
+{
+  /* Save the queue we read and write through. */
+  this->mQueue = pQueue;
+
+  /* Nothing is allocated yet. */
+  for ( uint_fast8_t lIndex = 0; lIndex < OFFSCREEN_REGIONS_MAX; lIndex++ )
+  {
+    this->mRegions[lIndex].used = false;
+  }
+  this->mFrame = 0;
+  this->mBank = 0;
+  this->mUsed = this->mPeak = 0;
+  this->mEvictions = this->mFailures = 0;
+
+#if !PICO_ON_DEVICE
+  /* On the host, ordinary memory stands in for the PSRAM. */
+  this->mMemory = (uint8_t *)malloc( OFFSCREEN_LIMIT - OFFSCREEN_BASE );
+#endif
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * destructor; only the host has anything to give back.
+ */
+
+OffscreenHeap::~OffscreenHeap( void )
+{
+#if !PICO_ON_DEVICE
+  ::free( this->mMemory );
+#endif
+  return;
+}
+
+
+/*
+ * find_space; looks for the lowest address where a region of the given size
+ *             would fit, without overlapping any other. Regions are packed
+ *             from the base up, so a space can only start at the base or at
+ *             the end of another region. Returns 0 if there isn't one.
+ */
+
+uint32_t OffscreenHeap::find_space( uint32_t pSize )
+{
+  uint32_t lBest = 0, lStart;
+  bool     lClear;
+
+  for ( int_fast8_t lCandidate = -1; lCandidate < OFFSCREEN_REGIONS_MAX; lCandidate++ )
+  {
+    /* Each candidate is the base, or the end of a region in use. */
+    if ( lCandidate < 0 )
+    {
+      lStart = OFFSCREEN_BASE;
+    }
+    else if ( this->mRegions[lCandidate].used )
+    {
+      lStart = this->mRegions[lCandidate].address + this->mRegions[lCandidate].size;
+    }
+    else
+    {
+      continue;
+    }
+    if ( ( lStart + pSize > OFFSCREEN_LIMIT ) || ( ( lBest != 0 ) && ( lStart >= lBest ) ) )
+    {
+      continue;
+    }
+
+    /* It has to be clear of everything else. */
+    lClear = true;
+    for ( uint_fast8_t lIndex = 0; ( lClear ) && ( lIndex < OFFSCREEN_REGIONS_MAX ); lIndex++ )
+    {
+      if ( ( this->mRegions[lIndex].used ) &&
+           ( this->mRegions[lIndex].address < lStart + pSize ) &&
+           ( this->mRegions[lIndex].address + this->mRegions[lIndex].size > lStart ) )
+      {
+        lClear = false;
+      }
+    }
+    if ( lClear )
+    {
+      lBest = lStart;
+    }
+  }
+
+  return lBest;
+}
+
+
+/*
+ * evict_one; throws out the least recently touched cached region, telling
+ *            its owner. Returns false if there was nothing to evict.
+ */
+
+bool OffscreenHeap::evict_one( void )
+{
+  int_fast8_t lOldest = OFFSCREEN_NONE;
+
+  for ( uint_fast8_t lIndex = 0; lIndex < OFFSCREEN_REGIONS_MAX; lIndex++ )
+  {
+    if ( ( this->mRegions[lIndex].used ) && ( this->mRegions[lIndex].lifetime == OFFSCREEN_CACHED ) &&
+         ( ( lOldest == OFFSCREEN_NONE ) || ( this->mRegions[lIndex].touched < this->mRegions[lOldest].touched ) ) )
+    {
+      lOldest = lIndex;
+    }
+  }
+  if ( lOldest == OFFSCREEN_NONE )
+  {
+    return false;
+  }
+
+  /* Let the owner know first, so that it stops using it. */
+  if ( this->mRegions[lOldest].evict != nullptr )
+  {
+    this->mRegions[lOldest].evict( this->mRegions[lOldest].owner, lOldest );
+  }
+  this->free( lOldest );
+  this->mEvictions++;
+  return true;
+}
+
+
+/*
+ * alloc; finds room for a region of the given size and lifetime, evicting
+ *        cached regions if we have to. The eviction callback (which may be
+ *        null) is given the owner and the handle. Returns the handle, or
+ *        OFFSCREEN_NONE if there's no room even so.
+ */
+
+int_fast8_t OffscreenHeap::alloc( uint32_t pSize, uint8_t pLifetime, offscreen_evict_t pEvict, void *pOwner )
+{
+  int_fast8_t lHandle = OFFSCREEN_NONE;
+  uint32_t    lAddress;
+
+  /* Whole bursts only, so that the next region is aligned too. */
+  pSize = ( pSize + OFFSCREEN_ALIGN - 1 ) & ~( OFFSCREEN_ALIGN - 1 );
+
+  /* No point evicting anything for a region that could never fit. */
+  if ( ( pSize == 0 ) || ( pSize > OFFSCREEN_LIMIT - OFFSCREEN_BASE ) )
+  {
+    this->mFailures++;
+    return OFFSCREEN_NONE;
+  }
+
+  /* We need a free slot in the table... */
+  for ( uint_fast8_t lIndex = 0; lIndex < OFFSCREEN_REGIONS_MAX; lIndex++ )
+  {
+    if ( !this->mRegions[lIndex].used )
+    {
+      lHandle = lIndex;
+      break;
+    }
+  }
+  if ( ( lHandle == OFFSCREEN_NONE ) && ( this->evict_one() ) )
+  {
+    return this->alloc( pSize, pLifetime, pEvict, pOwner );
+  }
+
+  /* ...and somewhere to put it. */
+  while( ( lHandle != OFFSCREEN_NONE ) && ( ( lAddress = this->find_space( pSize ) ) == 0 ) )
+  {
+    if ( !this->evict_one() )
+    {
+      lHandle = OFFSCREEN_NONE;
+    }
+  }
+  if ( lHandle == OFFSCREEN_NONE )
+  {
+    this->mFailures++;
+    return OFFSCREEN_NONE;
+  }
+
+  /* Fill it in, and keep track of how much we're using. */
+  this->mRegions[lHandle].address = lAddress;
+  this->mRegions[lHandle].size = pSize;
+  this->mRegions[lHandle].touched = this->mFrame;
+  this->mRegions[lHandle].evict = pEvict;
+  this->mRegions[lHandle].owner = pOwner;
+  this->mRegions[lHandle].lifetime = pLifetime;
+  this->mRegions[lHandle].bank = this->mBank;
+  this->mRegions[lHandle].used = true;
+  this->mUsed += pSize;
+  if ( this->mUsed > this->mPeak )
+  {
+    this->mPeak = this->mUsed;
+  }
+
+  return lHandle;
+}
+
+
+/*
+ * free; gives a region back. Nothing already queued to read or write it must
+ *       still be waiting to be drawn.
+ */
+
+void OffscreenHeap::free( int_fast8_t pHandle )
+{
+  if ( ( pHandle < 0 ) || ( pHandle >= OFFSCREEN_REGIONS_MAX ) || ( !this->mRegions[pHandle].used ) )
+  {
+    return;
+  }
+  this->mRegions[pHandle].used = false;
+  this->mUsed -= this->mRegions[pHandle].size;
+}
+
+
+/*
+ * reset; called once a frame, alongside the arena. Moves the clock on for
+ *        eviction, and frees any frame regions from the frame before last,
+ *        which has been drawn by now.
+ */
+
+void OffscreenHeap::reset( void )
+{
+  this->mFrame++;
+  this->mBank ^= 1;
+  for ( uint_fast8_t lIndex = 0; lIndex < OFFSCREEN_REGIONS_MAX; lIndex++ )
+  {
+    if ( ( this->mRegions[lIndex].used ) && ( this->mRegions[lIndex].lifetime == OFFSCREEN_FRAME ) &&
+         ( this->mRegions[lIndex].bank == this->mBank ) )
+    {
+      this->free( lIndex );
+    }
+  }
+}
+
+
+/*
+ * touch; notes that a region is still in use, so that it's the last to be
+ *        evicted.
+ */
+
+void OffscreenHeap::touch( int_fast8_t pHandle )
+{
+  this->mRegions[pHandle].touched = this->mFrame;
+}
+
+
+/*
+ * address; returns the PSRAM address of a region.
+ */
+
+uint32_t OffscreenHeap::address( int_fast8_t pHandle )
+{
+  return this->mRegions[pHandle].address;
+}
+
+
+/*
+ * write; queues a write of some words into a region, at a byte offset which
+ *        should be word aligned. The data isn't copied, so must stay put
+ *        until the queue has drawn it; the arena is ideal.
+ */
+
+void OffscreenHeap::write( int_fast8_t pHandle, uint32_t pOffset, const uint32_t *pData, uint32_t pWords )
+{
+  this->touch( pHandle );
+#if PICO_ON_DEVICE
+  this->mQueue->psram_write( this->mRegions[pHandle].address + pOffset, pData, pWords );
+#else
+  memcpy( this->mMemory + this->mRegions[pHandle].address - OFFSCREEN_BASE + pOffset, pData, pWords * 4 );
+#endif
+}
+
+
+/*
+ * fetch; queues a read of some words back out of a region. Nothing is there
+ *        to use until the queue has drawn it; several fetches can share a
+ *        single wait for the queue to go idle.
+ */
+
+void OffscreenHeap::fetch( int_fast8_t pHandle, uint32_t pOffset, uint32_t *pData, uint32_t pWords )
+{
+  this->touch( pHandle );
+#if PICO_ON_DEVICE
+  this->mQueue->psram_read( this->mRegions[pHandle].address + pOffset, pData, pWords );
+#else
+  memcpy( pData, this->mMemory + this->mRegions[pHandle].address - OFFSCREEN_BASE + pOffset, pWords * 4 );
+#endif
+}
+
+
+/*
+ * read; reads some words back out of a region. This waits for the queue to
+ *       drain, so it's not something to do in the middle of a frame.
+ */
+
+void OffscreenHeap::read( int_fast8_t pHandle, uint32_t pOffset, uint32_t *pData, uint32_t pWords )
+{
+  this->fetch( pHandle, pOffset, pData, pWords );
+#if PICO_ON_DEVICE
+  this->mQueue->wait_for_idle();
+#endif
+}
+
+
+/*
+ * stats; reports how much space there is, how much is in use now and at most,
+ *        how many regions are live, and how often we've had to evict or
+ *        failed altogether. Optionally resets the peak and the counts.
+ */
+
+void OffscreenHeap::stats( offscreen_stats_t *pStats, bool pReset )
+{
+  pStats->size = OFFSCREEN_LIMIT - OFFSCREEN_BASE;
+  pStats->used = this->mUsed;
+  pStats->peak = this->mPeak;
+  pStats->evictions = this->mEvictions;
+  pStats->failures = this->mFailures;
+  pStats->regions = 0;
+  for ( uint_fast8_t lIndex = 0; lIndex < OFFSCREEN_REGIONS_MAX; lIndex++ )
+  {
+    pStats->regions += this->mRegions[lIndex].used ? 1 : 0;
+  }
+
+  if ( pReset )
+  {
+    this->mPeak = this->mUsed;
+    this->mEvictions = this->mFailures = 0;
+  }
+}
+
+/* End of file offscreen.cpp */
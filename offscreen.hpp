@@ -0,0 +1,96 @@
+/*
+ * offscreen.hpp - part of Arborescence
+ *
+ * This header declares the OffscreenHeap class; a manager for the PSRAM that
+ * sits beyond the frame, for caches of things which are expensive to draw
+ * but cheap to copy back.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+
+/* Only the device build ever talks to the queue; the host tests don't have one. */
+class RenderQueue;
+
+
+/* Constants. */
+
+#define OFFSCREEN_BASE          0x100000    /* Clear of the frame, and its line table. */
+#define OFFSCREEN_LIMIT         0x400000    /* The display driver keeps its sprites above here. */
+#define OFFSCREEN_ALIGN         64          /* Regions start (and end) on a burst boundary. */
+#define OFFSCREEN_REGIONS_MAX   32
+#define OFFSCREEN_NONE          -1
+
+/* How long a region lives for. */
+#define OFFSCREEN_PINNED        0       /* Until it's freed. */
+#define OFFSCREEN_CACHED        1       /* Until it's freed, or evicted to make room. */
+#define OFFSCREEN_FRAME         2       /* Until the frame after next; like the arena. */
+
+
+/* Structures. */
+
+typedef void (*offscreen_evict_t)( void *, int_fast8_t );
+
+typedef struct
+{
+  uint32_t          address;
+  uint32_t          size;
+  uint32_t          touched;        /* The frame it was last used in. */
+  offscreen_evict_t evict;
+  void             *owner;
+  uint8_t           lifetime;
+  uint8_t           bank;
+  bool              used;
+} offscreen_region_t;
+
+typedef struct
+{
+  uint32_t        size;
+  uint32_t        used;
+  uint32_t        peak;
+  uint16_t        regions;
+  uint16_t        evictions;
+  uint16_t        failures;
+} offscreen_stats_t;
+
+
+/* Class declaration. */
+
+class OffscreenHeap
+{
+private:
+  RenderQueue                          *mQueue;
+  offscreen_region_t                    mRegions[OFFSCREEN_REGIONS_MAX];
+  uint32_t                              mFrame;
+  uint_fast8_t                          mBank;
+  uint32_t                              mUsed, mPeak;
+  uint16_t                              mEvictions, mFailures;
+#if !PICO_ON_DEVICE
+  uint8_t                              *mMemory;
+#endif
+
+  uint32_t        find_space( uint32_t );
+  bool            evict_one( void );
+
+public:
+                  OffscreenHeap( RenderQueue * );
+                 ~OffscreenHeap( void );
+
+  int_fast8_t     alloc( uint32_t, uint8_t, offscreen_evict_t, void * );
+  void            free( int_fast8_t );
+  void            reset( void );
+  void            touch( int_fast8_t );
+  uint32_t        address( int_fast8_t );
+  void            write( int_fast8_t, uint32_t, const uint32_t *, uint32_t );
+  void            fetch( int_fast8_t, uint32_t, uint32_t *, uint32_t );
+  void            read( int_fast8_t, uint32_t, uint32_t *, uint32_t );
+  void            stats( offscreen_stats_t *, bool );
+};
+
+/* End of file offscreen.hpp */
@@ -0,0 +1,176 @@
+/*
+ * overlay.cpp - part of Arborescence
+ *
+ * Implements the ClockOverlay class. The clock is laid out as a row of fixed
+ * size cells, one per character, in the top right corner of the title band.
+ * We remember what each buffer last showed in every cell, and only repaint
+ * (background, then glyph) the cells which differ; so normally that's one
+ * cell a minute, in each buffer in turn.
+ *
+ * The title band is only otherwise painted during a full repaint, which is
+ * when the world invalidates the current buffer's cells.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <string.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+#include "hardware/rtc.h"
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "overlay.hpp"
+
+
+/* Module variables. */
+
+/* The queue doesn't copy text, so every glyph lives here. */
+static const char m_glyphs[][2] =
+{
+  "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ":"
+};
+
+
+/* Functions. */
+
+
+/*
+ * constructor; works out how big the cells need to be for the widest digit,
+ *              and gets the RTC running.
+ */
+
+ClockOverlay::ClockOverlay( RenderQueue *pQueue, pimoroni::PicoGraphics_PenDV_RGB555 *pGraphics )
+{
+  int32_t lWidth;
+
+  /* Save the queue we draw through. */
+  this->mQueue = pQueue;
+
+  /* Cells are all the same width, so a changing digit never moves its neighbours. */
+  pGraphics->set_font( "bitmap8" );
+  this->mCellWidth = 0;
+  for ( uint_fast8_t lGlyph = 0; lGlyph < sizeof( m_glyphs ) / sizeof( m_glyphs[0] ); lGlyph++ )
+  {
+    lWidth = pGraphics->measure_text( m_glyphs[lGlyph] );
+    if ( lWidth > this->mCellWidth )
+    {
+      this->mCellWidth = lWidth;
+    }
+  }
+  this->mLeft = SCREEN_WIDTH - CLOCK_MARGIN - CLOCK_CELLS * this->mCellWidth;
+
+  /* Nothing has been drawn in either buffer yet. */
+  memset( this->mShownFG, 0, CLOCK_CELLS );
+  memset( this->mShownBG, 0, CLOCK_CELLS );
+
+  /* The RTC starts at midnight, until someone tells us otherwise. */
+  rtc_init();
+  this->set( 0, 0 );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * now; fills in the characters the clock should be showing right now.
+ */
+
+void ClockOverlay::now( char *pCells )
+{
+  datetime_t lNow;
+
+  rtc_get_datetime( &lNow );
+  pCells[0] = '0' + lNow.hour / 10;
+  pCells[1] = '0' + lNow.hour % 10;
+  pCells[2] = ':';
+  pCells[3] = '0' + lNow.min / 10;
+  pCells[4] = '0' + lNow.min % 10;
+}
+
+
+/*
+ * set; sets the RTC to the given time.
+ */
+
+void ClockOverlay::set( uint_fast8_t pHour, uint_fast8_t pMinute )
+{
+  datetime_t lNow = { 2023, 1, 1, 0, (int8_t)( pHour % 24 ), (int8_t)( pMinute % 60 ), 0 };
+  rtc_set_datetime( &lNow );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * invalidate; forgets what the current buffer shows, so every cell will be
+ *             redrawn; called when the title band has been repainted.
+ */
+
+void ClockOverlay::invalidate( void )
+{
+  memset( this->mShownFG, 0, CLOCK_CELLS );
+}
+
+
+/*
+ * swap; moves on to the other buffer, once a frame.
+ */
+
+void ClockOverlay::swap( void )
+{
+  char lTemp[CLOCK_CELLS];
+
+  memcpy( lTemp, this->mShownBG, CLOCK_CELLS );
+  memcpy( this->mShownBG, this->mShownFG, CLOCK_CELLS );
+  memcpy( this->mShownFG, lTemp, CLOCK_CELLS );
+}
+
+
+/*
+ * render; repaints any cells which this buffer doesn't show correctly, over
+ *         the sky colour we're given; returns how many needed doing.
+ */
+
+uint_fast8_t ClockOverlay::render( uint16_t pSkyPen )
+{
+  char          lCells[CLOCK_CELLS];
+  uint_fast8_t  lDrawn = 0;
+  int32_t       lLeft;
+
+  this->now( lCells );
+  for ( uint_fast8_t lCell = 0; lCell < CLOCK_CELLS; lCell++ )
+  {
+    if ( lCells[lCell] == this->mShownFG[lCell] )
+    {
+      continue;
+    }
+
+    /* Blank just this cell, and draw the new glyph into it. */
+    lLeft = this->mLeft + lCell * this->mCellWidth;
+    this->mQueue->set_depth( 0 );
+    this->mQueue->set_pen( pSkyPen );
+    this->mQueue->rectangle( pimoroni::Rect( lLeft, 1, this->mCellWidth, 16 ) );
+    this->mQueue->set_depth( 1 );
+    this->mQueue->set_pen( 255, 255, 255 );
+    this->mQueue->text(
+      m_glyphs[lCells[lCell] == ':' ? 10 : lCells[lCell] - '0'], pimoroni::Point( lLeft, 1 ), SCREEN_WIDTH
+    );
+
+    this->mShownFG[lCell] = lCells[lCell];
+    lDrawn++;
+  }
+
+  return lDrawn;
+}
+
+/* End of file overlay.cpp */
@@ -0,0 +1,50 @@
+/*
+ * overlay.hpp - part of Arborescence
+ *
+ * This header declares the ClockOverlay class; a small clock in the corner of
+ * the title band, showing the time from the RTC, which only ever redraws the
+ * digits that have changed.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "renderqueue.hpp"
+
+
+/* Constants. */
+
+#define CLOCK_TRIGGER   't'     /* Followed by HHMM, to set the time. */
+#define CLOCK_DIGITS    4
+#define CLOCK_DIGIT_US  1000000 /* Give up waiting for the next digit after this long. */
+#define CLOCK_IDLE      -1
+#define CLOCK_CELLS     5       /* HH:MM */
+#define CLOCK_MARGIN    4
+
+
+/* Class declaration. */
+
+class ClockOverlay
+{
+private:
+  RenderQueue                          *mQueue;
+  int32_t                               mCellWidth, mLeft;
+  char                                  mShownFG[CLOCK_CELLS], mShownBG[CLOCK_CELLS];
+
+  void            now( char * );
+
+public:
+                  ClockOverlay( RenderQueue *, pimoroni::PicoGraphics_PenDV_RGB555 * );
+
+  void            set( uint_fast8_t, uint_fast8_t );
+  void            invalidate( void );
+  void            swap( void );
+  uint_fast8_t    render( uint16_t );
+};
+
+/* End of file overlay.hpp */
@@ -0,0 +1,212 @@
+/*
+ * pattern.cpp - part of Arborescence
+ *
+ * Implements the PatternLibrary class. A fixed number of subtrees are grown
+ * from the world seed at startup, using the same rules as a tree's own
+ * branches; trees then refer to them by pattern number and orientation. The
+ * branches are stored relative to the root of the pattern, in breadth first
+ * order, so the children of branch N are branches 2N+2 and 2N+3.
+ *
+ * The merged leaf spans of each level of each pattern are worked out once,
+ * here, rather than every time a tree using it is drawn.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Local header files. */
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "pattern.hpp"
+#include "tree.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; grows every pattern in the library, from the given seed. If
+ *              there isn't the memory for all of them, the library is left
+ *              empty, and not ready; trees will have to grow their own.
+ */
+
+PatternLibrary::PatternLibrary( uint32_t pSeed )
+{
+  for ( uint_fast8_t lIndex = 0; lIndex < PATTERN_COUNT; lIndex++ )
+  {
+    for ( uint_fast8_t lDepth = 0; lDepth < PATTERN_DEPTH; lDepth++ )
+    {
+      this->mPatterns[lIndex].canopy[lDepth] = nullptr;
+      this->mPatterns[lIndex].canopy_spans[lDepth] = 0;
+    }
+  }
+
+  this->mReady = true;
+  for ( uint_fast8_t lIndex = 0; ( lIndex < PATTERN_COUNT ) && this->mReady; lIndex++ )
+  {
+    this->mReady = this->generate( &this->mPatterns[lIndex], random_hash( pSeed, lIndex ) );
+  }
+
+  /* Half a library is no use to anyone, so give back what we did manage. */
+  if ( !this->mReady )
+  {
+    for ( uint_fast8_t lIndex = 0; lIndex < PATTERN_COUNT; lIndex++ )
+    {
+      for ( uint_fast8_t lDepth = 0; lDepth < PATTERN_DEPTH; lDepth++ )
+      {
+        free( this->mPatterns[lIndex].canopy[lDepth] );
+        this->mPatterns[lIndex].canopy[lDepth] = nullptr;
+        this->mPatterns[lIndex].canopy_spans[lDepth] = 0;
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * destructor; frees up the canopy spans of each pattern.
+ */
+
+PatternLibrary::~PatternLibrary( void )
+{
+  for ( uint_fast8_t lIndex = 0; lIndex < PATTERN_COUNT; lIndex++ )
+  {
+    for ( uint_fast8_t lDepth = 0; lDepth < PATTERN_DEPTH; lDepth++ )
+    {
+      free( this->mPatterns[lIndex].canopy[lDepth] );
+    }
+  }
+  return;
+}
+
+
+/*
+ * ready; returns true if every pattern was grown, and can be borrowed from.
+ */
+
+bool PatternLibrary::ready( void )
+{
+  return this->mReady;
+}
+
+
+/*
+ * first_branch; returns the index of the first branch at a given depth within
+ *               a pattern; there are twice as many at each depth.
+ */
+
+uint_fast8_t PatternLibrary::first_branch( uint_fast8_t pDepth )
+{
+  return ( 2 << pDepth ) - 2;
+}
+
+
+/*
+ * generate; grows a single pattern, a depth at a time, and then merges the
+ *           leaves at each depth into spans. Returns false if there wasn't
+ *           the memory to keep them.
+ */
+
+bool PatternLibrary::generate( pattern_t *pPattern, uint32_t pSeed )
+{
+  canopy_span_t  *lSpans = (canopy_span_t *)malloc( sizeof( canopy_span_t ) * CANOPY_SPANS_MAX );
+  pimoroni::Point lParent;
+  uint32_t        lRandom = pSeed ? pSeed : 1;
+  uint_fast8_t    lHeight, lFirst, lLast, lIndex;
+
+  if ( lSpans == nullptr )
+  {
+    return false;
+  }
+
+  for ( uint_fast8_t lDepth = 0; lDepth < PATTERN_DEPTH; lDepth++ )
+  {
+    /* Branches at this depth grow from a parent at this height in the tree. */
+    lHeight = PATTERN_ROOT_LEVEL + lDepth;
+    lFirst = PatternLibrary::first_branch( lDepth );
+    lLast = PatternLibrary::first_branch( lDepth + 1 );
+
+    for ( lIndex = lFirst; lIndex < lLast; lIndex += 2 )
+    {
+      lParent = lDepth == 0 ? pimoroni::Point( 0, 0 ) : pPattern->ends[(lIndex-2)/2];
+
+      /* Exactly as a tree would grow its own pair of branches. */
+      for ( uint_fast8_t lSide = 0; lSide < 2; lSide++ )
+      {
+        pPattern->ends[lIndex+lSide].x = lParent.x + random_next( &lRandom ) % ( 60 / lHeight );
+        pPattern->ends[lIndex+lSide].y = lParent.y - ( SCREEN_HEIGHT / 16 ) / lHeight -
+                                         random_next( &lRandom ) % ( ( SCREEN_HEIGHT / 4 ) / lHeight );
+      }
+      pPattern->ends[lIndex].x -= ( 60 / lHeight );
+      pPattern->ends[lIndex+1].x += ( 30 / lHeight );
+    }
+
+    /* And merge the leaves at the end of them, a level up, keeping a copy of the spans. */
+    pPattern->canopy_spans[lDepth] = Tree::build_canopy(
+      &pPattern->ends[lFirst], lLast - lFirst, Tree::leaf_radius( lHeight + 1 ),
+      lSpans, CANOPY_SPANS_MAX, &pPattern->canopy_discs[lDepth]
+    );
+    pPattern->canopy[lDepth] = (canopy_span_t *)malloc( sizeof( canopy_span_t ) * pPattern->canopy_spans[lDepth] );
+    if ( ( pPattern->canopy[lDepth] == nullptr ) && ( pPattern->canopy_spans[lDepth] > 0 ) )
+    {
+      free( lSpans );
+      return false;
+    }
+    memcpy( pPattern->canopy[lDepth], lSpans, sizeof( canopy_span_t ) * pPattern->canopy_spans[lDepth] );
+  }
+
+  /* All done. */
+  free( lSpans );
+  return true;
+}
+
+
+/*
+ * branch; works out where a branch of a pattern starts and ends, relative to
+ *         the root of the pattern, in the orientation the tree asked for.
+ */
+
+void PatternLibrary::branch( const pattern_ref_t *pRef, uint_fast8_t pBranch,
+                             pimoroni::Point *pStart, pimoroni::Point *pEnd )
+{
+  const pattern_t *lPattern = &this->mPatterns[pRef->pattern];
+
+  *pStart = pBranch < 2 ? pimoroni::Point( 0, 0 ) : lPattern->ends[(pBranch-2)/2];
+  *pEnd = lPattern->ends[pBranch];
+
+  if ( pRef->mirror )
+  {
+    pStart->x = -pStart->x;
+    pEnd->x = -pEnd->x;
+  }
+}
+
+
+/*
+ * canopy; returns the merged leaf spans at a given depth of a pattern, which
+ *         are relative to its root and unmirrored, along with how many there
+ *         are and how many pixels the leaves would have been as discs.
+ */
+
+const canopy_span_t *PatternLibrary::canopy( const pattern_ref_t *pRef, uint_fast8_t pDepth,
+                                             uint_fast16_t *pCount, uint32_t *pDiscPixels )
+{
+  const pattern_t *lPattern = &this->mPatterns[pRef->pattern];
+
+  *pCount = lPattern->canopy_spans[pDepth];
+  *pDiscPixels = lPattern->canopy_discs[pDepth];
+  return lPattern->canopy[pDepth];
+}
+
+/* End of file pattern.cpp */
@@ -0,0 +1,75 @@
+/*
+ * pattern.hpp - part of Arborescence
+ *
+ * This header declares the PatternLibrary class; a shared set of pre-grown
+ * subtrees which trees can borrow their outer branches from, rather than
+ * every tree growing (and storing) its own.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define PATTERN_COUNT       16
+#define PATTERN_ROOT_LEVEL  2       /* Patterns grow from the ends of this level. */
+#define PATTERN_DEPTH       3
+#define PATTERN_BRANCHES    ( ( 2 << PATTERN_DEPTH ) - 2 )
+#define PATTERN_NONE        0xFF
+
+
+/* Structures. */
+
+typedef struct
+{
+  int16_t               x, y;
+  int16_t               length;
+} canopy_span_t;
+
+typedef struct
+{
+  uint8_t               pattern;
+  uint8_t               mirror;
+  uint8_t               depth;
+} pattern_ref_t;
+
+typedef struct
+{
+  pimoroni::Point       ends[PATTERN_BRANCHES];
+  canopy_span_t        *canopy[PATTERN_DEPTH];
+  uint16_t              canopy_spans[PATTERN_DEPTH];
+  uint32_t              canopy_discs[PATTERN_DEPTH];
+} pattern_t;
+
+
+/* Class declaration. */
+
+class PatternLibrary
+{
+private:
+  pattern_t                             mPatterns[PATTERN_COUNT];
+  bool                                  mReady;
+
+  bool            generate( pattern_t *, uint32_t );
+
+public:
+                  PatternLibrary( uint32_t );
+                 ~PatternLibrary( void );
+
+  bool            ready( void );
+  void            branch( const pattern_ref_t *, uint_fast8_t,
+                          pimoroni::Point *, pimoroni::Point * );
+  const canopy_span_t *canopy( const pattern_ref_t *, uint_fast8_t,
+                               uint_fast16_t *, uint32_t * );
+
+  static uint_fast8_t first_branch( uint_fast8_t );
+};
+
+/* End of file pattern.hpp */
@@ -0,0 +1,289 @@
+/*
+ * profile.cpp - part of Arborescence
+ *
+ * Implements the Profiler class. On the device, SysTick interrupts the core
+ * that started the profiler PROFILE_HZ times a second; the handler digs the
+ * interrupted PC and LR out of the exception frame and drops them into a
+ * ring. The main loop drains a sample or two each frame over the UART, so the
+ * cost is spread out; if it can't keep up, samples are dropped and counted.
+ *
+ * Writing to the UART blocks, and SysTick keeps sampling while it does, so
+ * whatever time goes on the output shows up in the profile as time spent in
+ * the UART driver. The rate is kept low enough for that to be a few percent,
+ * rather than most of the frame; a longer run makes up for the fewer samples.
+ *
+ * On a host build, SIGPROF stands in for SysTick, and the PC comes out of the
+ * signal context instead.
+ *
+ * The output is plain text, one line per sample:
+ *
+ *   @prof start <hz> <address of profile_anchor>
+ *   @prof <pc> <lr>
+ *   @prof dropped <count>
+ *   @prof stop
+ *
+ * The anchor lets pv_profile.py cope with code that isn't loaded at the
+ * address it was linked at.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <atomic>
+#include <inttypes.h>
+#include <stdio.h>
+#if !PICO_ON_DEVICE
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#endif
+
+#include "arborescence.hpp"
+#include "profile.hpp"
+
+
+/* Module variables. */
+
+static Profiler *m_profiler = nullptr;
+
+
+/* Functions. */
+
+
+/*
+ * profile_anchor; does nothing, but its address is reported at the start of
+ *                 each run so that samples can be matched up to the ELF.
+ */
+
+extern "C" void profile_anchor( void )
+{
+}
+
+
+#if PICO_ON_DEVICE
+
+/*
+ * profile_sample; called from the SysTick handler with the exception frame
+ *                 of whatever was interrupted; r0-r3, r12, lr, pc, xpsr.
+ */
+
+extern "C" void profile_sample( const uint32_t *pFrame )
+{
+  if ( m_profiler != nullptr )
+  {
+    m_profiler->record( pFrame[6], pFrame[5] );
+  }
+}
+
+
+/*
+ * isr_systick; replaces the SDK's default handler. All it does is work out
+ *              which stack the exception frame was pushed onto, and hand
+ *              that to profile_sample.
+ */
+
+extern "C" void __attribute__(( naked )) isr_systick( void )
+{
+  __asm volatile(
+    "movs r0, #4          \n"
+    "mov  r1, lr          \n"
+    "tst  r0, r1          \n"
+    "beq  1f              \n"
+    "mrs  r0, psp         \n"
+    "b    2f              \n"
+    "1:                   \n"
+    "mrs  r0, msp         \n"
+    "2:                   \n"
+    "ldr  r1, =profile_sample \n"
+    "bx   r1              \n"
+  );
+}
+
+#else
+
+/*
+ * profile_signal; the host stand-in for the SysTick handler, pulling the PC
+ *                 (and LR, where there is one) out of the signal context.
+ */
+
+static void profile_signal( int pSignal, siginfo_t *pInfo, void *pContext )
+{
+  const ucontext_t *lContext = (const ucontext_t *)pContext;
+  uintptr_t         lPC = 0, lLR = 0;
+
+  /* Only ever SIGPROF, and there's nothing we want from the info. */
+  (void)pSignal;
+  (void)pInfo;
+
+#if defined( __x86_64__ )
+  lPC = lContext->uc_mcontext.gregs[REG_RIP];
+#elif defined( __aarch64__ )
+  lPC = lContext->uc_mcontext.pc;
+  lLR = lContext->uc_mcontext.regs[30];
+#endif
+
+  if ( m_profiler != nullptr )
+  {
+    m_profiler->record( lPC, lLR );
+  }
+}
+
+#endif
+
+
+/*
+ * constructor; just sets up an empty ring; nothing is sampled until started.
+ */
+
+Profiler::Profiler( void )
+{
+  this->mHead = this->mTail = 0;
+  this->mDropped = 0;
+  this->mRunning = false;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * start; starts sampling whatever core (or process) we're called from.
+ */
+
+void Profiler::start( void )
+{
+  if ( this->mRunning )
+  {
+    return;
+  }
+
+  /* Start afresh, and let the tool know where things are. */
+  this->mHead = this->mTail = 0;
+  this->mDropped = 0;
+  m_profiler = this;
+  this->mRunning = true;
+  printf( "@prof start %d %" PRIxPTR "\n", PROFILE_HZ, (uintptr_t)&profile_anchor );
+
+#if PICO_ON_DEVICE
+  /* SysTick counts down at the system clock, interrupting when it wraps. */
+  systick_hw->csr = 0;
+  systick_hw->rvr = ( clock_get_hz( clk_sys ) / PROFILE_HZ ) - 1;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x7;
+#else
+  struct sigaction lAction = {};
+  struct itimerval lTimer = {};
+
+  lAction.sa_sigaction = profile_signal;
+  lAction.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset( &lAction.sa_mask );
+  sigaction( SIGPROF, &lAction, nullptr );
+
+  lTimer.it_interval.tv_usec = 1000000 / PROFILE_HZ;
+  lTimer.it_value = lTimer.it_interval;
+  setitimer( ITIMER_PROF, &lTimer, nullptr );
+#endif
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * stop; stops sampling, and writes out everything that's left in the ring.
+ */
+
+void Profiler::stop( void )
+{
+  if ( !this->mRunning )
+  {
+    return;
+  }
+
+#if PICO_ON_DEVICE
+  systick_hw->csr = 0;
+#else
+  struct itimerval lTimer = {};
+  setitimer( ITIMER_PROF, &lTimer, nullptr );
+#endif
+  this->mRunning = false;
+
+  this->drain( PROFILE_RING_SIZE );
+  printf( "@prof stop\n" );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * running; reports whether we're currently sampling.
+ */
+
+bool Profiler::running( void )
+{
+  return this->mRunning;
+}
+
+
+/*
+ * record; adds a sample to the ring; called from the interrupt (or signal)
+ *         handler, so it must never block. A full ring drops the sample.
+ */
+
+void Profiler::record( uintptr_t pPC, uintptr_t pLR )
+{
+  uint32_t lHead = this->mHead.load( std::memory_order_relaxed );
+
+  if ( lHead - this->mTail.load( std::memory_order_acquire ) >= PROFILE_RING_SIZE )
+  {
+    this->mDropped.fetch_add( 1, std::memory_order_relaxed );
+    return;
+  }
+
+  this->mRing[lHead & ( PROFILE_RING_SIZE - 1 )].pc = pPC;
+  this->mRing[lHead & ( PROFILE_RING_SIZE - 1 )].lr = pLR;
+  this->mHead.store( lHead + 1, std::memory_order_release );
+}
+
+
+/*
+ * drain; writes out up to the given number of samples from the ring, along
+ *        with a count of any that have been dropped.
+ */
+
+void Profiler::drain( uint_fast16_t pMax )
+{
+  uint32_t lTail = this->mTail.load( std::memory_order_relaxed );
+  uint32_t lDropped;
+
+  while( ( pMax-- > 0 ) && ( lTail != this->mHead.load( std::memory_order_acquire ) ) )
+  {
+    printf( "@prof %" PRIxPTR " %" PRIxPTR "\n",
+            this->mRing[lTail & ( PROFILE_RING_SIZE - 1 )].pc,
+            this->mRing[lTail & ( PROFILE_RING_SIZE - 1 )].lr );
+    this->mTail.store( ++lTail, std::memory_order_release );
+  }
+
+  lDropped = this->mDropped.exchange( 0, std::memory_order_relaxed );
+  if ( lDropped > 0 )
+  {
+    printf( "@prof dropped %" PRIu32 "\n", lDropped );
+  }
+
+  /* All done. */
+  return;
+}
+
+/* End of file profile.cpp */
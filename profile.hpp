@@ -0,0 +1,58 @@
+/*
+ * profile.hpp - part of Arborescence
+ *
+ * This header declares the Profiler class; a statistical sampling profiler,
+ * which periodically notes where the CPU was and streams the samples out over
+ * the UART, for pv_profile.py to make sense of.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define PROFILE_TRIGGER     'p'
+#define PROFILE_HZ          25      /* At ~24 bytes a line, 5% of a 115200 baud UART... */
+#define PROFILE_RING_SIZE   512     /* Must be a power of two. */
+#define PROFILE_DRAIN_MAX   2       /* ...and no frame waits on more than a couple of lines. */
+
+
+/* Structures. */
+
+typedef struct
+{
+  uintptr_t       pc;
+  uintptr_t       lr;
+} profile_sample_t;
+
+
+/* Class declaration. */
+
+class Profiler
+{
+private:
+  profile_sample_t                      mRing[PROFILE_RING_SIZE];
+  std::atomic<uint32_t>                 mHead, mTail;
+  std::atomic<uint32_t>                 mDropped;
+  bool                                  mRunning;
+
+public:
+                  Profiler( void );
+
+  void            start( void );
+  void            stop( void );
+  bool            running( void );
+  void            record( uintptr_t, uintptr_t );
+  void            drain( uint_fast16_t );
+};
+
+/* End of file profile.hpp */
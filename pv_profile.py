@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Tool for making sense of the samples streamed out by the sampling profiler
+# (send a 'p' over the UART to start and stop it). The samples are matched up
+# against the ELF, and turned into a flat profile and a simple call graph.
+#
+# Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+# This file is distributed under the MIT License; see LICENSE for details.
+
+import sys
+import subprocess
+import argparse
+from collections import Counter
+
+
+def read_samples(filename):
+  """Pulls the profile lines out of a UART log, ignoring everything else"""
+
+  # Keep track of the anchor address, and how many samples went missing
+  anchor = None
+  samples = []
+  dropped = 0
+
+  with open(filename, 'r', errors='replace') as log:
+    for line in log:
+      fields = line.split()
+      if len(fields) < 2 or fields[0] != '@prof':
+        continue
+
+      # The start line tells us where the anchor function was loaded
+      if fields[1] == 'start' and len(fields) >= 4:
+        anchor = int(fields[3], 16)
+      elif fields[1] == 'dropped':
+        dropped += int(fields[2])
+      elif fields[1] != 'stop' and len(fields) >= 3:
+        samples.append((int(fields[1], 16), int(fields[2], 16)))
+
+  return anchor, samples, dropped
+
+
+def symbol_address(elf, symbol, prefix):
+  """Finds where the given symbol was linked, using nm"""
+
+  output = subprocess.run([f'{prefix}nm', elf], capture_output=True, text=True, check=True).stdout
+  for line in output.splitlines():
+    fields = line.split()
+    if len(fields) == 3 and fields[2] == symbol:
+      return int(fields[0], 16)
+  return None
+
+
+def symbolise(elf, addresses, prefix):
+  """Maps each address to a function name, using addr2line in one batch"""
+
+  # addr2line gives us two lines (function, then file:line) per address
+  addresses = sorted(addresses)
+  stdin = ''.join(f'{address:x}\n' for address in addresses)
+  output = subprocess.run([f'{prefix}addr2line', '-f', '-C', '-e', elf],
+                          input=stdin, capture_output=True, text=True, check=True).stdout
+  lines = output.splitlines()
+  return {address: lines[index*2] for index, address in enumerate(addresses)}
+
+
+def main() -> int:
+  """Symbolise a profile log and print the flat profile and call graph"""
+
+  # Make sense of the command line.
+  parser = argparse.ArgumentParser()
+  parser.add_argument("elf", help="The ELF file the samples were taken from")
+  parser.add_argument("log", help="The UART log containing the samples")
+  parser.add_argument("-p", "--prefix", default="arm-none-eabi-",
+                      help="Toolchain prefix for nm and addr2line (use '' for a host build)")
+  parser.add_argument("-n", "--top", type=int, default=25,
+                      help="How many entries to show in each table")
+  args = parser.parse_args()
+
+  # Load up the samples
+  anchor, samples, dropped = read_samples(args.log)
+  if not samples:
+    print(f'No samples found in {args.log}')
+    return 1
+
+  # Work out how far the code moved from where it was linked (if at all)
+  linked = symbol_address(args.elf, 'profile_anchor', args.prefix)
+  slide = anchor - linked if anchor is not None and linked is not None else 0
+
+  # Thumb addresses have the low bit set; return addresses point past the call
+  pcs = [(pc - slide) & ~1 for pc, lr in samples]
+  lrs = [((lr - slide) & ~1) - 2 if lr else 0 for pc, lr in samples]
+  names = symbolise(args.elf, set(pcs) | set(lr for lr in lrs if lr), args.prefix)
+  names[0] = '??'
+
+  # The flat profile is simply where the PC was
+  total = len(samples)
+  flat = Counter(names[pc] for pc in pcs)
+  print(f'{total} samples, {dropped} dropped\n')
+  print('  samples      %  function')
+  for function, count in flat.most_common(args.top):
+    print(f'{count:9d} {count*100/total:6.2f}  {function}')
+
+  # And the call graph pairs each function with whoever (probably) called it;
+  # there's no LR to go on for x86 host builds
+  graph = Counter((names[lr], names[pc]) for pc, lr in zip(pcs, lrs) if lr and names[lr] != names[pc])
+  print('\n  samples      %  caller -> function')
+  for (caller, function), count in graph.most_common(args.top):
+    print(f'{count:9d} {count*100/total:6.2f}  {caller} -> {function}')
+
+  # All done
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
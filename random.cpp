@@ -0,0 +1,65 @@
+/*
+ * random.cpp - part of Arborescence
+ *
+ * Provides repeatable pseudo-random numbers; anything generated from a seed
+ * (chunks of the world, and the trees in them) must come out the same every
+ * time, which the hardware random number generator can't promise.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdint.h>
+
+
+/* Local header files. */
+
+#include "arborescence.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * random_hash; mixes a seed and an index into a new, well scattered, seed. This
+ *              is how we derive the seed of a chunk from the world seed, for
+ *              example.
+ */
+
+uint32_t random_hash( uint32_t pSeed, uint32_t pIndex )
+{
+  uint32_t lHash = pSeed ^ ( pIndex * 0x9E3779B9 );
+
+  /* A standard integer finaliser, to spread the bits around. */
+  lHash ^= lHash >> 16;
+  lHash *= 0x85EBCA6B;
+  lHash ^= lHash >> 13;
+  lHash *= 0xC2B2AE35;
+  lHash ^= lHash >> 16;
+
+  /* Zero is the one seed the generator can't use. */
+  return lHash ? lHash : 1;
+}
+
+
+/*
+ * random_next; steps a generator state along (xorshift32), and returns the
+ *              new value.
+ */
+
+uint32_t random_next( uint32_t *pState )
+{
+  uint32_t lValue = *pState;
+
+  lValue ^= lValue << 13;
+  lValue ^= lValue >> 17;
+  lValue ^= lValue << 5;
+
+  /* Save the state, and return it. */
+  *pState = lValue;
+  return lValue;
+}
+
+/* End of file random.cpp */
@@ -0,0 +1,159 @@
+/*
+ * recorder.cpp - part of Arborescence
+ *
+ * Implements the FlightRecorder class. Every frame, the main loop hands over
+ * what it took and why; that goes into a ring, overwriting the oldest. When a
+ * frame runs past RECORDER_SLOW_US, we keep recording for RECORDER_AFTER more
+ * frames, then freeze the ring and send it out a line per frame. A line is
+ * around 70 bytes, or 6ms of the UART at 115200 baud; that's well inside a
+ * frame, and it's sent after the frame has been timed, but it does still eat
+ * into the time the next one has. Nothing is recorded while that's going on,
+ * and the ring starts again empty afterwards.
+ *
+ * The output is plain text:
+ *
+ *   @rec slow <frame> <frame_us>
+ *   @rec <frame> <frame_us> <render_us> <update_us> <raster_us> <level>
+ *        <reasons> <commands> <pixels> <primitives> <trees> <dying>
+ *        <youngest> <oldest>
+ *   @rec end
+ *
+ * with one (unwrapped) line per frame, oldest first; reasons are the REDRAW_
+ * flags from world.hpp, in hex.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "recorder.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; starts with an empty ring.
+ */
+
+FlightRecorder::FlightRecorder( void )
+{
+  this->mNext = this->mCount = 0;
+  this->mAfter = 0;
+  this->mTriggered = this->mDumping = false;
+  this->mDumped = 0;
+  this->mSlowFrame = 0;
+  this->mCommands = this->mPixels = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * record; adds a frame to the ring. The command and pixel counts arrive as
+ *         running totals, which we turn into this frame's share; they may
+ *         have been reset since last time, in which case it's all this frame's.
+ */
+
+void FlightRecorder::record( flight_frame_t *pFrame )
+{
+  uint32_t lCommands = pFrame->commands, lPixels = pFrame->pixels;
+
+  pFrame->commands = lCommands >= this->mCommands ? lCommands - this->mCommands : lCommands;
+  pFrame->pixels = lPixels >= this->mPixels ? lPixels - this->mPixels : lPixels;
+  this->mCommands = lCommands;
+  this->mPixels = lPixels;
+
+  /* The ring is frozen while it's being sent. */
+  if ( this->mDumping )
+  {
+    return;
+  }
+
+  this->mFrames[this->mNext] = *pFrame;
+  this->mNext = ( this->mNext + 1 ) % RECORDER_FRAMES;
+  if ( this->mCount < RECORDER_FRAMES )
+  {
+    this->mCount++;
+  }
+
+  /* A slow frame starts the count down to freezing; later ones just ride along. */
+  if ( ( !this->mTriggered ) && ( pFrame->frame_us > RECORDER_SLOW_US ) )
+  {
+    this->mTriggered = true;
+    this->mAfter = RECORDER_AFTER;
+    this->mSlowFrame = pFrame->frame;
+  }
+  else if ( ( this->mTriggered ) && ( --this->mAfter == 0 ) )
+  {
+    this->mTriggered = false;
+    this->mDumping = true;
+    this->mDumped = 0;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * dumping; returns true while a frozen ring is waiting to be sent.
+ */
+
+bool FlightRecorder::dumping( void )
+{
+  return this->mDumping;
+}
+
+
+/*
+ * drain; sends up to the given number of lines from a frozen ring; the header
+ *        first, then the frames, and the trailer last.
+ */
+
+void FlightRecorder::drain( uint_fast8_t pMax )
+{
+  const flight_frame_t *lFrame;
+
+  for ( ; ( pMax > 0 ) && ( this->mDumping ); pMax--, this->mDumped++ )
+  {
+    if ( this->mDumped == 0 )
+    {
+      lFrame = &this->mFrames[( this->mNext + RECORDER_FRAMES - RECORDER_AFTER - 1 ) % RECORDER_FRAMES];
+      printf( "@rec slow %" PRIu32 " %" PRIu32 "\n", this->mSlowFrame, lFrame->frame_us );
+    }
+    else if ( this->mDumped <= this->mCount )
+    {
+      /* The oldest frame is the one the next would have overwritten. */
+      lFrame = &this->mFrames[( this->mNext + RECORDER_FRAMES - this->mCount + this->mDumped - 1 ) % RECORDER_FRAMES];
+      printf( "@rec %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %d %04x %" PRIu32 " %" PRIu32
+              " %d %d %d %d %d\n",
+              lFrame->frame, lFrame->frame_us, lFrame->render_us, lFrame->update_us, lFrame->raster_us,
+              lFrame->level, lFrame->reasons, lFrame->commands, lFrame->pixels, lFrame->primitives,
+              lFrame->trees, lFrame->dying, lFrame->youngest, lFrame->oldest );
+    }
+    else
+    {
+      /* Once it's all gone, start afresh. */
+      printf( "@rec end\n" );
+      this->mDumping = false;
+      this->mNext = this->mCount = 0;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+/* End of file recorder.cpp */
@@ -0,0 +1,68 @@
+/*
+ * recorder.hpp - part of Arborescence
+ *
+ * This header declares the FlightRecorder class; it keeps the last few frames
+ * of detail in a ring, and when one of them runs slow, freezes the frames
+ * around it and streams them out over the UART.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "governor.hpp"
+
+
+/* Constants. */
+
+#define RECORDER_FRAMES     64      /* How much history is held. */
+#define RECORDER_AFTER      8       /* And how many frames after the slow one. */
+#define RECORDER_SLOW_US    ( GOVERNOR_BUDGET_US * 3 / 2 )  /* Well past a missed vsync. */
+#define RECORDER_DRAIN_MAX  1       /* Lines sent per frame, while dumping. */
+
+
+/* Structures. */
+
+typedef struct
+{
+  uint32_t        frame;
+  uint32_t        frame_us;       /* Start of the frame, to the drawing catching up. */
+  uint32_t        render_us;      /* Time core 0 spent queueing up the drawing. */
+  uint32_t        update_us;      /* And updating the world. */
+  uint32_t        raster_us;      /* Time core 1 spent drawing the last complete frame. */
+  uint32_t        commands;       /* Queued this frame; filled in as a running total. */
+  uint32_t        pixels;         /* Canopy pixels drawn this frame; likewise. */
+  uint16_t        reasons;        /* The REDRAW_ flags, from the World. */
+  uint16_t        primitives;     /* In the spatial index. */
+  uint8_t         level;          /* The governor's clock level. */
+  uint8_t         trees, dying;
+  uint8_t         youngest, oldest;
+} flight_frame_t;
+
+
+/* Class declaration. */
+
+class FlightRecorder
+{
+private:
+  flight_frame_t                        mFrames[RECORDER_FRAMES];
+  uint_fast8_t                          mNext, mCount;
+  uint_fast8_t                          mAfter;
+  bool                                  mTriggered, mDumping;
+  uint_fast8_t                          mDumped;
+  uint32_t                              mSlowFrame;
+  uint32_t                              mCommands, mPixels;
+
+public:
+                  FlightRecorder( void );
+
+  void            record( flight_frame_t * );
+  bool            dumping( void );
+  void            drain( uint_fast8_t );
+};
+
+/* End of file recorder.hpp */
@@ -0,0 +1,650 @@
+/*
+ * renderqueue.cpp - part of Arborescence
+ *
+ * Implements the RenderQueue class. The world doesn't draw anything itself;
+ * it emits small drawing commands into a lock-free ring (a RenderRing), and
+ * core 1 does nothing but pull them back out and rasterise them into the
+ * frame. This leaves core 0 free to get on with the next frame's simulation.
+ *
+ * Everything that touches the display goes through the queue once the
+ * consumer has been started, so that the two cores never fight over it.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "drivers/dv_display/dv_display.hpp"
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+#include "renderqueue.hpp"
+#include "stepper.hpp"
+
+
+/* Module variables. */
+
+static RenderQueue *m_consumer_queue = nullptr;
+
+
+/* Functions. */
+
+
+/*
+ * constructor; saves the display and graphics objects, which will only be
+ *              used by the consumer once it's running.
+ */
+
+RenderQueue::RenderQueue( pimoroni::DVDisplay *pDisplay, pimoroni::PicoGraphics_PenDV_RGB555 *pGraphics )
+{
+  /* Save the references we're given. */
+  this->mDisplay = pDisplay;
+  this->mGraphics = pGraphics;
+
+  /* No frame has been drawn yet, so no time has been spent drawing it. */
+  this->mFrameStarted = time_us_32();
+  this->mFrameIdle = 0;
+  this->mRasterTime = 0;
+
+  /* Curves are stepped in software until core 1 has checked its interpolators. */
+  this->mInterp = false;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * consumer_entry; the entry point for the consumer core. Curves are drawn
+ *                 with core 1's interpolators, so they're checked against the
+ *                 software here, before anything is drawn; the answer goes
+ *                 back to core 0 over the FIFO. Then it just runs the
+ *                 consumer loop on the queue it was started for.
+ */
+
+void RenderQueue::consumer_entry( void )
+{
+  bool lInterp = RASTER_INTERP && Stepper::self_check( STEPPER_CHECK_SEED, STEPPER_CHECK_CURVES );
+
+  m_consumer_queue->mInterp = lInterp;
+  multicore_fifo_push_blocking( lInterp ? 1 : 0 );
+
+  m_consumer_queue->run();
+}
+
+
+/*
+ * start; launches the consumer on core 1, and waits to hear whether it can
+ *        use its interpolators. Nothing else should touch the display
+ *        directly after this.
+ */
+
+void RenderQueue::start( void )
+{
+  m_consumer_queue = this;
+
+  multicore_launch_core1( RenderQueue::consumer_entry );
+  if ( ( multicore_fifo_pop_blocking() == 0 ) && RASTER_INTERP )
+  {
+    printf( "Render queue: interpolators failed their check, so curves are stepped in software\n" );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * run; the consumer loop, which never returns. Commands are executed in the
+ *      order they were queued, and only released once they're complete.
+ */
+
+void RenderQueue::run( void )
+{
+  const rcmd_t *lCommand;
+  uint32_t      lWaitStarted;
+
+  while( true )
+  {
+    /* If there's nothing to do, wait for the producer; that's not drawing time. */
+    lCommand = this->mRing.peek();
+    if ( lCommand == nullptr )
+    {
+      lWaitStarted = time_us_32();
+      lCommand = this->mRing.wait();
+      this->mFrameIdle += time_us_32() - lWaitStarted;
+    }
+
+    /* Execute the command, and then release the slot. */
+    this->execute( lCommand );
+    this->mRing.release();
+  }
+}
+
+
+/*
+ * execute; performs a single command, on the consumer side.
+ */
+
+void RenderQueue::execute( const rcmd_t *pCommand )
+{
+  switch( pCommand->type )
+  {
+    case RCMD_PEN:
+      this->mGraphics->set_pen( pCommand->pen );
+      break;
+    case RCMD_DEPTH:
+      this->mGraphics->set_depth( pCommand->arg );
+      break;
+    case RCMD_CLIP:
+      this->mGraphics->set_clip( pimoroni::Rect( pCommand->x1, pCommand->y1, pCommand->x2, pCommand->y2 ) );
+      break;
+    case RCMD_UNCLIP:
+      this->mGraphics->remove_clip();
+      break;
+    case RCMD_PIXEL:
+      this->mGraphics->pixel( pimoroni::Point( pCommand->x1, pCommand->y1 ) );
+      break;
+    case RCMD_SPAN:
+      this->mGraphics->pixel_span( pimoroni::Point( pCommand->x1, pCommand->y1 ), pCommand->x2 );
+      break;
+    case RCMD_LINE:
+      this->mGraphics->line(
+        pimoroni::Point( pCommand->x1, pCommand->y1 ), pimoroni::Point( pCommand->x2, pCommand->y2 )
+      );
+      break;
+    case RCMD_THICK_LINE:
+      this->mGraphics->thick_line(
+        pimoroni::Point( pCommand->x1, pCommand->y1 ), pimoroni::Point( pCommand->x2, pCommand->y2 ),
+        pCommand->arg
+      );
+      break;
+    case RCMD_CURVE:
+      this->raster_curve( pCommand );
+      break;
+    case RCMD_DISC:
+      this->mGraphics->circle( pimoroni::Point( pCommand->x1, pCommand->y1 ), pCommand->x2 );
+      break;
+    case RCMD_RECT:
+      this->mGraphics->rectangle( pimoroni::Rect( pCommand->x1, pCommand->y1, pCommand->x2, pCommand->y2 ) );
+      break;
+    case RCMD_TEXT:
+      this->mGraphics->text(
+        (const char *)pCommand->data, pimoroni::Point( pCommand->x1, pCommand->y1 ), pCommand->x2
+      );
+      break;
+    case RCMD_SPRITE:
+      this->mDisplay->set_sprite(
+        pCommand->pen, pCommand->x2, pimoroni::Point( pCommand->x1, pCommand->y1 ),
+        (pimoroni::DVDisplay::SpriteBlendMode)pCommand->arg
+      );
+      break;
+    case RCMD_CLEAR_SPRITE:
+      this->mDisplay->clear_sprite( pCommand->pen );
+      break;
+    case RCMD_DEFINE_SPRITE:
+      this->mDisplay->define_sprite( pCommand->pen, pCommand->x1, pCommand->y1, (uint16_t *)pCommand->data );
+      break;
+    case RCMD_SCROLL:
+      this->mDisplay->setup_scroll_group(
+        pimoroni::Point( pCommand->x1, pCommand->y1 ), pCommand->pen, pCommand->x2, 0, 0, 0
+      );
+      break;
+    case RCMD_PSRAM_WRITE:
+      this->mDisplay->raw_write_async(
+        (uint16_t)pCommand->x1 | ( (uint32_t)(uint16_t)pCommand->y1 << 16 ),
+        (uint32_t *)pCommand->data, (uint16_t)pCommand->x2 | ( (uint32_t)(uint16_t)pCommand->y2 << 16 )
+      );
+      this->mDisplay->raw_wait_for_finish_blocking();
+      break;
+    case RCMD_PSRAM_READ:
+      this->mDisplay->raw_read_async(
+        (uint16_t)pCommand->x1 | ( (uint32_t)(uint16_t)pCommand->y1 << 16 ),
+        (uint32_t *)pCommand->data, (uint16_t)pCommand->x2 | ( (uint32_t)(uint16_t)pCommand->y2 << 16 )
+      );
+      this->mDisplay->raw_wait_for_finish_blocking();
+      break;
+    case RCMD_FLIP:
+      /* Note how long was spent actually drawing; waiting for the flip doesn't count. */
+      this->mRasterTime = time_us_32() - this->mFrameStarted - this->mFrameIdle;
+
+      /* Flip, and wait for it to complete so we don't draw on the visible bank. */
+      this->mDisplay->flip();
+
+      /* The next frame starts now. */
+      this->mFrameStarted = time_us_32();
+      this->mFrameIdle = 0;
+      break;
+  }
+}
+
+
+/*
+ * raster_curve; draws a quadratic Bezier curve by forward differencing. We
+ *               take a power of two steps, enough that no step moves more
+ *               than a pixel, so the whole thing is done in fixed point with
+ *               just adds and shifts; nothing is divided per point. Each
+ *               axis has its own Stepper, which may be an interpolator.
+ *
+ *               Thin curves are gathered into runs along each row, and drawn
+ *               as spans. Thick ones draw a span across the curve on each new
+ *               row when it's steep, or a bar down it on each new column when
+ *               it's shallow; moving along a row or column just adds an edge.
+ *               The two don't quite meet where the curve turns from one to the
+ *               other, so a square is dropped there, and at the start.
+ */
+
+void RenderQueue::raster_curve( const rcmd_t *pCommand )
+{
+  Stepper lStepX, lStepY;
+  int32_t lAX, lAY, lDX, lDY, lRound;
+  int32_t lLength, lLegX, lLegY, lPixelX, lPixelY, lLastX, lLastY, lRunLeft, lRunRight;
+  int32_t lThickness = pCommand->arg, lHalf = pCommand->arg / 2;
+  uint_fast8_t lShift = 1;
+  bool         lSteep, lWasSteep;
+
+  /* Enough steps that each moves at most a pixel; the steepest leg sets that. */
+  lLegX = abs( pCommand->x3 - pCommand->x1 );
+  lLegY = abs( pCommand->y3 - pCommand->y1 );
+  lLength = lLegX > lLegY ? lLegX : lLegY;
+  lLegX = abs( pCommand->x2 - pCommand->x3 );
+  lLegY = abs( pCommand->y2 - pCommand->y3 );
+  lLength = lLegX > lLength ? lLegX : lLength;
+  lLength = lLegY > lLength ? lLegY : lLength;
+  while( ( ( 1 << lShift ) < lLength * 2 ) && ( lShift < CURVE_SHIFT_MAX ) )
+  {
+    lShift++;
+  }
+
+  /*
+   * With N steps, the point at step i (scaled up by N squared) is
+   * P0.N^2 + B.i.N + A.i^2, where A = P0 - 2C + P2 and B = 2(C - P0).
+   */
+  lAX = pCommand->x1 - 2 * pCommand->x3 + pCommand->x2;
+  lAY = pCommand->y1 - 2 * pCommand->y3 + pCommand->y2;
+  lDX = 2 * ( pCommand->x3 - pCommand->x1 ) * ( 1 << lShift ) + lAX;
+  lDY = 2 * ( pCommand->y3 - pCommand->y1 ) * ( 1 << lShift ) + lAY;
+  lRound = 1 << ( lShift * 2 - 1 );
+
+  /* The steppers start from the first step along, rounded to the nearest pixel. */
+  lStepX.start( pCommand->x1 * ( 1 << ( lShift * 2 ) ) + lDX + lRound, lDX + 2 * lAX, 2 * lAX,
+                lShift * 2, 0, this->mInterp );
+  lStepY.start( pCommand->y1 * ( 1 << ( lShift * 2 ) ) + lDY + lRound, lDY + 2 * lAY, 2 * lAY,
+                lShift * 2, 1, this->mInterp );
+
+  /* Start with the first pixel, on its own. */
+  lLastX = lRunLeft = lRunRight = pCommand->x1;
+  lLastY = pCommand->y1;
+  lWasSteep = abs( lDY ) >= abs( lDX );
+  if ( lThickness > 1 )
+  {
+    this->mGraphics->rectangle( pimoroni::Rect( lLastX - lHalf, lLastY - lHalf, lThickness, lThickness ) );
+  }
+
+  for ( int32_t lStep = 1 << lShift; lStep > 0; lStep-- )
+  {
+    lPixelX = lStepX.next();
+    lPixelY = lStepY.next();
+    if ( ( lPixelX == lLastX ) && ( lPixelY == lLastY ) )
+    {
+      continue;
+    }
+
+    if ( lThickness <= 1 )
+    {
+      /* Grow the run if we're still on the same row, otherwise draw it and start again. */
+      if ( lPixelY == lLastY )
+      {
+        lRunLeft = lPixelX < lRunLeft ? lPixelX : lRunLeft;
+        lRunRight = lPixelX > lRunRight ? lPixelX : lRunRight;
+      }
+      else
+      {
+        this->mGraphics->pixel_span( pimoroni::Point( lRunLeft, lLastY ), lRunRight - lRunLeft + 1 );
+        lRunLeft = lRunRight = lPixelX;
+      }
+    }
+    else if ( ( lSteep = abs( lStepY.step() ) >= abs( lStepX.step() ) ) != lWasSteep )
+    {
+      /* Turning between steep and shallow; a square covers the join. */
+      this->mGraphics->rectangle( pimoroni::Rect( lPixelX - lHalf, lPixelY - lHalf, lThickness, lThickness ) );
+      lWasSteep = lSteep;
+    }
+    else if ( lSteep )
+    {
+      /* Steep, so a span across each row; along the row only adds the leading edge. */
+      if ( lPixelY != lLastY )
+      {
+        this->mGraphics->pixel_span( pimoroni::Point( lPixelX - lHalf, lPixelY ), lThickness );
+      }
+      else
+      {
+        this->mGraphics->pixel( pimoroni::Point( lPixelX - lHalf + ( lPixelX > lLastX ? lThickness - 1 : 0 ), lPixelY ) );
+      }
+    }
+    else
+    {
+      /* Shallow, so a bar down each column; down the column only adds the leading edge. */
+      if ( lPixelX != lLastX )
+      {
+        this->mGraphics->rectangle( pimoroni::Rect( lPixelX, lPixelY - lHalf, 1, lThickness ) );
+      }
+      else
+      {
+        this->mGraphics->pixel( pimoroni::Point( lPixelX, lPixelY - lHalf + ( lPixelY > lLastY ? lThickness - 1 : 0 ) ) );
+      }
+    }
+    lLastX = lPixelX;
+    lLastY = lPixelY;
+  }
+
+  /* Thin curves will still have a run waiting to be drawn. */
+  if ( lThickness <= 1 )
+  {
+    this->mGraphics->pixel_span( pimoroni::Point( lRunLeft, lLastY ), lRunRight - lRunLeft + 1 );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * wait_for_frame; keeps the producer no more than a frame ahead of the
+ *                 consumer; it can build the next frame while the previous
+ *                 one is being rasterised, but no further.
+ */
+
+void RenderQueue::wait_for_frame( void )
+{
+  this->mRing.wait_for_frame();
+}
+
+
+/*
+ * wait_for_idle; waits until every command queued so far has been executed.
+ */
+
+void RenderQueue::wait_for_idle( void )
+{
+  this->mRing.wait_for_idle();
+}
+
+
+/*
+ * frame; returns the number of the frame currently being queued; anything
+ *        queued now has been executed once frame_done says so.
+ */
+
+uint32_t RenderQueue::frame( void )
+{
+  return this->mRing.frame();
+}
+
+
+/*
+ * frame_done; reports whether the given frame has been drawn and flipped,
+ *             along with everything queued while it was being built.
+ */
+
+bool RenderQueue::frame_done( uint32_t pFrame )
+{
+  return this->mRing.frame_done( pFrame );
+}
+
+
+/*
+ * raster_us; returns how long core 1 spent drawing the last complete frame,
+ *            not counting any time spent waiting for commands or the flip.
+ */
+
+uint32_t RenderQueue::raster_us( void )
+{
+  return this->mRasterTime;
+}
+
+
+/*
+ * interpolated; reports whether curves are being stepped by core 1's
+ *               interpolators; they aren't if RASTER_INTERP is off, or if
+ *               they failed their check when core 1 started.
+ */
+
+bool RenderQueue::interpolated( void )
+{
+  return this->mInterp;
+}
+
+
+/*
+ * ring; returns the ring itself, for anything which only needs to know how
+ *       far the queue has got through its frames.
+ */
+
+RenderRing *RenderQueue::ring( void )
+{
+  return &this->mRing;
+}
+
+
+/*
+ * stats; fills in the current queue statistics, optionally resetting the
+ *        counters (and the peak occupancy) afterwards.
+ */
+
+void RenderQueue::stats( rqstats_t *pStats, bool pReset )
+{
+  this->mRing.stats( pStats, pReset );
+}
+
+
+/*
+ * The producer side; these mirror the PicoGraphics / DVDisplay calls they
+ * replace, but just queue up a command to do the work later.
+ */
+
+void RenderQueue::set_pen( uint16_t pPen )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_PEN );
+  lCommand->pen = pPen;
+  this->mRing.publish();
+}
+
+void RenderQueue::set_pen( uint8_t pRed, uint8_t pGreen, uint8_t pBlue )
+{
+  this->set_pen( pimoroni::RGB( pRed, pGreen, pBlue ).to_rgb555() );
+}
+
+void RenderQueue::set_depth( uint8_t pDepth )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_DEPTH );
+  lCommand->arg = pDepth;
+  this->mRing.publish();
+}
+
+void RenderQueue::set_clip( const pimoroni::Rect &pRect )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_CLIP );
+  lCommand->x1 = pRect.x;
+  lCommand->y1 = pRect.y;
+  lCommand->x2 = pRect.w;
+  lCommand->y2 = pRect.h;
+  this->mRing.publish();
+}
+
+void RenderQueue::remove_clip( void )
+{
+  this->mRing.claim( RCMD_UNCLIP );
+  this->mRing.publish();
+}
+
+void RenderQueue::pixel( const pimoroni::Point &pPoint )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_PIXEL );
+  lCommand->x1 = pPoint.x;
+  lCommand->y1 = pPoint.y;
+  this->mRing.publish();
+}
+
+void RenderQueue::pixel_span( const pimoroni::Point &pPoint, int32_t pLength )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_SPAN );
+  lCommand->x1 = pPoint.x;
+  lCommand->y1 = pPoint.y;
+  lCommand->x2 = pLength;
+  this->mRing.publish();
+}
+
+void RenderQueue::line( const pimoroni::Point &pStart, const pimoroni::Point &pEnd )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_LINE );
+  lCommand->x1 = pStart.x;
+  lCommand->y1 = pStart.y;
+  lCommand->x2 = pEnd.x;
+  lCommand->y2 = pEnd.y;
+  this->mRing.publish();
+}
+
+void RenderQueue::thick_line( const pimoroni::Point &pStart, const pimoroni::Point &pEnd, uint8_t pThickness )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_THICK_LINE );
+  lCommand->x1 = pStart.x;
+  lCommand->y1 = pStart.y;
+  lCommand->x2 = pEnd.x;
+  lCommand->y2 = pEnd.y;
+  lCommand->arg = pThickness;
+  this->mRing.publish();
+}
+
+void RenderQueue::curve( const pimoroni::Point &pStart, const pimoroni::Point &pControl,
+                         const pimoroni::Point &pEnd, uint8_t pThickness )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_CURVE );
+  lCommand->x1 = pStart.x;
+  lCommand->y1 = pStart.y;
+  lCommand->x2 = pEnd.x;
+  lCommand->y2 = pEnd.y;
+  lCommand->x3 = pControl.x;
+  lCommand->y3 = pControl.y;
+  lCommand->arg = pThickness;
+  this->mRing.publish();
+}
+
+void RenderQueue::circle( const pimoroni::Point &pCentre, int32_t pRadius )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_DISC );
+  lCommand->x1 = pCentre.x;
+  lCommand->y1 = pCentre.y;
+  lCommand->x2 = pRadius;
+  this->mRing.publish();
+}
+
+void RenderQueue::rectangle( const pimoroni::Rect &pRect )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_RECT );
+  lCommand->x1 = pRect.x;
+  lCommand->y1 = pRect.y;
+  lCommand->x2 = pRect.w;
+  lCommand->y2 = pRect.h;
+  this->mRing.publish();
+}
+
+/* The text isn't copied, so it must outlive the command! */
+void RenderQueue::text( const char *pText, const pimoroni::Point &pPoint, int32_t pWrap )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_TEXT );
+  lCommand->x1 = pPoint.x;
+  lCommand->y1 = pPoint.y;
+  lCommand->x2 = pWrap;
+  lCommand->data = pText;
+  this->mRing.publish();
+}
+
+void RenderQueue::set_sprite( uint8_t pSprite, uint16_t pData, const pimoroni::Point &pPoint,
+                              pimoroni::DVDisplay::SpriteBlendMode pBlend )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_SPRITE );
+  lCommand->pen = pSprite;
+  lCommand->x1 = pPoint.x;
+  lCommand->y1 = pPoint.y;
+  lCommand->x2 = pData;
+  lCommand->arg = pBlend;
+  this->mRing.publish();
+}
+
+void RenderQueue::clear_sprite( uint8_t pSprite )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_CLEAR_SPRITE );
+  lCommand->pen = pSprite;
+  this->mRing.publish();
+}
+
+/* Nor are the sprite pixels; the display driver takes its own copy when it runs. */
+void RenderQueue::define_sprite( uint16_t pData, uint16_t pWidth, uint16_t pHeight, const uint16_t *pPixels )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_DEFINE_SPRITE );
+  lCommand->pen = pData;
+  lCommand->x1 = pWidth;
+  lCommand->y1 = pHeight;
+  lCommand->data = pPixels;
+  this->mRing.publish();
+}
+
+void RenderQueue::setup_scroll_group( const pimoroni::Point &pOffset, uint8_t pGroup, int16_t pWrapX )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_SCROLL );
+  lCommand->pen = pGroup;
+  lCommand->x1 = pOffset.x;
+  lCommand->y1 = pOffset.y;
+  lCommand->x2 = pWrapX;
+  this->mRing.publish();
+}
+
+void RenderQueue::flip( void )
+{
+  this->mRing.claim( RCMD_FLIP );
+  this->mRing.publish();
+}
+
+
+/*
+ * psram_write / psram_read; move words between memory and the PSRAM, outside
+ *                           the frame. Addresses and lengths don't fit in the
+ *                           usual fields, so each is split across two. The
+ *                           data isn't copied, so must stay put until drawn.
+ */
+
+void RenderQueue::psram_write( uint32_t pAddress, const uint32_t *pData, uint32_t pWords )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_PSRAM_WRITE );
+  lCommand->x1 = pAddress & 0xFFFF;
+  lCommand->y1 = pAddress >> 16;
+  lCommand->x2 = pWords & 0xFFFF;
+  lCommand->y2 = pWords >> 16;
+  lCommand->data = pData;
+  this->mRing.publish();
+}
+
+void RenderQueue::psram_read( uint32_t pAddress, uint32_t *pData, uint32_t pWords )
+{
+  rcmd_t *lCommand = this->mRing.claim( RCMD_PSRAM_READ );
+  lCommand->x1 = pAddress & 0xFFFF;
+  lCommand->y1 = pAddress >> 16;
+  lCommand->x2 = pWords & 0xFFFF;
+  lCommand->y2 = pWords >> 16;
+  lCommand->data = pData;
+  this->mRing.publish();
+}
+
+/* End of file renderqueue.cpp */
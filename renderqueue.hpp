@@ -0,0 +1,78 @@
+/*
+ * renderqueue.hpp - part of Arborescence
+ *
+ * This header declares the RenderQueue class; a ring of compact drawing
+ * commands, filled by the world on core 0 and rasterised into the frame on
+ * core 1. The ring itself is a RenderRing; this is the drawing around it.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "drivers/dv_display/dv_display.hpp"
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+
+
+/* Class declaration. */
+
+class RenderQueue
+{
+private:
+  pimoroni::DVDisplay                  *mDisplay;
+  pimoroni::PicoGraphics_PenDV_RGB555  *mGraphics;
+
+  RenderRing                            mRing;
+
+  uint32_t                              mFrameStarted, mFrameIdle;
+  std::atomic<uint32_t>                 mRasterTime;
+  bool                                  mInterp;      /* Only if they've passed their check. */
+
+  void            execute( const rcmd_t * );
+  void            raster_curve( const rcmd_t * );
+  static void     consumer_entry( void );
+
+public:
+                  RenderQueue( pimoroni::DVDisplay *, pimoroni::PicoGraphics_PenDV_RGB555 * );
+
+  void            start( void );
+  void            run( void );
+  void            wait_for_frame( void );
+  void            wait_for_idle( void );
+  uint32_t        frame( void );
+  bool            frame_done( uint32_t );
+  void            stats( rqstats_t *, bool );
+  uint32_t        raster_us( void );
+  bool            interpolated( void );
+  RenderRing     *ring( void );
+
+  void            set_pen( uint16_t );
+  void            set_pen( uint8_t, uint8_t, uint8_t );
+  void            set_depth( uint8_t );
+  void            set_clip( const pimoroni::Rect & );
+  void            remove_clip( void );
+  void            pixel( const pimoroni::Point & );
+  void            pixel_span( const pimoroni::Point &, int32_t );
+  void            line( const pimoroni::Point &, const pimoroni::Point & );
+  void            thick_line( const pimoroni::Point &, const pimoroni::Point &, uint8_t );
+  void            curve( const pimoroni::Point &, const pimoroni::Point &, const pimoroni::Point &, uint8_t );
+  void            circle( const pimoroni::Point &, int32_t );
+  void            rectangle( const pimoroni::Rect & );
+  void            text( const char *, const pimoroni::Point &, int32_t );
+  void            set_sprite( uint8_t, uint16_t, const pimoroni::Point &,
+                              pimoroni::DVDisplay::SpriteBlendMode = pimoroni::DVDisplay::SpriteBlendMode::BLEND_DEPTH );
+  void            clear_sprite( uint8_t );
+  void            define_sprite( uint16_t, uint16_t, uint16_t, const uint16_t * );
+  void            setup_scroll_group( const pimoroni::Point &, uint8_t, int16_t );
+  void            flip( void );
+  void            psram_write( uint32_t, const uint32_t *, uint32_t );
+  void            psram_read( uint32_t, uint32_t *, uint32_t );
+};
+
+/* End of file renderqueue.hpp */
@@ -0,0 +1,230 @@
+/*
+ * ring.cpp - part of Arborescence
+ *
+ * Implements the RenderRing class. The producer claims the slot at the head,
+ * fills it in and publishes it; the consumer peeks at the slot at the tail,
+ * executes it, and only then releases it. Each side only ever writes its own
+ * index, so no locks are needed; release and acquire ordering on the indices
+ * makes sure a slot's contents are seen whole, in both directions.
+ *
+ * A full ring stalls the producer, and an empty one starves the consumer;
+ * both are counted, as is how full the ring has been.
+ *
+ * Frames are counted as their flips go through; published by the producer,
+ * and released by the consumer once it's executed them.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <atomic>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; the ring starts empty, with the stats at zero.
+ */
+
+RenderRing::RenderRing( void )
+{
+  this->mHead = this->mTail = 0;
+  this->mFramesQueued = this->mFramesDone = 0;
+
+  this->mCommands = this->mStalls = 0;
+  this->mStarves = 0;
+  this->mPeak = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * claim; finds the next free slot in the ring for the producer, waiting for
+ *        the consumer to free one up if we have to.
+ */
+
+rcmd_t *RenderRing::claim( uint8_t pType )
+{
+  uint32_t  lHead = this->mHead.load( std::memory_order_relaxed );
+  rcmd_t   *lCommand;
+
+  /* If the ring is full, we'll have to wait. */
+  if ( lHead - this->mTail.load( std::memory_order_acquire ) >= RENDER_QUEUE_SIZE )
+  {
+    this->mStalls++;
+    while( lHead - this->mTail.load( std::memory_order_acquire ) >= RENDER_QUEUE_SIZE )
+    {
+      tight_loop_contents();
+    }
+  }
+
+  /* Hand out the slot. */
+  lCommand = &this->mRing[lHead & ( RENDER_QUEUE_SIZE - 1 )];
+  lCommand->type = pType;
+  return lCommand;
+}
+
+
+/*
+ * publish; passes the most recently claimed command over to the consumer.
+ */
+
+void RenderRing::publish( void )
+{
+  uint32_t lHead = this->mHead.load( std::memory_order_relaxed );
+  uint32_t lOccupancy;
+  bool     lFlip = ( this->mRing[lHead & ( RENDER_QUEUE_SIZE - 1 )].type == RCMD_FLIP );
+
+  this->mHead.store( ++lHead, std::memory_order_release );
+  if ( lFlip )
+  {
+    this->mFramesQueued++;
+  }
+
+  /* Keep the stats up to date. */
+  this->mCommands++;
+  lOccupancy = lHead - this->mTail.load( std::memory_order_relaxed );
+  if ( lOccupancy > this->mPeak )
+  {
+    this->mPeak = lOccupancy;
+  }
+}
+
+
+/*
+ * wait_for_frame; keeps the producer no more than a frame ahead of the
+ *                 consumer; it can build the next frame while the previous
+ *                 one is being rasterised, but no further.
+ */
+
+void RenderRing::wait_for_frame( void )
+{
+  while( this->mFramesQueued - this->mFramesDone > 1 )
+  {
+    tight_loop_contents();
+  }
+}
+
+
+/*
+ * wait_for_idle; waits until every command queued so far has been executed.
+ */
+
+void RenderRing::wait_for_idle( void )
+{
+  while( this->mTail.load( std::memory_order_acquire ) != this->mHead.load( std::memory_order_relaxed ) )
+  {
+    tight_loop_contents();
+  }
+}
+
+
+/*
+ * frame; returns the number of the frame currently being queued; anything
+ *        queued now has been executed once frame_done says so.
+ */
+
+uint32_t RenderRing::frame( void )
+{
+  return this->mFramesQueued;
+}
+
+
+/*
+ * frame_done; reports whether the given frame has been drawn and flipped,
+ *             along with everything queued while it was being built.
+ */
+
+bool RenderRing::frame_done( uint32_t pFrame )
+{
+  return (int32_t)( this->mFramesDone - pFrame ) > 0;
+}
+
+
+/*
+ * stats; fills in the current ring statistics, optionally resetting the
+ *        counters (and the peak occupancy) afterwards.
+ */
+
+void RenderRing::stats( rqstats_t *pStats, bool pReset )
+{
+  pStats->commands = this->mCommands;
+  pStats->stalls = this->mStalls;
+  pStats->starves = this->mStarves;
+  pStats->occupancy = this->mHead.load( std::memory_order_relaxed ) - this->mTail.load( std::memory_order_relaxed );
+  pStats->occupancy_peak = this->mPeak;
+
+  if ( pReset )
+  {
+    this->mCommands = this->mStalls = 0;
+    this->mStarves = 0;
+    this->mPeak = 0;
+  }
+}
+
+
+/*
+ * peek; returns the next command for the consumer, or nullptr if there isn't
+ *       one yet. It stays in the ring until it's released.
+ */
+
+const rcmd_t *RenderRing::peek( void )
+{
+  uint32_t lTail = this->mTail.load( std::memory_order_relaxed );
+
+  if ( lTail == this->mHead.load( std::memory_order_acquire ) )
+  {
+    return nullptr;
+  }
+  return &this->mRing[lTail & ( RENDER_QUEUE_SIZE - 1 )];
+}
+
+
+/*
+ * wait; waits for the producer to publish the next command, and returns it.
+ *       Every wait counts as the consumer being starved.
+ */
+
+const rcmd_t *RenderRing::wait( void )
+{
+  uint32_t lTail = this->mTail.load( std::memory_order_relaxed );
+
+  this->mStarves++;
+  while( lTail == this->mHead.load( std::memory_order_acquire ) )
+  {
+    tight_loop_contents();
+  }
+  return &this->mRing[lTail & ( RENDER_QUEUE_SIZE - 1 )];
+}
+
+
+/*
+ * release; hands the consumer's current command back to the producer, once
+ *          it's been executed. If it was a flip, that frame is now done.
+ */
+
+void RenderRing::release( void )
+{
+  uint32_t lTail = this->mTail.load( std::memory_order_relaxed );
+
+  if ( this->mRing[lTail & ( RENDER_QUEUE_SIZE - 1 )].type == RCMD_FLIP )
+  {
+    this->mFramesDone++;
+  }
+  this->mTail.store( lTail + 1, std::memory_order_release );
+}
+
+/* End of file ring.cpp */
@@ -0,0 +1,89 @@
+/*
+ * ring.hpp - part of Arborescence
+ *
+ * This header declares the RenderRing class; the lock-free ring of drawing
+ * commands at the heart of the RenderQueue, with one producer and one
+ * consumer. It knows nothing about drawing, so it can be run between two
+ * threads on a host.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define RENDER_QUEUE_SIZE   512     /* Must be a power of two. */
+
+typedef enum
+{
+  RCMD_PEN, RCMD_DEPTH, RCMD_CLIP, RCMD_UNCLIP,
+  RCMD_PIXEL, RCMD_SPAN, RCMD_LINE, RCMD_THICK_LINE, RCMD_CURVE, RCMD_DISC, RCMD_RECT,
+  RCMD_TEXT, RCMD_SPRITE, RCMD_CLEAR_SPRITE, RCMD_DEFINE_SPRITE, RCMD_SCROLL, RCMD_FLIP,
+  RCMD_PSRAM_WRITE, RCMD_PSRAM_READ
+} rcmd_type_t;
+
+
+/* Structures. */
+
+/* Twenty bytes on the device, since curves added their third point; so the ring is 10K. */
+typedef struct
+{
+  uint8_t         type;
+  uint8_t         arg;
+  uint16_t        pen;
+  int16_t         x1, y1, x2, y2;
+  int16_t         x3, y3;           /* Only curves need a third point. */
+  const void     *data;
+} rcmd_t;
+
+typedef struct
+{
+  uint32_t        commands;
+  uint32_t        stalls;
+  uint32_t        starves;
+  uint16_t        occupancy;
+  uint16_t        occupancy_peak;
+} rqstats_t;
+
+
+/* Class declaration. */
+
+class RenderRing
+{
+private:
+  rcmd_t                                mRing[RENDER_QUEUE_SIZE];
+  std::atomic<uint32_t>                 mHead, mTail;
+  std::atomic<uint32_t>                 mFramesQueued, mFramesDone;
+
+  uint32_t                              mCommands, mStalls;
+  std::atomic<uint32_t>                 mStarves;
+  uint16_t                              mPeak;
+
+public:
+                  RenderRing( void );
+
+  /* The producer's side... */
+  rcmd_t         *claim( uint8_t );
+  void            publish( void );
+  void            wait_for_frame( void );
+  void            wait_for_idle( void );
+  uint32_t        frame( void );
+  bool            frame_done( uint32_t );
+  void            stats( rqstats_t *, bool );
+
+  /* ...and the consumer's. */
+  const rcmd_t   *peek( void );
+  const rcmd_t   *wait( void );
+  void            release( void );
+};
+
+/* End of file ring.hpp */
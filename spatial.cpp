@@ -0,0 +1,456 @@
+/*
+ * spatial.cpp - part of Arborescence
+ *
+ * Implements the SpatialIndex class. Every branch of every tree is recorded
+ * as a primitive (the branch line, plus the leaves at the end of it), and
+ * each primitive is linked into every grid cell that its bounds touch. The
+ * world is endless, so the columns of the grid wrap around; primitives which
+ * share a cell but not a location are filtered out when queried.
+ *
+ * Everything lives in fixed pools, so nothing is allocated as trees grow.
+ *
+ * Separately, and more finely, we count how many trees have leaves in each
+ * part of the world, so that growing trees can tell in a single lookup how
+ * crowded it is where they're reaching. It's up to each tree to add itself
+ * to a cell only once, and to take itself away again when it goes.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdlib.h>
+
+
+/* Local header files. */
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "spatial.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; chains all the primitives and entries onto their free lists,
+ *              and empties every cell.
+ */
+
+SpatialIndex::SpatialIndex( void )
+{
+  for ( uint_fast16_t lIndex = 0; lIndex < SPATIAL_PRIMITIVES_MAX; lIndex++ )
+  {
+    this->mPrimitives[lIndex].owner = nullptr;
+    this->mPrimitives[lIndex].stamp = 0;
+    this->mPrimitives[lIndex].next = lIndex + 1 < SPATIAL_PRIMITIVES_MAX ? lIndex + 1 : SPATIAL_NONE;
+  }
+  for ( uint_fast16_t lIndex = 0; lIndex < SPATIAL_ENTRIES_MAX; lIndex++ )
+  {
+    this->mEntries[lIndex].next = lIndex + 1 < SPATIAL_ENTRIES_MAX ? lIndex + 1 : SPATIAL_NONE;
+  }
+  for ( uint_fast16_t lIndex = 0; lIndex < SPATIAL_COLUMNS * SPATIAL_ROWS; lIndex++ )
+  {
+    this->mCells[lIndex] = SPATIAL_NONE;
+  }
+  for ( uint_fast16_t lIndex = 0; lIndex < SPATIAL_LIGHT_COLUMNS * SPATIAL_LIGHT_ROWS; lIndex++ )
+  {
+    this->mLight[lIndex] = 0;
+  }
+
+  this->mFreePrimitive = this->mFreeEntry = 0;
+  this->mPrimitiveCount = this->mEntryCount = 0;
+  this->mStamp = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * bounds; returns the world rectangle a primitive could draw into.
+ */
+
+pimoroni::Rect SpatialIndex::bounds( const primitive_t *pPrimitive )
+{
+  int32_t lLeft = pPrimitive->start.x < pPrimitive->end.x ? pPrimitive->start.x : pPrimitive->end.x;
+  int32_t lTop = pPrimitive->start.y < pPrimitive->end.y ? pPrimitive->start.y : pPrimitive->end.y;
+
+  return pimoroni::Rect(
+    lLeft - SPATIAL_MARGIN, lTop - SPATIAL_MARGIN,
+    abs( pPrimitive->end.x - pPrimitive->start.x ) + SPATIAL_MARGIN * 2 + 1,
+    abs( pPrimitive->end.y - pPrimitive->start.y ) + SPATIAL_MARGIN * 2 + 1
+  );
+}
+
+
+/*
+ * cell_column; works out the (unwrapped) grid column of a world column; this
+ *              rounds down, even for negative columns.
+ */
+
+int_fast16_t SpatialIndex::cell_column( int32_t pX )
+{
+  if ( pX < 0 )
+  {
+    return -( ( SPATIAL_CELL_SIZE - 1 - pX ) / SPATIAL_CELL_SIZE );
+  }
+  return pX / SPATIAL_CELL_SIZE;
+}
+
+
+/*
+ * cell_row; works out the grid row of a screen row, keeping anything above
+ *           or below the screen in the outermost rows.
+ */
+
+int_fast16_t SpatialIndex::cell_row( int32_t pY )
+{
+  if ( pY < 0 )
+  {
+    return 0;
+  }
+  if ( pY / SPATIAL_CELL_SIZE >= SPATIAL_ROWS )
+  {
+    return SPATIAL_ROWS - 1;
+  }
+  return pY / SPATIAL_CELL_SIZE;
+}
+
+
+/*
+ * insert; records a branch belonging to the given tree, linking it into every
+ *         cell it touches. The group is the tree's own business. Returns false
+ *         if the pools are exhausted, in which case the branch is not indexed
+ *         (and won't be drawn).
+ */
+
+bool SpatialIndex::insert( Tree *pOwner, const pimoroni::Point &pStart,
+                           const pimoroni::Point &pEnd, uint8_t pLevel, uint8_t pGroup )
+{
+  primitive_t    *lPrimitive;
+  pimoroni::Rect  lBounds;
+  int_fast16_t    lIndex, lFirstColumn, lLastColumn, lFirstRow, lLastRow, lEntry;
+
+  /* Make sure we have a primitive to use. */
+  if ( this->mFreePrimitive == SPATIAL_NONE )
+  {
+    return false;
+  }
+  lIndex = this->mFreePrimitive;
+  lPrimitive = &this->mPrimitives[lIndex];
+  lPrimitive->owner = pOwner;
+  lPrimitive->start = pStart;
+  lPrimitive->end = pEnd;
+  lPrimitive->level = pLevel;
+  lPrimitive->group = pGroup;
+
+  /* Work out which cells it covers; no point wrapping around more than once. */
+  lBounds = this->bounds( lPrimitive );
+  lFirstColumn = this->cell_column( lBounds.x );
+  lLastColumn = this->cell_column( lBounds.x + lBounds.w - 1 );
+  if ( lLastColumn - lFirstColumn >= SPATIAL_COLUMNS )
+  {
+    lLastColumn = lFirstColumn + SPATIAL_COLUMNS - 1;
+  }
+  lFirstRow = this->cell_row( lBounds.y );
+  lLastRow = this->cell_row( lBounds.y + lBounds.h - 1 );
+
+  /* And that we have enough entries to link it into all of them. */
+  if ( ( lLastColumn - lFirstColumn + 1 ) * ( lLastRow - lFirstRow + 1 ) >
+       SPATIAL_ENTRIES_MAX - this->mEntryCount )
+  {
+    lPrimitive->owner = nullptr;
+    return false;
+  }
+  this->mFreePrimitive = lPrimitive->next;
+  this->mPrimitiveCount++;
+
+  /* Now link it into the front of each cell's list. */
+  for ( int_fast16_t lColumn = lFirstColumn; lColumn <= lLastColumn; lColumn++ )
+  {
+    int_fast16_t lWrapped = ( ( lColumn % SPATIAL_COLUMNS ) + SPATIAL_COLUMNS ) % SPATIAL_COLUMNS;
+    for ( int_fast16_t lRow = lFirstRow; lRow <= lLastRow; lRow++ )
+    {
+      int16_t *lCell = &this->mCells[lRow * SPATIAL_COLUMNS + lWrapped];
+
+      lEntry = this->mFreeEntry;
+      this->mFreeEntry = this->mEntries[lEntry].next;
+      this->mEntries[lEntry].primitive = lIndex;
+      this->mEntries[lEntry].next = *lCell;
+      *lCell = lEntry;
+      this->mEntryCount++;
+    }
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * remove; drops every primitive belonging to the given tree, typically when
+ *         it dies or its chunk is thrown away.
+ */
+
+void SpatialIndex::remove( Tree *pOwner )
+{
+  /* Unlink the entries from every cell first. */
+  for ( uint_fast16_t lCell = 0; lCell < SPATIAL_COLUMNS * SPATIAL_ROWS; lCell++ )
+  {
+    int16_t *lLink = &this->mCells[lCell];
+    while( *lLink != SPATIAL_NONE )
+    {
+      int16_t lEntry = *lLink;
+      if ( this->mPrimitives[this->mEntries[lEntry].primitive].owner == pOwner )
+      {
+        *lLink = this->mEntries[lEntry].next;
+        this->mEntries[lEntry].next = this->mFreeEntry;
+        this->mFreeEntry = lEntry;
+        this->mEntryCount--;
+        continue;
+      }
+      lLink = &this->mEntries[lEntry].next;
+    }
+  }
+
+  /* And then release the primitives themselves. */
+  for ( uint_fast16_t lIndex = 0; lIndex < SPATIAL_PRIMITIVES_MAX; lIndex++ )
+  {
+    if ( this->mPrimitives[lIndex].owner == pOwner )
+    {
+      this->mPrimitives[lIndex].owner = nullptr;
+      this->mPrimitives[lIndex].next = this->mFreePrimitive;
+      this->mFreePrimitive = lIndex;
+      this->mPrimitiveCount--;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * remove_outermost; removes just one of an owner's primitives, from the
+ *                   highest level it has, and returns the area it covered
+ *                   (leaves and all). Returns false if the owner has none left.
+ */
+
+bool SpatialIndex::remove_outermost( Tree *pOwner, pimoroni::Rect *pBounds )
+{
+  int_fast16_t  lIndex = SPATIAL_NONE;
+  int_fast16_t  lFirstColumn, lLastColumn, lFirstRow, lLastRow;
+
+  /* Find the outermost primitive; the last one of a level is as good as any. */
+  for ( uint_fast16_t lSearch = 0; lSearch < SPATIAL_PRIMITIVES_MAX; lSearch++ )
+  {
+    if ( ( this->mPrimitives[lSearch].owner == pOwner ) &&
+         ( ( lIndex == SPATIAL_NONE ) || ( this->mPrimitives[lSearch].level >= this->mPrimitives[lIndex].level ) ) )
+    {
+      lIndex = lSearch;
+    }
+  }
+  if ( lIndex == SPATIAL_NONE )
+  {
+    return false;
+  }
+
+  /* Only the cells it was linked into need looking at. */
+  *pBounds = this->bounds( &this->mPrimitives[lIndex] );
+  lFirstColumn = this->cell_column( pBounds->x );
+  lLastColumn = this->cell_column( pBounds->x + pBounds->w - 1 );
+  if ( lLastColumn - lFirstColumn >= SPATIAL_COLUMNS )
+  {
+    lLastColumn = lFirstColumn + SPATIAL_COLUMNS - 1;
+  }
+  lFirstRow = this->cell_row( pBounds->y );
+  lLastRow = this->cell_row( pBounds->y + pBounds->h - 1 );
+
+  for ( int_fast16_t lColumn = lFirstColumn; lColumn <= lLastColumn; lColumn++ )
+  {
+    int_fast16_t lWrapped = ( ( lColumn % SPATIAL_COLUMNS ) + SPATIAL_COLUMNS ) % SPATIAL_COLUMNS;
+    for ( int_fast16_t lRow = lFirstRow; lRow <= lLastRow; lRow++ )
+    {
+      int16_t *lLink = &this->mCells[lRow * SPATIAL_COLUMNS + lWrapped];
+      while( *lLink != SPATIAL_NONE )
+      {
+        int16_t lEntry = *lLink;
+        if ( this->mEntries[lEntry].primitive == lIndex )
+        {
+          *lLink = this->mEntries[lEntry].next;
+          this->mEntries[lEntry].next = this->mFreeEntry;
+          this->mFreeEntry = lEntry;
+          this->mEntryCount--;
+          break;
+        }
+        lLink = &this->mEntries[lEntry].next;
+      }
+    }
+  }
+
+  /* And release the primitive itself. */
+  this->mPrimitives[lIndex].owner = nullptr;
+  this->mPrimitives[lIndex].next = this->mFreePrimitive;
+  this->mFreePrimitive = lIndex;
+  this->mPrimitiveCount--;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * query; finds every primitive which could draw into the given world
+ *        rectangle, filling in up to the given number of them. Each primitive
+ *        is only reported once, however many cells it spans.
+ */
+
+uint_fast16_t SpatialIndex::query( const pimoroni::Rect &pRect, const primitive_t **pFound,
+                                   uint_fast16_t pMax )
+{
+  uint_fast16_t lCount = 0;
+  int_fast16_t  lFirstColumn, lLastColumn, lFirstRow, lLastRow;
+
+  /* Move the stamp on, so we can tell which primitives we've already seen. */
+  if ( ++this->mStamp == 0 )
+  {
+    for ( uint_fast16_t lIndex = 0; lIndex < SPATIAL_PRIMITIVES_MAX; lIndex++ )
+    {
+      this->mPrimitives[lIndex].stamp = 0;
+    }
+    this->mStamp = 1;
+  }
+
+  /* Work out the cells to search. */
+  lFirstColumn = this->cell_column( pRect.x );
+  lLastColumn = this->cell_column( pRect.x + pRect.w - 1 );
+  if ( lLastColumn - lFirstColumn >= SPATIAL_COLUMNS )
+  {
+    lLastColumn = lFirstColumn + SPATIAL_COLUMNS - 1;
+  }
+  lFirstRow = this->cell_row( pRect.y );
+  lLastRow = this->cell_row( pRect.y + pRect.h - 1 );
+
+  /* And check everything in them. */
+  for ( int_fast16_t lColumn = lFirstColumn; lColumn <= lLastColumn; lColumn++ )
+  {
+    int_fast16_t lWrapped = ( ( lColumn % SPATIAL_COLUMNS ) + SPATIAL_COLUMNS ) % SPATIAL_COLUMNS;
+    for ( int_fast16_t lRow = lFirstRow; lRow <= lLastRow; lRow++ )
+    {
+      for ( int16_t lEntry = this->mCells[lRow * SPATIAL_COLUMNS + lWrapped];
+            lEntry != SPATIAL_NONE; lEntry = this->mEntries[lEntry].next )
+      {
+        primitive_t *lPrimitive = &this->mPrimitives[this->mEntries[lEntry].primitive];
+
+        if ( lPrimitive->stamp == this->mStamp )
+        {
+          continue;
+        }
+        lPrimitive->stamp = this->mStamp;
+
+        /* Cells wrap around the world, so make sure it's really in the rectangle. */
+        if ( ( lCount < pMax ) && ( this->bounds( lPrimitive ).intersects( pRect ) ) )
+        {
+          pFound[lCount++] = lPrimitive;
+        }
+      }
+    }
+  }
+
+  /* All done. */
+  return lCount;
+}
+
+
+/*
+ * stats; reports how many primitives, and cell entries, are in use.
+ */
+
+void SpatialIndex::stats( uint_fast16_t *pPrimitives, uint_fast16_t *pEntries )
+{
+  *pPrimitives = this->mPrimitiveCount;
+  *pEntries = this->mEntryCount;
+}
+
+
+/*
+ * light_column; works out the (unwrapped) light column of a world column,
+ *               rounding down like cell_column.
+ */
+
+int_fast16_t SpatialIndex::light_column( int32_t pX )
+{
+  if ( pX < 0 )
+  {
+    return -( ( SPATIAL_LIGHT_SIZE - 1 - pX ) / SPATIAL_LIGHT_SIZE );
+  }
+  return pX / SPATIAL_LIGHT_SIZE;
+}
+
+
+/*
+ * light_row; works out the light row of a screen row, keeping anything off
+ *            the screen in the outermost rows.
+ */
+
+int_fast16_t SpatialIndex::light_row( int32_t pY )
+{
+  if ( pY < 0 )
+  {
+    return 0;
+  }
+  if ( pY / SPATIAL_LIGHT_SIZE >= SPATIAL_LIGHT_ROWS )
+  {
+    return SPATIAL_LIGHT_ROWS - 1;
+  }
+  return pY / SPATIAL_LIGHT_SIZE;
+}
+
+
+/*
+ * light; returns how many trees have leaves in the given light cell; rows
+ *        outside the grid are always empty.
+ */
+
+uint_fast8_t SpatialIndex::light( int_fast16_t pColumn, int_fast16_t pRow )
+{
+  if ( ( pRow < 0 ) || ( pRow >= SPATIAL_LIGHT_ROWS ) )
+  {
+    return 0;
+  }
+  pColumn = ( ( pColumn % SPATIAL_LIGHT_COLUMNS ) + SPATIAL_LIGHT_COLUMNS ) % SPATIAL_LIGHT_COLUMNS;
+  return this->mLight[pRow * SPATIAL_LIGHT_COLUMNS + pColumn];
+}
+
+
+/*
+ * light_add; counts another tree with leaves in the given light cell.
+ */
+
+void SpatialIndex::light_add( int_fast16_t pColumn, int_fast16_t pRow )
+{
+  pColumn = ( ( pColumn % SPATIAL_LIGHT_COLUMNS ) + SPATIAL_LIGHT_COLUMNS ) % SPATIAL_LIGHT_COLUMNS;
+  if ( this->mLight[pRow * SPATIAL_LIGHT_COLUMNS + pColumn] < UINT8_MAX )
+  {
+    this->mLight[pRow * SPATIAL_LIGHT_COLUMNS + pColumn]++;
+  }
+}
+
+
+/*
+ * light_remove; forgets a tree which had leaves in the given light cell.
+ */
+
+void SpatialIndex::light_remove( int_fast16_t pColumn, int_fast16_t pRow )
+{
+  pColumn = ( ( pColumn % SPATIAL_LIGHT_COLUMNS ) + SPATIAL_LIGHT_COLUMNS ) % SPATIAL_LIGHT_COLUMNS;
+  if ( this->mLight[pRow * SPATIAL_LIGHT_COLUMNS + pColumn] > 0 )
+  {
+    this->mLight[pRow * SPATIAL_LIGHT_COLUMNS + pColumn]--;
+  }
+}
+
+/* End of file spatial.cpp */
@@ -0,0 +1,90 @@
+/*
+ * spatial.hpp - part of Arborescence
+ *
+ * This header declares the SpatialIndex class; a uniform grid over the world
+ * which records where every branch (and its leaves) of every tree lies, so
+ * that we can find everything which needs drawing in a given rectangle.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define SPATIAL_CELL_SIZE       64
+#define SPATIAL_COLUMNS         ( ( CHUNK_WIDTH * CHUNK_CACHE_SIZE ) / SPATIAL_CELL_SIZE + 2 )
+#define SPATIAL_ROWS            ( SCREEN_HEIGHT / SPATIAL_CELL_SIZE + 1 )
+#define SPATIAL_PRIMITIVES_MAX  640
+#define SPATIAL_ENTRIES_MAX     2048
+#define SPATIAL_MARGIN          16      /* Covers leaves, and thick branches. */
+#define SPATIAL_NONE            -1
+
+/* Alongside, a finer count of how many trees have leaves in each part of the world. */
+#define SPATIAL_LIGHT_SIZE      32
+#define SPATIAL_LIGHT_COLUMNS   ( SPATIAL_COLUMNS * SPATIAL_CELL_SIZE / SPATIAL_LIGHT_SIZE )
+#define SPATIAL_LIGHT_ROWS      ( SPATIAL_ROWS * SPATIAL_CELL_SIZE / SPATIAL_LIGHT_SIZE )
+
+
+/* Structures. */
+
+class Tree;
+
+typedef struct
+{
+  Tree           *owner;
+  pimoroni::Point start, end;
+  uint8_t         level;
+  uint8_t         group;
+  uint16_t        stamp;
+  int16_t         next;
+} primitive_t;
+
+typedef struct
+{
+  int16_t         primitive;
+  int16_t         next;
+} spatial_entry_t;
+
+
+/* Class declaration. */
+
+class SpatialIndex
+{
+private:
+  primitive_t                           mPrimitives[SPATIAL_PRIMITIVES_MAX];
+  spatial_entry_t                       mEntries[SPATIAL_ENTRIES_MAX];
+  int16_t                               mCells[SPATIAL_COLUMNS * SPATIAL_ROWS];
+  uint8_t                               mLight[SPATIAL_LIGHT_COLUMNS * SPATIAL_LIGHT_ROWS];
+  int16_t                               mFreePrimitive, mFreeEntry;
+  uint16_t                              mStamp;
+  uint16_t                              mPrimitiveCount, mEntryCount;
+
+  pimoroni::Rect  bounds( const primitive_t * );
+  int_fast16_t    cell_column( int32_t );
+  int_fast16_t    cell_row( int32_t );
+
+public:
+                  SpatialIndex( void );
+
+  bool            insert( Tree *, const pimoroni::Point &, const pimoroni::Point &, uint8_t, uint8_t );
+  void            remove( Tree * );
+  bool            remove_outermost( Tree *, pimoroni::Rect * );
+  uint_fast16_t   query( const pimoroni::Rect &, const primitive_t **, uint_fast16_t );
+  void            stats( uint_fast16_t *, uint_fast16_t * );
+
+  uint_fast8_t    light( int_fast16_t, int_fast16_t );
+  void            light_add( int_fast16_t, int_fast16_t );
+  void            light_remove( int_fast16_t, int_fast16_t );
+
+  static int_fast16_t light_column( int32_t );
+  static int_fast16_t light_row( int32_t );
+};
+
+/* End of file spatial.hpp */
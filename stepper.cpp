@@ -0,0 +1,128 @@
+/*
+ * stepper.cpp - part of Arborescence
+ *
+ * Implements the Stepper class. A stepper follows one axis of a curve by
+ * forward differencing, in fixed point; each step adds the step to the
+ * value, and the acceleration to the step, and hands back the value shifted
+ * down to whole pixels. Rounding is folded into the starting value, so it
+ * costs nothing per step.
+ *
+ * On the device, this can be done by an interpolator. Lane 0 adds its base
+ * (the step) to the accumulator, raw; lane 1 reads that same accumulator,
+ * shifts it and sign extends it. Each core has its own pair of interpolators,
+ * so two steppers (one per axis) can run at once on either core, but not in
+ * an interrupt handler that might interrupt another.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdio.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+#endif
+
+#include "arborescence.hpp"
+#include "stepper.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * start; sets off from the given value (already including any rounding),
+ *        with the given step and acceleration, shifting down by the given
+ *        number of bits. On the device, interpolator 0 or 1 can do the work
+ *        if asked; elsewhere it's always done in software.
+ */
+
+void Stepper::start( int32_t pValue, int32_t pStep, int32_t pAccel, uint_fast8_t pShift,
+                     uint_fast8_t pUnit, bool pHardware )
+{
+  this->mValue = pValue;
+  this->mStep = pStep;
+  this->mAccel = pAccel;
+  this->mShift = pShift;
+
+#if PICO_ON_DEVICE
+  this->mInterp = nullptr;
+  if ( pHardware )
+  {
+    interp_config lConfig;
+
+    this->mInterp = pUnit ? interp1 : interp0;
+
+    /* Lane 0 just adds the step to the accumulator... */
+    lConfig = interp_default_config();
+    interp_config_set_add_raw( &lConfig, true );
+    interp_set_config( this->mInterp, 0, &lConfig );
+
+    /* ...while lane 1 reads it, and shifts it down to whole pixels. */
+    lConfig = interp_default_config();
+    interp_config_set_cross_input( &lConfig, true );
+    interp_config_set_shift( &lConfig, pShift );
+    interp_config_set_mask( &lConfig, 0, 31 - pShift );
+    interp_config_set_signed( &lConfig, true );
+    interp_set_config( this->mInterp, 1, &lConfig );
+
+    this->mInterp->accum[0] = pValue;
+    this->mInterp->base[0] = pStep;
+    this->mInterp->base[1] = 0;
+  }
+#else
+  /* There's only the software, so nothing to choose between. */
+  (void)pUnit;
+  (void)pHardware;
+#endif
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * self_check; steps a number of random curves, in both software and on the
+ *             interpolators, and makes sure they agree at every step. Returns
+ *             true if they do. Each core has its own interpolators, so this
+ *             must run on the core that's going to use them; the render
+ *             queue's consumer does so as it starts. On a host both are the
+ *             software, and it always will.
+ */
+
+bool Stepper::self_check( uint32_t pSeed, uint_fast16_t pCount )
+{
+  Stepper       lSoftware, lHardware;
+  int32_t       lStart, lStep, lAccel;
+  uint_fast8_t  lShift;
+  uint32_t      lRandom = pSeed;
+
+  for ( uint_fast16_t lCurve = 0; lCurve < pCount; lCurve++ )
+  {
+    /* Anything a branch could throw at the rasteriser, including going backwards. */
+    lShift = 2 + ( random_next( &lRandom ) % ( CURVE_SHIFT_MAX * 2 - 1 ) );
+    lStart = ( (int32_t)( random_next( &lRandom ) % FRAME_WIDTH ) - 40 ) * ( 1 << lShift ) + ( 1 << ( lShift - 1 ) );
+    lStep = (int32_t)( random_next( &lRandom ) % ( 1 << ( lShift + 1 ) ) ) - ( 1 << lShift );
+    lAccel = (int32_t)( random_next( &lRandom ) % 512 ) - 256;
+
+    lSoftware.start( lStart, lStep, lAccel, lShift, 0, false );
+    lHardware.start( lStart, lStep, lAccel, lShift, lCurve & 1, true );
+    for ( uint_fast16_t lIndex = 0; lIndex < ( 1 << CURVE_SHIFT_MAX ); lIndex++ )
+    {
+      if ( lSoftware.next() != lHardware.next() )
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* End of file stepper.cpp */
@@ -0,0 +1,79 @@
+/*
+ * stepper.hpp - part of Arborescence
+ *
+ * This header declares the Stepper class; the add-and-shift heart of the
+ * curve rasteriser, which can either run in software or on one of the
+ * RP2040's interpolators. Both give exactly the same answers.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+#endif
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define CURVE_SHIFT_MAX     9       /* So at most 512 steps along a curve. */
+#define STEPPER_CHECK_SEED  0x494E5450
+#define STEPPER_CHECK_CURVES 64
+
+
+/* Class declaration. */
+
+class Stepper
+{
+private:
+  int32_t                               mValue, mStep, mAccel;
+  uint_fast8_t                          mShift;
+#if PICO_ON_DEVICE
+  interp_hw_t                          *mInterp;
+#endif
+
+public:
+  void            start( int32_t, int32_t, int32_t, uint_fast8_t, uint_fast8_t, bool );
+  static bool     self_check( uint32_t, uint_fast16_t );
+
+  /*
+   * next; returns the current position, shifted down to whole pixels, and
+   *       moves on a step. On an interpolator, popping lane 1 gives us the
+   *       shifted accumulator, and adds the step to it in the same cycle;
+   *       only the step itself needs updating by hand.
+   */
+  inline int32_t next( void )
+  {
+    int32_t lValue;
+
+#if PICO_ON_DEVICE
+    if ( this->mInterp != nullptr )
+    {
+      lValue = (int32_t)this->mInterp->pop[1];
+      this->mStep += this->mAccel;
+      this->mInterp->base[0] = this->mStep;
+      return lValue;
+    }
+#endif
+
+    lValue = this->mValue >> this->mShift;
+    this->mValue += this->mStep;
+    this->mStep += this->mAccel;
+    return lValue;
+  }
+
+  /*
+   * step; returns the current step, to tell which way we're heading.
+   */
+  inline int32_t step( void )
+  {
+    return this->mStep;
+  }
+};
+
+/* End of file stepper.hpp */
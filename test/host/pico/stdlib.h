@@ -0,0 +1,30 @@
+/*
+ * pico/stdlib.h - part of Arborescence
+ *
+ * A stand-in for the SDK's header, for the host tests. The modules they build
+ * only want the standard integer types from it, and somewhere to spin.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef PICO_ON_DEVICE
+#define PICO_ON_DEVICE 0
+#endif
+
+typedef unsigned int uint;
+
+/* Spinning threads give way, in case whoever they're waiting for shares their CPU. */
+static inline void tight_loop_contents( void )
+{
+  sched_yield();
+}
+
+/* End of file pico/stdlib.h */
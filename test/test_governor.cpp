@@ -0,0 +1,261 @@
+/*
+ * test_governor.cpp - part of Arborescence
+ *
+ * Host test for the Governor. Replays a made-up trace, phase by phase, and
+ * checks the level it settles on after each; then checks that a refused
+ * level is never asked for again. Given a file of `@gov` lines captured with
+ * GOVERNOR_TRACE set, it replays that instead, and checks every decision
+ * against the one made on the device.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "governor.hpp"
+
+
+/* Constants. */
+
+#define TEST_LIGHT_US   4000    /* A quarter of the frame budget. */
+#define TEST_HALF_US    8500    /* Just too busy to step down from the top. */
+#define TEST_HEAVY_US   15000   /* Over GOVERNOR_UP_PERCENT. */
+#define TEST_TRACE      "test_governor.trace"
+#define TEST_RATIO_US   7834    /* 47%; can step down from 125MHz to 100MHz, but not to 93.75MHz. */
+
+
+/* Structures. */
+
+typedef struct
+{
+  uint_fast16_t   frames;       /* This many frames of the same sample... */
+  uint32_t        busy_us;
+  uint32_t        raster_us;
+  bool            heavy_ahead;
+  uint_fast8_t    level;        /* ...should leave us at this level. */
+  const char     *what;
+} test_phase_t;
+
+
+/* Module variables. */
+
+/* The levels main() works out from the default 125MHz boot clock; both fractions are exact. */
+static const uint32_t m_levels[GOVERNOR_LEVELS] = { 62500, 93750, 125000 };
+
+static const test_phase_t m_phases[] =
+{
+  { GOVERNOR_DOWN_FRAMES - 1, TEST_LIGHT_US, 3000, false, 2, "a light load takes a while to step down" },
+  { 1, TEST_LIGHT_US, 3000, false, 1, "and then steps down one level" },
+  { GOVERNOR_DOWN_FRAMES, TEST_LIGHT_US, 3000, false, 0, "and then the next" },
+  { GOVERNOR_DOWN_FRAMES, TEST_LIGHT_US, 3000, false, 0, "but no further" },
+  { 1, TEST_LIGHT_US, 3000, true, 2, "heavy work goes straight to the top" },
+  { GOVERNOR_BOOST_FRAMES + GOVERNOR_DOWN_FRAMES - 1, TEST_LIGHT_US, 3000, false, 2, "and stays there for a while" },
+  { 1, TEST_LIGHT_US, 3000, false, 1, "before stepping down again" },
+  { 1, TEST_HEAVY_US, 3000, false, 1, "one busy frame is a one-off" },
+  { 1, TEST_HEAVY_US, 3000, false, 2, "two of them step up" },
+  { GOVERNOR_DOWN_FRAMES * 4, TEST_HALF_US, 3000, false, 2, "a load too big for the next level down stays put" },
+  { GOVERNOR_UP_FRAMES, 3000, TEST_HEAVY_US, false, 2, "the busier core sets the load" },
+  { GOVERNOR_DOWN_FRAMES, 3000, TEST_LIGHT_US, false, 1, "either core" },
+};
+
+static uint_fast8_t m_failures = 0;
+
+
+/* Functions. */
+
+
+/*
+ * check; notes a failure, if the condition doesn't hold.
+ */
+
+static void check( bool pCondition, const char *pWhat )
+{
+  if ( !pCondition )
+  {
+    fprintf( stderr, "FAIL: %s\n", pWhat );
+    m_failures++;
+  }
+}
+
+
+/*
+ * feed; gives the governor the same sample for a number of frames, and
+ *       returns the last level it decided on.
+ */
+
+static uint_fast8_t feed( Governor *pGovernor, const governor_sample_t *pSample, uint_fast16_t pFrames )
+{
+  uint_fast8_t lLevel = pGovernor->level();
+
+  for ( uint_fast16_t lFrame = 0; lFrame < pFrames; lFrame++ )
+  {
+    lLevel = pGovernor->decide( pSample );
+  }
+  return lLevel;
+}
+
+
+/*
+ * test_phases; replays the made-up trace.
+ */
+
+static void test_phases( void )
+{
+  Governor          lGovernor( m_levels, GOVERNOR_LEVELS - 1 );
+  governor_sample_t lSample;
+
+  for ( const test_phase_t &lPhase : m_phases )
+  {
+    lSample.frame_us = GOVERNOR_BUDGET_US;
+    lSample.busy_us = lPhase.busy_us;
+    lSample.raster_us = lPhase.raster_us;
+    lSample.heavy_ahead = lPhase.heavy_ahead;
+    check( feed( &lGovernor, &lSample, lPhase.frames ) == lPhase.level, lPhase.what );
+  }
+}
+
+
+/*
+ * test_refuse; a level the clock couldn't be set to is given up on, in both
+ *              directions.
+ */
+
+static void test_refuse( void )
+{
+  Governor          lGovernor( m_levels, 1 );
+  governor_sample_t lBusy = { GOVERNOR_BUDGET_US, TEST_HEAVY_US, 0, false };
+  governor_sample_t lLight = { GOVERNOR_BUDGET_US, TEST_LIGHT_US, 0, false };
+
+  check( feed( &lGovernor, &lBusy, GOVERNOR_UP_FRAMES ) == 2, "a busy load asks for the top level" );
+  lGovernor.refuse( 1 );
+  check( lGovernor.level() == 1, "refusing goes back to where we were" );
+  check( lGovernor.khz() == m_levels[1], "at that level's speed" );
+  check( feed( &lGovernor, &lBusy, GOVERNOR_UP_FRAMES * 8 ) == 1, "and a refused level isn't asked for again" );
+  check( feed( &lGovernor, &lLight, GOVERNOR_DOWN_FRAMES ) == 0, "other levels still are" );
+  check( feed( &lGovernor, &lBusy, GOVERNOR_UP_FRAMES * 8 ) == 1, "but only up to the refused one" );
+
+  /* And from the top, the refused level blocks stepping down past it. */
+  Governor lTop( m_levels, GOVERNOR_LEVELS - 1 );
+  check( feed( &lTop, &lLight, GOVERNOR_DOWN_FRAMES ) == 1, "a light load steps down" );
+  lTop.refuse( 2 );
+  check( feed( &lTop, &lLight, GOVERNOR_DOWN_FRAMES * 4 ) == 2, "unless that level is refused" );
+}
+
+
+/*
+ * replay; checks every decision in a captured trace against the governor's.
+ *         The clock levels come from the trace's `@gov levels` line, which
+ *         the device prints before its first decision; without one, they're
+ *         taken to be those of a board that booted at the default speed.
+ */
+
+static void replay( const char *pFilename )
+{
+  uint32_t          lLevels[GOVERNOR_LEVELS] = { m_levels[0], m_levels[1], m_levels[2] };
+  Governor          lGovernor( lLevels, GOVERNOR_LEVELS - 1 );
+  governor_sample_t lSample;
+  FILE             *lTrace;
+  char              lLine[128];
+  uint32_t          lLines = 0, lMismatches = 0;
+  int               lHeavy, lLevel;
+
+  lTrace = fopen( pFilename, "r" );
+  if ( lTrace == nullptr )
+  {
+    check( false, "the trace can be read" );
+    return;
+  }
+  while( fgets( lLine, sizeof( lLine ), lTrace ) != nullptr )
+  {
+    if ( sscanf( lLine, "@gov levels %" SCNu32 " %" SCNu32 " %" SCNu32, &lLevels[0], &lLevels[1], &lLevels[2] ) == 3 )
+    {
+      /* The governor reads the table as it goes, so this is all it takes. */
+      continue;
+    }
+    if ( sscanf( lLine, "@gov %" SCNu32 " %" SCNu32 " %" SCNu32 " %d %d", &lSample.frame_us,
+                 &lSample.busy_us, &lSample.raster_us, &lHeavy, &lLevel ) != 5 )
+    {
+      continue;
+    }
+    lLines++;
+    lSample.heavy_ahead = ( lHeavy != 0 );
+    if ( lGovernor.decide( &lSample ) != lLevel )
+    {
+      fprintf( stderr, "line %" PRIu32 ": decided %d, not %d\n", lLines, (int)lGovernor.level(), lLevel );
+      lMismatches++;
+
+      /* Follow the device, so that one difference isn't reported forever. */
+      lGovernor = Governor( lLevels, lLevel );
+    }
+  }
+  fclose( lTrace );
+
+  printf( "governor: %" PRIu32 " decisions replayed, %" PRIu32 " different\n", lLines, lMismatches );
+  check( lLines > 0, "the trace has decisions in it" );
+  check( lMismatches == 0, "every decision is the same as on the device" );
+}
+
+
+/*
+ * test_levels; a trace from a board with a different set of levels only
+ *              replays properly if its levels line is followed.
+ */
+
+static void test_levels( void )
+{
+  FILE *lTrace;
+
+  lTrace = fopen( TEST_TRACE, "w" );
+  if ( lTrace == nullptr )
+  {
+    check( false, "the trace can be written" );
+    return;
+  }
+  fprintf( lTrace, "@gov levels 50000 100000 125000\n" );
+  for ( uint_fast16_t lFrame = 1; lFrame <= GOVERNOR_DOWN_FRAMES; lFrame++ )
+  {
+    fprintf( lTrace, "@gov %d %d 0 0 %d\n", GOVERNOR_BUDGET_US, TEST_RATIO_US,
+             lFrame < GOVERNOR_DOWN_FRAMES ? 2 : 1 );
+  }
+  fclose( lTrace );
+
+  replay( TEST_TRACE );
+}
+
+
+/*
+ * main; runs each test in turn, or replays the trace it's given.
+ */
+
+int main( int argc, char **argv )
+{
+  if ( argc > 1 )
+  {
+    replay( argv[1] );
+  }
+  else
+  {
+    test_phases();
+    test_refuse();
+    test_levels();
+  }
+
+  if ( m_failures > 0 )
+  {
+    return 1;
+  }
+  printf( "governor: all passed\n" );
+  return 0;
+}
+
+/* End of file test_governor.cpp */
@@ -0,0 +1,199 @@
+/*
+ * test_offscreen.cpp - part of Arborescence
+ *
+ * Host test for the OffscreenHeap; ordinary memory stands in for the PSRAM
+ * here, but the bookkeeping is exactly what runs on the device. Checks that
+ * regions are aligned and kept apart, that what's written reads back, and
+ * that each lifetime lasts as long as it should.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdio.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "offscreen.hpp"
+
+
+/* Constants. */
+
+#define TEST_QUARTER    ( ( OFFSCREEN_LIMIT - OFFSCREEN_BASE ) / 4 )
+
+
+/* Module variables. */
+
+static uint_fast8_t m_failures = 0;
+static void        *m_evicted_owner = nullptr;
+static int_fast8_t  m_evicted_handle = OFFSCREEN_NONE;
+
+
+/* Functions. */
+
+
+/*
+ * check; notes a failure, if the condition doesn't hold.
+ */
+
+static void check( bool pCondition, const char *pWhat )
+{
+  if ( !pCondition )
+  {
+    fprintf( stderr, "FAIL: %s\n", pWhat );
+    m_failures++;
+  }
+}
+
+
+/*
+ * evicted; the eviction callback, which just remembers who it was told about.
+ */
+
+static void evicted( void *pOwner, int_fast8_t pHandle )
+{
+  m_evicted_owner = pOwner;
+  m_evicted_handle = pHandle;
+}
+
+
+/*
+ * test_layout; regions are whole bursts, aligned, and never overlap; and
+ *              what goes into one comes back out again.
+ */
+
+static void test_layout( void )
+{
+  OffscreenHeap     lHeap( nullptr );
+  offscreen_stats_t lStats;
+  int_fast8_t       lFirst, lSecond;
+  uint32_t          lOut[8], lIn[8];
+
+  lFirst = lHeap.alloc( 100, OFFSCREEN_PINNED, nullptr, nullptr );
+  lSecond = lHeap.alloc( 1, OFFSCREEN_PINNED, nullptr, nullptr );
+  check( ( lFirst != OFFSCREEN_NONE ) && ( lSecond != OFFSCREEN_NONE ), "small regions fit" );
+  check( lHeap.address( lFirst ) % OFFSCREEN_ALIGN == 0, "first region is aligned" );
+  check( lHeap.address( lSecond ) % OFFSCREEN_ALIGN == 0, "second region is aligned" );
+  check( ( lHeap.address( lSecond ) >= lHeap.address( lFirst ) + 128 ) ||
+         ( lHeap.address( lFirst ) >= lHeap.address( lSecond ) + OFFSCREEN_ALIGN ), "regions don't overlap" );
+
+  lHeap.stats( &lStats, false );
+  check( lStats.used == 128 + OFFSCREEN_ALIGN, "sizes are rounded up to whole bursts" );
+  check( lStats.regions == 2, "both regions are counted" );
+
+  for ( uint_fast8_t lIndex = 0; lIndex < 8; lIndex++ )
+  {
+    lOut[lIndex] = 0x10203040 * ( lIndex + 1 );
+  }
+  lHeap.write( lFirst, 32, lOut, 8 );
+  lHeap.read( lFirst, 32, lIn, 8 );
+  for ( uint_fast8_t lIndex = 0; lIndex < 8; lIndex++ )
+  {
+    check( lIn[lIndex] == lOut[lIndex], "words read back as written" );
+  }
+
+  check( lHeap.alloc( 0, OFFSCREEN_PINNED, nullptr, nullptr ) == OFFSCREEN_NONE, "empty regions are refused" );
+  check( lHeap.alloc( OFFSCREEN_LIMIT, OFFSCREEN_PINNED, nullptr, nullptr ) == OFFSCREEN_NONE, "huge regions are refused" );
+  lHeap.stats( &lStats, false );
+  check( lStats.failures == 2, "refusals are counted" );
+
+  lHeap.free( lFirst );
+  lHeap.free( lFirst );
+  lHeap.stats( &lStats, false );
+  check( lStats.used == OFFSCREEN_ALIGN, "freeing twice is harmless" );
+}
+
+
+/*
+ * test_frame; frame regions last until the frame after next, like the arena.
+ */
+
+static void test_frame( void )
+{
+  OffscreenHeap     lHeap( nullptr );
+  offscreen_stats_t lStats;
+
+  lHeap.alloc( 256, OFFSCREEN_FRAME, nullptr, nullptr );
+  lHeap.reset();
+  lHeap.stats( &lStats, false );
+  check( lStats.regions == 1, "frame region survives the next frame" );
+  lHeap.reset();
+  lHeap.stats( &lStats, false );
+  check( ( lStats.regions == 0 ) && ( lStats.used == 0 ), "frame region goes the frame after" );
+}
+
+
+/*
+ * test_eviction; when full, the least recently touched cached region goes,
+ *                and its owner is told; pinned ones never do.
+ */
+
+static void test_eviction( void )
+{
+  OffscreenHeap     lHeap( nullptr );
+  offscreen_stats_t lStats;
+  int_fast8_t       lRegions[4], lNew;
+  static int        lOwners[4];
+
+  for ( uint_fast8_t lIndex = 0; lIndex < 4; lIndex++ )
+  {
+    lRegions[lIndex] = lHeap.alloc( TEST_QUARTER, OFFSCREEN_CACHED, evicted, &lOwners[lIndex] );
+    lHeap.reset();
+  }
+  check( lRegions[3] != OFFSCREEN_NONE, "four quarters fill the heap" );
+
+  /* The first is the oldest, until it's touched; then the second is. */
+  lHeap.touch( lRegions[0] );
+  lNew = lHeap.alloc( TEST_QUARTER, OFFSCREEN_CACHED, evicted, nullptr );
+  check( lNew != OFFSCREEN_NONE, "a full heap makes room" );
+  check( ( m_evicted_owner == &lOwners[1] ) && ( m_evicted_handle == lRegions[1] ),
+         "the least recently touched region is evicted, and its owner told" );
+  lHeap.stats( &lStats, false );
+  check( lStats.evictions == 1, "evictions are counted" );
+
+  /* Once everything is pinned, there's nothing to evict. */
+  OffscreenHeap lPinned( nullptr );
+  for ( uint_fast8_t lIndex = 0; lIndex < 4; lIndex++ )
+  {
+    lPinned.alloc( TEST_QUARTER, OFFSCREEN_PINNED, nullptr, nullptr );
+  }
+  check( lPinned.alloc( 64, OFFSCREEN_CACHED, nullptr, nullptr ) == OFFSCREEN_NONE, "pinned regions stay put" );
+
+  /* Running out of table entries evicts too. */
+  OffscreenHeap lSmall( nullptr );
+  for ( uint_fast8_t lIndex = 0; lIndex < OFFSCREEN_REGIONS_MAX; lIndex++ )
+  {
+    lSmall.alloc( 64, lIndex == 5 ? OFFSCREEN_CACHED : OFFSCREEN_PINNED, evicted, nullptr );
+  }
+  m_evicted_handle = OFFSCREEN_NONE;
+  check( lSmall.alloc( 64, OFFSCREEN_PINNED, nullptr, nullptr ) == 5, "a full table reuses a cached entry" );
+  check( m_evicted_handle == 5, "and tells its owner" );
+  check( lSmall.alloc( 64, OFFSCREEN_PINNED, nullptr, nullptr ) == OFFSCREEN_NONE, "until there are none left" );
+}
+
+
+/*
+ * main; runs each test in turn.
+ */
+
+int main( void )
+{
+  test_layout();
+  test_frame();
+  test_eviction();
+
+  if ( m_failures > 0 )
+  {
+    return 1;
+  }
+  printf( "offscreen: all passed\n" );
+  return 0;
+}
+
+/* End of file test_offscreen.cpp */
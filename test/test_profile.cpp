@@ -0,0 +1,154 @@
+/*
+ * test_profile.cpp - part of Arborescence
+ *
+ * Host test for the Profiler; SIGPROF stands in for SysTick here. Keeps the
+ * CPU busy for a second with the profiler running, and then checks that the
+ * log has the shape pv_profile.py expects, with a reasonable number of
+ * samples in it.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "profile.hpp"
+
+
+/* Constants. */
+
+#define TEST_LOG          "test_profile.log"
+#define TEST_BUSY_MS      1000
+#define TEST_SAMPLES_MIN  ( PROFILE_HZ * TEST_BUSY_MS / 1000 / 4 )
+
+
+/* Functions. */
+
+extern "C" void profile_anchor( void );
+
+
+/*
+ * busy; spins for the given number of milliseconds of CPU time, which is
+ *       what SIGPROF counts, draining the profiler as the main loop would.
+ */
+
+static void busy( Profiler *pProfiler, uint32_t pMillis )
+{
+  volatile uint32_t lSink = 0;
+  clock_t           lEnd = clock() + ( (clock_t)pMillis * CLOCKS_PER_SEC / 1000 );
+
+  while( clock() < lEnd )
+  {
+    for ( uint32_t lIndex = 0; lIndex < 10000; lIndex++ )
+    {
+      lSink = lSink + lIndex;
+    }
+    pProfiler->drain( PROFILE_DRAIN_MAX );
+  }
+}
+
+
+/*
+ * main; runs the profiler into a log, then reads it back.
+ */
+
+int main( void )
+{
+  Profiler  lProfiler;
+  FILE     *lLog;
+  char      lLine[128];
+  uint32_t  lLines = 0, lSamples = 0, lHz = 0;
+  uintptr_t lAnchor = 0, lPC, lLR;
+  bool      lStarted = false, lStopped = false, lRunning;
+  int       lStdout;
+
+  /* The profiler writes to stdout, so that goes to the log for now. */
+  fflush( stdout );
+  lStdout = dup( fileno( stdout ) );
+  if ( freopen( TEST_LOG, "w", stdout ) == nullptr )
+  {
+    fprintf( stderr, "FAIL: can't write %s\n", TEST_LOG );
+    return 1;
+  }
+  lProfiler.start();
+  lRunning = lProfiler.running();
+  busy( &lProfiler, TEST_BUSY_MS );
+  lProfiler.stop();
+  fflush( stdout );
+  dup2( lStdout, fileno( stdout ) );
+  close( lStdout );
+
+  if ( !lRunning || lProfiler.running() )
+  {
+    fprintf( stderr, "FAIL: running() didn't follow start() and stop()\n" );
+    return 1;
+  }
+
+  /* Every line must be one of the forms pv_profile.py understands. */
+  lLog = fopen( TEST_LOG, "r" );
+  if ( lLog == nullptr )
+  {
+    fprintf( stderr, "FAIL: can't read %s\n", TEST_LOG );
+    return 1;
+  }
+  while( fgets( lLine, sizeof( lLine ), lLog ) != nullptr )
+  {
+    lLines++;
+    if ( sscanf( lLine, "@prof start %" SCNu32 " %" SCNxPTR, &lHz, &lAnchor ) == 2 )
+    {
+      lStarted = ( lLines == 1 );
+    }
+    else if ( strcmp( lLine, "@prof stop\n" ) == 0 )
+    {
+      lStopped = true;
+    }
+    else if ( strncmp( lLine, "@prof dropped ", 14 ) == 0 )
+    {
+      continue;
+    }
+    else if ( sscanf( lLine, "@prof %" SCNxPTR " %" SCNxPTR, &lPC, &lLR ) == 2 )
+    {
+      lSamples++;
+    }
+    else
+    {
+      fprintf( stderr, "FAIL: unexpected line %" PRIu32 ": %s", lLines, lLine );
+      fclose( lLog );
+      return 1;
+    }
+  }
+  fclose( lLog );
+
+  if ( !lStarted || !lStopped )
+  {
+    fprintf( stderr, "FAIL: the log must start and stop\n" );
+    return 1;
+  }
+  if ( ( lHz != PROFILE_HZ ) || ( lAnchor != (uintptr_t)&profile_anchor ) )
+  {
+    fprintf( stderr, "FAIL: start line has %" PRIu32 " %" PRIxPTR "\n", lHz, lAnchor );
+    return 1;
+  }
+  if ( lSamples < TEST_SAMPLES_MIN )
+  {
+    fprintf( stderr, "FAIL: only %" PRIu32 " samples in %dms\n", lSamples, TEST_BUSY_MS );
+    return 1;
+  }
+
+  printf( "profile: %" PRIu32 " samples in %dms\n", lSamples, TEST_BUSY_MS );
+  return 0;
+}
+
+/* End of file test_profile.cpp */
@@ -0,0 +1,235 @@
+/*
+ * test_renderqueue.cpp - part of Arborescence
+ *
+ * Host test for the render queue's ring; a producer and a consumer thread
+ * stand in for the two cores, and the consumer just checks off the commands
+ * it's given rather than drawing them. Checks that everything arrives whole
+ * and in order, however many times the ring wraps, that a full ring stalls
+ * the producer until there's room, and that the stats add up.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+
+
+/* Constants. */
+
+#define TEST_COMMANDS   ( RENDER_QUEUE_SIZE * 20 )
+#define TEST_FRAME      100         /* Commands to a frame, ending in a flip. */
+#define TEST_PAUSE      std::chrono::milliseconds( 50 )
+
+
+/* Module variables. */
+
+static uint_fast8_t m_failures = 0;
+
+
+/* Functions. */
+
+
+/*
+ * check; notes a failure, if the condition doesn't hold.
+ */
+
+static void check( bool pCondition, const char *pWhat )
+{
+  if ( !pCondition )
+  {
+    fprintf( stderr, "FAIL: %s\n", pWhat );
+    m_failures++;
+  }
+}
+
+
+/*
+ * produce; queues a command carrying the given sequence number, in a way the
+ *          consumer can tell if it only sees part of it.
+ */
+
+static void produce( RenderRing *pRing, uint32_t pSequence, uint8_t pType )
+{
+  rcmd_t *lCommand = pRing->claim( pType );
+
+  lCommand->x1 = (int16_t)( pSequence & 0x7FFF );
+  lCommand->y1 = (int16_t)~lCommand->x1;
+  lCommand->data = (const void *)(uintptr_t)pSequence;
+  pRing->publish();
+}
+
+
+/*
+ * consume; executes the given number of commands, which is to say checks
+ *          that they carry the sequence numbers we expect. Returns how many
+ *          were out of order, or torn.
+ */
+
+static uint32_t consume( RenderRing *pRing, uint32_t pFirst, uint32_t pCount )
+{
+  const rcmd_t *lCommand;
+  uint32_t      lWrong = 0;
+
+  for ( uint32_t lSequence = pFirst; lSequence < pFirst + pCount; lSequence++ )
+  {
+    lCommand = pRing->peek();
+    if ( lCommand == nullptr )
+    {
+      lCommand = pRing->wait();
+    }
+    if ( ( (uintptr_t)lCommand->data != lSequence ) || ( lCommand->x1 != (int16_t)( lSequence & 0x7FFF ) ) ||
+         ( lCommand->y1 != (int16_t)~lCommand->x1 ) )
+    {
+      lWrong++;
+    }
+    pRing->release();
+  }
+  return lWrong;
+}
+
+
+/*
+ * test_order; streams commands through the ring many times over, with a flip
+ *             every so often, and checks they all come out in order.
+ */
+
+static void test_order( void )
+{
+  RenderRing  *lRing = new RenderRing();
+  rqstats_t    lStats;
+  uint32_t     lWrong = 0;
+
+  std::thread lConsumer( [&]() { lWrong = consume( lRing, 0, TEST_COMMANDS ); } );
+  for ( uint32_t lSequence = 0; lSequence < TEST_COMMANDS; lSequence++ )
+  {
+    produce( lRing, lSequence, ( lSequence % TEST_FRAME == TEST_FRAME - 1 ) ? RCMD_FLIP : RCMD_PIXEL );
+  }
+  lRing->wait_for_idle();
+  lConsumer.join();
+
+  check( lWrong == 0, "commands arrive whole, and in order, across wraparound" );
+  lRing->stats( &lStats, false );
+  check( lStats.commands == TEST_COMMANDS, "every command is counted" );
+  check( lStats.occupancy == 0, "an idle ring is empty" );
+  check( lStats.occupancy_peak <= RENDER_QUEUE_SIZE, "the ring never holds more than it can" );
+  check( lRing->frame() == TEST_COMMANDS / TEST_FRAME, "every flip is a frame" );
+  check( lRing->frame_done( lRing->frame() - 1 ), "and once they're released, they're done" );
+  check( !lRing->frame_done( lRing->frame() ), "but the one being queued isn't" );
+
+  delete lRing;
+}
+
+
+/*
+ * test_stall; fills the ring, and makes sure the producer waits for room.
+ */
+
+static void test_stall( void )
+{
+  RenderRing       *lRing = new RenderRing();
+  rqstats_t         lStats;
+  std::atomic<bool> lDraining( false );
+  uint32_t          lWrong = 0;
+
+  for ( uint32_t lSequence = 0; lSequence < RENDER_QUEUE_SIZE; lSequence++ )
+  {
+    produce( lRing, lSequence, RCMD_PIXEL );
+  }
+  lRing->stats( &lStats, false );
+  check( lStats.occupancy == RENDER_QUEUE_SIZE, "a full ring reports itself full" );
+  check( lStats.occupancy_peak == RENDER_QUEUE_SIZE, "and that's its peak" );
+  check( lStats.stalls == 0, "filling the ring doesn't stall" );
+
+  /* One more has to wait for the consumer. */
+  std::thread lConsumer( [&]() {
+    std::this_thread::sleep_for( TEST_PAUSE );
+    lDraining = true;
+    lWrong = consume( lRing, 0, RENDER_QUEUE_SIZE + 1 );
+  } );
+  produce( lRing, RENDER_QUEUE_SIZE, RCMD_PIXEL );
+  check( lDraining, "a full ring holds the producer until there's room" );
+  lConsumer.join();
+
+  check( lWrong == 0, "nothing is lost when the ring is full" );
+  lRing->stats( &lStats, true );
+  check( lStats.stalls == 1, "the stall is counted" );
+  check( lStats.occupancy == 0, "the ring is empty again" );
+  check( lStats.occupancy_peak == RENDER_QUEUE_SIZE, "but remembers its peak" );
+  lRing->stats( &lStats, false );
+  check( ( lStats.commands == 0 ) && ( lStats.stalls == 0 ) && ( lStats.occupancy_peak == 0 ),
+         "until the stats are reset" );
+
+  delete lRing;
+}
+
+
+/*
+ * test_starve; a consumer with nothing to do waits, and says so; and the
+ *              producer is only ever let a frame ahead.
+ */
+
+static void test_starve( void )
+{
+  RenderRing *lRing = new RenderRing();
+  rqstats_t   lStats;
+  uint32_t    lWrong = 0;
+
+  std::thread lConsumer( [&]() { lWrong = consume( lRing, 0, 1 ); } );
+  std::this_thread::sleep_for( TEST_PAUSE );
+  produce( lRing, 0, RCMD_PIXEL );
+  lConsumer.join();
+
+  check( lWrong == 0, "a waiting consumer gets its command" );
+  lRing->stats( &lStats, false );
+  check( lStats.starves == 1, "and the wait is counted" );
+
+  /* Two frames queued is one too many; the producer waits for the first. */
+  produce( lRing, 1, RCMD_FLIP );
+  produce( lRing, 2, RCMD_FLIP );
+  check( !lRing->frame_done( 0 ), "a queued flip isn't done" );
+  std::thread lFlipper( [&]() {
+    std::this_thread::sleep_for( TEST_PAUSE );
+    lWrong = consume( lRing, 1, 1 );
+  } );
+  lRing->wait_for_frame();
+  check( lRing->frame_done( 0 ), "the producer waits until only a frame is left" );
+  check( !lRing->frame_done( 1 ), "and no longer" );
+  lFlipper.join();
+  check( lWrong == 0, "the flip arrives" );
+
+  delete lRing;
+}
+
+
+/*
+ * main; runs each test in turn.
+ */
+
+int main( void )
+{
+  test_order();
+  test_stall();
+  test_starve();
+
+  if ( m_failures > 0 )
+  {
+    return 1;
+  }
+  printf( "renderqueue: all passed\n" );
+  return 0;
+}
+
+/* End of file test_renderqueue.cpp */
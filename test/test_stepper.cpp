@@ -0,0 +1,96 @@
+/*
+ * test_stepper.cpp - part of Arborescence
+ *
+ * Host test for the Stepper's software path; checks every step of a lot of
+ * random curves against the closed form of the same curve. There are no
+ * interpolators on a host, so whether they agree with the software can only
+ * be checked on the device, by Stepper::self_check as core 1 starts.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdio.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "stepper.hpp"
+
+
+/* Constants. */
+
+#define TEST_SEED       0x57e99e12
+#define TEST_CURVES     2000
+
+
+/* Functions. */
+
+
+/*
+ * closed_form; where a curve should be after a number of steps, worked out
+ *              directly rather than by adding up.
+ */
+
+static int32_t closed_form( int32_t pStart, int32_t pStep, int32_t pAccel, uint_fast8_t pShift, int64_t pSteps )
+{
+  int64_t lValue = pStart + pSteps * pStep + pSteps * ( pSteps - 1 ) / 2 * pAccel;
+
+  return (int32_t)( lValue >> pShift );
+}
+
+
+/*
+ * main; steps the curves, and checks each step.
+ */
+
+int main( void )
+{
+  Stepper       lStepper;
+  int32_t       lStart, lStep, lAccel, lValue;
+  uint_fast8_t  lShift;
+  uint32_t      lRandom = TEST_SEED;
+
+  for ( uint_fast16_t lCurve = 0; lCurve < TEST_CURVES; lCurve++ )
+  {
+    /* The same spread of curves that self_check uses. */
+    lShift = 2 + ( random_next( &lRandom ) % ( CURVE_SHIFT_MAX * 2 - 1 ) );
+    lStart = ( (int32_t)( random_next( &lRandom ) % FRAME_WIDTH ) - 40 ) * ( 1 << lShift ) + ( 1 << ( lShift - 1 ) );
+    lStep = (int32_t)( random_next( &lRandom ) % ( 1 << ( lShift + 1 ) ) ) - ( 1 << lShift );
+    lAccel = (int32_t)( random_next( &lRandom ) % 512 ) - 256;
+
+    lStepper.start( lStart, lStep, lAccel, lShift, 0, false );
+    for ( uint_fast16_t lIndex = 0; lIndex < ( 1 << CURVE_SHIFT_MAX ); lIndex++ )
+    {
+      if ( lStepper.step() != lStep + (int32_t)lIndex * lAccel )
+      {
+        fprintf( stderr, "FAIL: curve %d has the wrong step at %d\n", (int)lCurve, (int)lIndex );
+        return 1;
+      }
+      lValue = lStepper.next();
+      if ( lValue != closed_form( lStart, lStep, lAccel, lShift, lIndex ) )
+      {
+        fprintf( stderr, "FAIL: curve %d is at %d, not %d, after %d steps\n", (int)lCurve, (int)lValue,
+                 (int)closed_form( lStart, lStep, lAccel, lShift, lIndex ), (int)lIndex );
+        return 1;
+      }
+    }
+  }
+
+  /* With no interpolators, self_check compares the software with itself. */
+  if ( !Stepper::self_check( TEST_SEED, 16 ) )
+  {
+    fprintf( stderr, "FAIL: self_check disagrees with itself\n" );
+    return 1;
+  }
+
+  printf( "stepper: all passed\n" );
+  return 0;
+}
+
+/* End of file test_stepper.cpp */
@@ -0,0 +1,325 @@
+/*
+ * test_tier.cpp - part of Arborescence
+ *
+ * Host test for the CanopyTier; ordinary memory stands in for the PSRAM, and
+ * the render queue's ring is only used to count frames, with this thread
+ * flipping them and then drawing them. Walks a canopy out to PSRAM and back,
+ * checking it only moves on once the queue has got as far as it needs to,
+ * that the residency stats follow it, and that recall slots are only taken
+ * from trees that have gone undrawn for long enough.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+#include "offscreen.hpp"
+#include "tier.hpp"
+
+
+/* Constants. */
+
+#define TEST_WORDS      64
+#define TEST_BYTES      ( TEST_WORDS * 4 )
+#define TEST_VICTIM     5           /* The tree whose slot gets stolen. */
+
+
+/* Module variables. */
+
+static uint_fast8_t m_failures = 0;
+
+
+/* Functions. */
+
+
+/*
+ * check; notes a failure, if the condition doesn't hold.
+ */
+
+static void check( bool pCondition, const char *pWhat )
+{
+  if ( !pCondition )
+  {
+    fprintf( stderr, "FAIL: %s\n", pWhat );
+    m_failures++;
+  }
+}
+
+
+/*
+ * bake; makes up a canopy, the way a tree would; each word says whose it is,
+ *       and where, so it can be recognised when it comes back.
+ */
+
+static uint32_t *bake( uint32_t pTree )
+{
+  uint32_t *lCanopy = (uint32_t *)malloc( TEST_BYTES );
+
+  for ( uint32_t lWord = 0; lWord < TEST_WORDS; lWord++ )
+  {
+    lCanopy[lWord] = ( pTree << 16 ) | lWord;
+  }
+  return lCanopy;
+}
+
+
+/*
+ * intact; checks a canopy is the one baked for the given tree.
+ */
+
+static bool intact( const uint32_t *pCanopy, uint32_t pTree )
+{
+  if ( pCanopy == nullptr )
+  {
+    return false;
+  }
+  for ( uint32_t lWord = 0; lWord < TEST_WORDS; lWord++ )
+  {
+    if ( pCanopy[lWord] != ( ( pTree << 16 ) | lWord ) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/*
+ * flip; ends the frame being queued, without drawing it.
+ */
+
+static void flip( RenderRing *pRing )
+{
+  pRing->claim( RCMD_FLIP );
+  pRing->publish();
+}
+
+
+/*
+ * draw; lets the consumer catch up with everything queued.
+ */
+
+static void draw( RenderRing *pRing )
+{
+  while( pRing->peek() != nullptr )
+  {
+    pRing->release();
+  }
+}
+
+
+/*
+ * idle; settles a canopy, a frame at a time, for a number of frames; every
+ *       frame is drawn as soon as it's flipped.
+ */
+
+static void idle( CanopyTier *pTier, RenderRing *pRing, uint_fast16_t pFrames )
+{
+  for ( uint_fast16_t lFrame = 0; lFrame < pFrames; lFrame++ )
+  {
+    pTier->settle( false, false );
+    flip( pRing );
+    draw( pRing );
+  }
+}
+
+
+/*
+ * test_round_trip; walks a canopy all the way out, and back again.
+ */
+
+static void test_round_trip( void )
+{
+  OffscreenHeap     lHeap( nullptr );
+  RenderRing       *lRing = new RenderRing();
+  CanopyTier       *lTier = new CanopyTier( &lHeap, lRing );
+  tree_tier_stats_t lStats;
+
+  CanopyTier::stats( &lStats, true );
+  lTier->adopt( bake( 1 ), TEST_BYTES );
+  CanopyTier::stats( &lStats, false );
+  check( lStats.sram == TEST_BYTES, "a new canopy is in SRAM" );
+  check( lTier->baked() && intact( lTier->canopy(), 1 ), "and can be drawn from" );
+
+  /* A tree that's still growing, or dying, never moves out. */
+  for ( uint_fast16_t lFrame = 0; lFrame < TREE_TIER_IDLE * 2; lFrame++ )
+  {
+    lTier->settle( true, false );
+    lTier->settle( false, true );
+  }
+  check( lTier->tier() == TREE_TIER_RESIDENT, "growing and dying trees keep their canopy" );
+
+  /* Otherwise, it goes out once it's been idle long enough. */
+  lTier->drawn();
+  idle( lTier, lRing, TREE_TIER_IDLE - 1 );
+  check( lTier->tier() == TREE_TIER_RESIDENT, "a canopy stays while it's being drawn" );
+  idle( lTier, lRing, 1 );
+  CanopyTier::stats( &lStats, false );
+  check( lTier->tier() == TREE_TIER_WRITING, "and goes out once it isn't" );
+  check( ( lStats.psram == TEST_BYTES ) && ( lStats.written == TEST_BYTES ), "to one bank" );
+
+  /* The second bank's write has to be drawn before the SRAM copy can go. */
+  lTier->settle( false, false );
+  CanopyTier::stats( &lStats, false );
+  check( lStats.written == TEST_BYTES * 2, "then to the other" );
+  lTier->settle( false, false );
+  lTier->settle( false, false );
+  check( lTier->tier() == TREE_TIER_WRITING, "and it waits for that to be drawn" );
+  flip( lRing );
+  lTier->settle( false, false );
+  check( lTier->tier() == TREE_TIER_WRITING, "not just queued" );
+  draw( lRing );
+  lTier->settle( false, false );
+  check( lTier->tier() == TREE_TIER_CLEAN, "before it's clean" );
+  check( intact( lTier->canopy(), 1 ), "still drawn from SRAM" );
+
+  lTier->settle( false, false );
+  CanopyTier::stats( &lStats, false );
+  check( lTier->tier() == TREE_TIER_STORED, "a clean canopy leaves SRAM" );
+  check( lTier->canopy() == nullptr, "and can't be drawn from" );
+  check( ( lStats.trees == 1 ) && ( lStats.sram == 0 ) && ( lStats.psram == TEST_BYTES ) &&
+         ( lStats.evictions == 1 ), "it's counted as only in PSRAM" );
+
+  /* Coming back, it's not there until the read has been drawn. */
+  check( lTier->recall(), "a stored canopy can be recalled" );
+  CanopyTier::stats( &lStats, false );
+  check( ( lStats.trees == 0 ) && ( lStats.sram == TEST_BYTES ) && ( lStats.recalls == 1 ) &&
+         ( lStats.read == TEST_BYTES ), "the recall is counted" );
+  lTier->settle( false, false );
+  check( ( lTier->tier() == TREE_TIER_RECALLING ) && ( lTier->canopy() == nullptr ), "it waits for the read" );
+  flip( lRing );
+  draw( lRing );
+  lTier->settle( false, false );
+  check( lTier->tier() == TREE_TIER_RECALLED, "and lands once it's drawn" );
+  check( intact( lTier->canopy(), 1 ), "exactly as it went out" );
+
+  /* Going idle again just gives the slot up; PSRAM already has it. */
+  idle( lTier, lRing, TREE_TIER_IDLE );
+  CanopyTier::stats( &lStats, false );
+  check( lTier->tier() == TREE_TIER_STORED, "a recalled canopy goes again when idle" );
+  check( ( lStats.written == TEST_BYTES * 2 ) && ( lStats.evictions == 2 ) && ( lStats.trees == 1 ) &&
+         ( lStats.sram == 0 ), "without being written again" );
+
+  /* Being drawn before it's been asked for is late. */
+  lTier->drawn();
+  CanopyTier::stats( &lStats, false );
+  check( ( lStats.late == 1 ) && ( lStats.recalls == 2 ), "drawing a stored canopy is late, and recalls it" );
+  check( lStats.failures == 0, "there was always room" );
+
+  delete lTier;
+  CanopyTier::stats( &lStats, false );
+  check( ( lStats.trees == 0 ) && ( lStats.sram == 0 ) && ( lStats.psram == 0 ), "dropping it leaves nothing behind" );
+  delete lRing;
+}
+
+
+/*
+ * test_steal; with every recall slot taken, one is only handed over once its
+ *             tree has gone TREE_RECALL_STEAL frames undrawn, and then it's
+ *             the one that's gone longest.
+ */
+
+static void test_steal( void )
+{
+  OffscreenHeap     lHeap( nullptr );
+  RenderRing       *lRing = new RenderRing();
+  CanopyTier       *lTiers[TREE_RECALL_SLOTS+1];
+  tree_tier_stats_t lStats;
+
+  /* Walk every canopy out; each is idle for as long as it takes to go. */
+  for ( uint_fast8_t lTree = 0; lTree <= TREE_RECALL_SLOTS; lTree++ )
+  {
+    lTiers[lTree] = new CanopyTier( &lHeap, lRing );
+    lTiers[lTree]->adopt( bake( lTree ), TEST_BYTES );
+    idle( lTiers[lTree], lRing, TREE_TIER_IDLE + 3 );
+    check( lTiers[lTree]->tier() == TREE_TIER_STORED, "every canopy goes out" );
+  }
+  CanopyTier::stats( &lStats, true );
+  check( lStats.trees == TREE_RECALL_SLOTS + 1, "and is counted" );
+
+  /* Fill every slot. */
+  for ( uint_fast8_t lTree = 0; lTree < TREE_RECALL_SLOTS; lTree++ )
+  {
+    check( lTiers[lTree]->recall(), "there's a slot for everyone in view" );
+  }
+  check( !lTiers[TREE_RECALL_SLOTS]->recall(), "but no more" );
+  CanopyTier::stats( &lStats, false );
+  check( lStats.failures == 1, "which is counted" );
+
+  /* After a frame undrawn, they're still too fresh to take over. */
+  flip( lRing );
+  draw( lRing );
+  for ( uint_fast8_t lTree = 0; lTree < TREE_RECALL_SLOTS; lTree++ )
+  {
+    lTiers[lTree]->settle( false, false );
+    check( intact( lTiers[lTree]->canopy(), lTree ), "each lands in its own slot" );
+  }
+  check( !lTiers[TREE_RECALL_SLOTS]->recall(), "a slot isn't taken a frame after it's used" );
+
+  /* After another, only the one that wasn't drawn again is up for grabs. */
+  for ( uint_fast8_t lTree = 0; lTree < TREE_RECALL_SLOTS; lTree++ )
+  {
+    lTiers[lTree]->settle( false, false );
+    if ( lTree != TEST_VICTIM )
+    {
+      lTiers[lTree]->drawn();
+    }
+  }
+  check( lTiers[TREE_RECALL_SLOTS]->recall(), "a slot is taken once it's gone unused long enough" );
+  check( lTiers[TEST_VICTIM]->tier() == TREE_TIER_STORED, "from the tree that went longest" );
+  check( lTiers[TEST_VICTIM]->canopy() == nullptr, "which goes back to PSRAM" );
+  for ( uint_fast8_t lTree = 0; lTree < TREE_RECALL_SLOTS; lTree++ )
+  {
+    if ( lTree != TEST_VICTIM )
+    {
+      check( intact( lTiers[lTree]->canopy(), lTree ), "and nobody else's" );
+    }
+  }
+  flip( lRing );
+  draw( lRing );
+  lTiers[TREE_RECALL_SLOTS]->settle( false, false );
+  check( intact( lTiers[TREE_RECALL_SLOTS]->canopy(), TREE_RECALL_SLOTS ), "the new canopy lands in it" );
+
+  CanopyTier::stats( &lStats, false );
+  check( ( lStats.trees == 1 ) && ( lStats.sram == TEST_BYTES * TREE_RECALL_SLOTS ) &&
+         ( lStats.recalls == TREE_RECALL_SLOTS + 1 ), "the stats follow the slot" );
+
+  for ( uint_fast8_t lTree = 0; lTree <= TREE_RECALL_SLOTS; lTree++ )
+  {
+    delete lTiers[lTree];
+  }
+  CanopyTier::stats( &lStats, false );
+  check( ( lStats.trees == 0 ) && ( lStats.sram == 0 ) && ( lStats.psram == 0 ), "and come back to nothing" );
+  delete lRing;
+}
+
+
+/*
+ * main; runs each test in turn.
+ */
+
+int main( void )
+{
+  test_round_trip();
+  test_steal();
+
+  if ( m_failures > 0 )
+  {
+    return 1;
+  }
+  printf( "tier: all passed\n" );
+  return 0;
+}
+
+/* End of file test_tier.cpp */
@@ -0,0 +1,381 @@
+/*
+ * tier.cpp - part of Arborescence
+ *
+ * Implements the CanopyTier class. A baked canopy starts out RESIDENT, in
+ * SRAM; once its tree has gone a while without being drawn, it's WRITING
+ * out to PSRAM, and then CLEAN once the queue has got that far. If the tree
+ * stays idle, the SRAM copy goes and it's STORED. Being about to be drawn
+ * again starts it RECALLING into a slot from a fixed pool, and it's RECALLED
+ * once the queue has read it back; going idle again just gives the slot up.
+ *
+ * Nothing here ever waits for the queue; the frame count says how far it's
+ * got, and the canopy just isn't there to be drawn from until it's arrived.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+#include <stdlib.h>
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+#include "offscreen.hpp"
+#include "tier.hpp"
+
+
+/* Module variables. */
+
+static uint16_t    m_tier_trees = 0;
+static uint32_t    m_tier_sram = 0;
+static uint32_t    m_tier_psram = 0;
+static uint32_t    m_tier_evictions = 0;
+static uint32_t    m_tier_recalls = 0;
+static uint32_t    m_tier_written = 0;
+static uint32_t    m_tier_read = 0;
+static uint32_t    m_tier_failures = 0;
+static uint32_t    m_tier_late = 0;
+static uint32_t    m_recall_pool[TREE_RECALL_SLOTS][TREE_RECALL_WORDS];
+static CanopyTier *m_recall_owner[TREE_RECALL_SLOTS];
+
+
+/* Functions. */
+
+
+/*
+ * constructor; takes the offscreen heap to move the canopy out to (which can
+ *              be nullptr, to keep it in SRAM), and the ring whose frames say
+ *              how far the queue has got with moving it. There's no canopy
+ *              until one is adopted.
+ */
+
+CanopyTier::CanopyTier( OffscreenHeap *pOffscreen, RenderRing *pFrames )
+{
+  /* Save the references we're given. */
+  this->mOffscreen = pOffscreen;
+  this->mFrames = pFrames;
+
+  /* And start with nothing to look after. */
+  this->mCanopy = nullptr;
+  this->mSize = 0;
+  this->mStored = OFFSCREEN_NONE;
+  this->mSlot = TREE_RECALL_NONE;
+  this->mTier = TREE_TIER_RESIDENT;
+  this->mStep = 0;
+  this->mFrame = 0;
+  this->mIdle = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * destructor; throws the canopy away, wherever it is.
+ */
+
+CanopyTier::~CanopyTier( void )
+{
+  this->drop();
+  return;
+}
+
+
+/*
+ * adopt; takes over a freshly baked canopy, which must have come from malloc
+ *        and be a whole number of words long. It starts off in SRAM.
+ */
+
+void CanopyTier::adopt( uint32_t *pCanopy, uint16_t pSize )
+{
+  this->mCanopy = pCanopy;
+  this->mSize = pSize;
+  m_tier_sram += pSize;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * drop; throws the canopy away, wherever it's being kept. If it's still on
+ *       its way out, the queue hasn't finished reading it yet; that's only
+ *       ever a frame or two's worth, so we wait.
+ */
+
+void CanopyTier::drop( void )
+{
+  if ( this->mTier == TREE_TIER_WRITING )
+  {
+    this->mFrames->wait_for_idle();
+  }
+  if ( this->mSlot != TREE_RECALL_NONE )
+  {
+    this->release();
+  }
+  if ( this->mCanopy != nullptr )
+  {
+    free( this->mCanopy );
+    this->mCanopy = nullptr;
+    m_tier_sram -= this->mSize;
+  }
+  if ( this->mStored != OFFSCREEN_NONE )
+  {
+    this->mOffscreen->free( this->mStored );
+    this->mStored = OFFSCREEN_NONE;
+    m_tier_psram -= this->mSize;
+  }
+  if ( this->mTier == TREE_TIER_STORED )
+  {
+    m_tier_trees--;
+  }
+  this->mTier = TREE_TIER_RESIDENT;
+}
+
+
+/*
+ * settle; called every frame, to move the canopy out to PSRAM once its tree
+ *         has gone a while without being drawn. It's written once for each
+ *         bank, and only let go of in SRAM once the queue has drawn the frame
+ *         holding the second write; after that, the PSRAM copy stays put, so
+ *         going again after a recall costs nothing. Growing and dying trees
+ *         stay as they are.
+ */
+
+void CanopyTier::settle( bool pGrowing, bool pDying )
+{
+  if ( this->mIdle < TREE_TIER_IDLE )
+  {
+    this->mIdle++;
+  }
+
+  switch( this->mTier )
+  {
+    case TREE_TIER_RESIDENT:
+      if ( ( this->mOffscreen == nullptr ) || ( this->mCanopy == nullptr ) || ( pGrowing ) || ( pDying ) ||
+           ( this->mIdle < TREE_TIER_IDLE ) || ( this->mSize > TREE_RECALL_WORDS * 4 ) )
+      {
+        break;
+      }
+
+      /* No room for us is no great loss; we'll try again once we've been idle as long again. */
+      this->mStored = this->mOffscreen->alloc( this->mSize, OFFSCREEN_PINNED, nullptr, nullptr );
+      if ( this->mStored == OFFSCREEN_NONE )
+      {
+        m_tier_failures++;
+        this->mIdle = 0;
+        break;
+      }
+      m_tier_psram += this->mSize;
+      this->mOffscreen->write( this->mStored, 0, this->mCanopy, this->mSize / 4 );
+      m_tier_written += this->mSize;
+      this->mTier = TREE_TIER_WRITING;
+      this->mStep = 0;
+      break;
+
+    case TREE_TIER_WRITING:
+      /* The other bank gets its copy on the very next frame. */
+      if ( this->mStep == 0 )
+      {
+        this->mOffscreen->write( this->mStored, 0, this->mCanopy, this->mSize / 4 );
+        m_tier_written += this->mSize;
+        this->mStep = 1;
+        this->mFrame = this->mFrames->frame();
+      }
+      else if ( this->mFrames->frame_done( this->mFrame ) )
+      {
+        this->mTier = TREE_TIER_CLEAN;
+      }
+      break;
+
+    case TREE_TIER_CLEAN:
+      if ( ( this->mIdle < TREE_TIER_IDLE ) || ( pDying ) )
+      {
+        break;
+      }
+      free( this->mCanopy );
+      this->mCanopy = nullptr;
+      m_tier_sram -= this->mSize;
+      m_tier_trees++;
+      m_tier_evictions++;
+      this->mTier = TREE_TIER_STORED;
+      break;
+
+    case TREE_TIER_RECALLING:
+      /* Nothing to draw from until the queue has got as far as the read. */
+      if ( this->mFrames->frame_done( this->mFrame ) )
+      {
+        this->mCanopy = m_recall_pool[this->mSlot];
+        this->mTier = TREE_TIER_RECALLED;
+      }
+      break;
+
+    case TREE_TIER_RECALLED:
+      /* The PSRAM copy never went anywhere, so there's nothing to write. */
+      if ( ( this->mIdle < TREE_TIER_IDLE ) || ( pDying ) )
+      {
+        break;
+      }
+      this->release();
+      m_tier_evictions++;
+      break;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * recall; asks for the canopy back from PSRAM, if that's where it is, because
+ *         its tree is about to be drawn. It goes into a free recall slot, or
+ *         failing that the one whose tree has gone longest without being
+ *         drawn. This only queues the read; the canopy isn't there until the
+ *         frame holding it has been drawn, and until then (or if there's no
+ *         slot to be had) the tree is drawn leaf by leaf instead, the slow
+ *         way. Returns true if a read was queued.
+ */
+
+bool CanopyTier::recall( void )
+{
+  int_fast8_t lSlot = TREE_RECALL_NONE;
+
+  /* About to be drawn counts as being drawn, as far as going idle goes. */
+  this->mIdle = 0;
+  if ( this->mTier != TREE_TIER_STORED )
+  {
+    return false;
+  }
+  for ( int_fast8_t lIndex = 0; lIndex < TREE_RECALL_SLOTS; lIndex++ )
+  {
+    if ( m_recall_owner[lIndex] == nullptr )
+    {
+      lSlot = lIndex;
+      break;
+    }
+    if ( ( m_recall_owner[lIndex]->mIdle >= TREE_RECALL_STEAL ) &&
+         ( ( lSlot == TREE_RECALL_NONE ) || ( m_recall_owner[lIndex]->mIdle > m_recall_owner[lSlot]->mIdle ) ) )
+    {
+      lSlot = lIndex;
+    }
+  }
+  if ( lSlot == TREE_RECALL_NONE )
+  {
+    m_tier_failures++;
+    return false;
+  }
+  if ( m_recall_owner[lSlot] != nullptr )
+  {
+    m_recall_owner[lSlot]->release();
+  }
+
+  m_recall_owner[lSlot] = this;
+  this->mSlot = lSlot;
+  this->mOffscreen->fetch( this->mStored, 0, m_recall_pool[lSlot], this->mSize / 4 );
+  this->mFrame = this->mFrames->frame();
+  m_tier_sram += this->mSize;
+  m_tier_read += this->mSize;
+  m_tier_trees--;
+  m_tier_recalls++;
+  this->mTier = TREE_TIER_RECALLING;
+  return true;
+}
+
+
+/*
+ * release; gives up our recall slot, leaving the canopy only in PSRAM again.
+ */
+
+void CanopyTier::release( void )
+{
+  m_recall_owner[this->mSlot] = nullptr;
+  this->mSlot = TREE_RECALL_NONE;
+  this->mCanopy = nullptr;
+  m_tier_sram -= this->mSize;
+  m_tier_trees++;
+  this->mTier = TREE_TIER_STORED;
+}
+
+
+/*
+ * drawn; called as the tree is drawn, which keeps the canopy close at hand.
+ *        If it's not back yet, the tree wasn't expected to be drawn; that's
+ *        counted as late, and it's recalled now.
+ */
+
+void CanopyTier::drawn( void )
+{
+  this->mIdle = 0;
+  if ( ( this->mTier == TREE_TIER_STORED ) || ( this->mTier == TREE_TIER_RECALLING ) )
+  {
+    m_tier_late++;
+    this->recall();
+  }
+}
+
+
+/*
+ * canopy; returns the canopy to draw from, or nullptr if there isn't one in
+ *         SRAM right now.
+ */
+
+const uint32_t *CanopyTier::canopy( void )
+{
+  return this->mCanopy;
+}
+
+
+/*
+ * baked; reports whether a canopy has ever been adopted, even if it's since
+ *        been thrown away.
+ */
+
+bool CanopyTier::baked( void )
+{
+  return this->mSize > 0;
+}
+
+
+/*
+ * tier; returns where the canopy is, as a TREE_TIER_ value.
+ */
+
+uint_fast8_t CanopyTier::tier( void )
+{
+  return this->mTier;
+}
+
+
+/*
+ * stats; reports how many trees have their canopy only in PSRAM, how many
+ *        bytes of canopy are held in each, and how much has moved between
+ *        them (and how often) since the last reset, along with how often
+ *        there wasn't room, or a canopy wasn't back in time. Optionally
+ *        resets the counts.
+ */
+
+void CanopyTier::stats( tree_tier_stats_t *pStats, bool pReset )
+{
+  pStats->trees = m_tier_trees;
+  pStats->sram = m_tier_sram;
+  pStats->psram = m_tier_psram;
+  pStats->evictions = m_tier_evictions;
+  pStats->recalls = m_tier_recalls;
+  pStats->written = m_tier_written;
+  pStats->read = m_tier_read;
+  pStats->failures = m_tier_failures;
+  pStats->late = m_tier_late;
+
+  if ( pReset )
+  {
+    m_tier_evictions = m_tier_recalls = m_tier_written = m_tier_read = m_tier_failures = m_tier_late = 0;
+  }
+}
+
+/* End of file tier.cpp */
@@ -0,0 +1,87 @@
+/*
+ * tier.hpp - part of Arborescence
+ *
+ * This header declares the CanopyTier class; it looks after a finished tree's
+ * baked canopy, moving it out to PSRAM while the tree isn't being drawn, and
+ * back into a fixed pool of recall slots when it's about to be. It only needs
+ * the offscreen heap and the ring's frame count, so it can be run on a host.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "arborescence.hpp"
+#include "ring.hpp"
+#include "offscreen.hpp"
+
+
+/* Constants. */
+
+/* A finished tree that isn't being drawn keeps its baked canopy in PSRAM instead. */
+#define TREE_TIER_IDLE      120     /* Frames without being drawn, before it moves out. */
+#define TREE_TIER_RESIDENT  0       /* Only in SRAM. */
+#define TREE_TIER_WRITING   1       /* On its way out. */
+#define TREE_TIER_CLEAN     2       /* In both, so it can go without writing it again. */
+#define TREE_TIER_STORED    3       /* Only in PSRAM. */
+#define TREE_TIER_RECALLING 4       /* On its way back, into a recall slot. */
+#define TREE_TIER_RECALLED  5       /* Back again, in a recall slot, until it goes idle. */
+
+/* Canopies brought back from PSRAM go in a fixed set of slots, rather than on the heap. */
+#define TREE_RECALL_SLOTS   16      /* Every tree in view, and then some. */
+#define TREE_RECALL_WORDS   ( FOREST_PATTERNS ? 128 : 768 )     /* Bigger canopies just stay in SRAM. */
+#define TREE_RECALL_STEAL   2       /* Frames undrawn before a slot can go to another tree. */
+#define TREE_RECALL_NONE    -1
+
+
+/* Structures. */
+
+typedef struct
+{
+  uint16_t        trees;          /* With their canopy only in PSRAM. */
+  uint32_t        sram;           /* Bytes of baked canopy in SRAM... */
+  uint32_t        psram;          /* ...and in PSRAM. */
+  uint32_t        evictions;      /* Since the last reset. */
+  uint32_t        recalls;
+  uint32_t        written, read;  /* In bytes. */
+  uint32_t        failures;       /* For want of space, in either. */
+  uint32_t        late;           /* Drawn the slow way, because the canopy wasn't back yet. */
+} tree_tier_stats_t;
+
+
+/* Class declaration. */
+
+class CanopyTier
+{
+private:
+  OffscreenHeap                        *mOffscreen;
+  RenderRing                           *mFrames;
+  uint32_t                             *mCanopy;
+  uint16_t                              mSize;          /* Stays set once baked, wherever the canopy goes. */
+  int_fast8_t                           mStored, mSlot;
+  uint_fast8_t                          mTier, mStep;
+  uint32_t                              mFrame;         /* Queued as part of this frame. */
+  uint_fast16_t                         mIdle;
+
+  void            release( void );
+
+public:
+                  CanopyTier( OffscreenHeap *, RenderRing * );
+                 ~CanopyTier( void );
+
+  void            adopt( uint32_t *, uint16_t );
+  void            drop( void );
+  void            settle( bool, bool );
+  bool            recall( void );
+  void            drawn( void );
+  const uint32_t *canopy( void );
+  bool            baked( void );
+  uint_fast8_t    tier( void );
+
+  static void     stats( tree_tier_stats_t *, bool );
+};
+
+/* End of file tier.hpp */
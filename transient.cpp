@@ -0,0 +1,95 @@
+/*
+ * transient.cpp - part of Arborescence
+ *
+ * Implements the TransientLog class. An effect records each pixel it draws
+ * (in world coordinates) against its slot; the next time the same buffer is
+ * drawn, erase hands that list back so the owner can restore those pixels,
+ * before the effect draws itself somewhere new.
+ *
+ * Each buffer has its own lists, swapped over in World::update along with
+ * everything else, and every list has a fixed size; so the cost of erasing
+ * is bounded, however many effects are running. An effect which runs out of
+ * room simply isn't drawn any further that frame.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+/* System header files. */
+
+
+/* Local header files. */
+
+#include "pico/stdlib.h"
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+#include "transient.hpp"
+
+
+/* Functions. */
+
+
+/*
+ * constructor; nothing has been drawn in either buffer yet.
+ */
+
+TransientLog::TransientLog( void )
+{
+  this->mBuffer = 0;
+  for ( uint_fast8_t lSlot = 0; lSlot < TRANSIENT_SLOTS; lSlot++ )
+  {
+    this->mSlots[0][lSlot].count = this->mSlots[1][lSlot].count = 0;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * record; notes that the effect in the given slot has drawn a pixel into the
+ *         current buffer. If there's no room left, we return false and the
+ *         pixel must not be drawn.
+ */
+
+bool TransientLog::record( uint_fast8_t pSlot, const pimoroni::Point &pPixel )
+{
+  transient_t *lSlot = &this->mSlots[this->mBuffer][pSlot];
+
+  if ( lSlot->count >= TRANSIENT_PIXELS )
+  {
+    return false;
+  }
+  lSlot->pixels[lSlot->count++] = pPixel;
+  return true;
+}
+
+
+/*
+ * erase; returns the pixels that the effect in the given slot drew the last
+ *        time this buffer was drawn, and forgets them; the caller is expected
+ *        to restore them before drawing anything new.
+ */
+
+uint_fast8_t TransientLog::erase( uint_fast8_t pSlot, const pimoroni::Point **pPixels )
+{
+  transient_t  *lSlot = &this->mSlots[this->mBuffer][pSlot];
+  uint_fast8_t  lCount = lSlot->count;
+
+  *pPixels = lSlot->pixels;
+  lSlot->count = 0;
+  return lCount;
+}
+
+
+/*
+ * swap; moves on to the other buffer, once a frame.
+ */
+
+void TransientLog::swap( void )
+{
+  this->mBuffer ^= 1;
+}
+
+/* End of file transient.cpp */
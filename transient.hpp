@@ -0,0 +1,51 @@
+/*
+ * transient.hpp - part of Arborescence
+ *
+ * This header declares the TransientLog class; a record of the pixels which
+ * short lived effects (like shooting stars) have drawn into each buffer, so
+ * that they can be put back exactly as they were, rather than repainting the
+ * sky around them.
+ *
+ * Copyright (c) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * This file is licensed under the BSD 3-Clause License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "libraries/pico_graphics/pico_graphics_dv.hpp"
+
+#include "arborescence.hpp"
+
+
+/* Constants. */
+
+#define TRANSIENT_SLOTS     4       /* One per effect that can be running at once. */
+#define TRANSIENT_PIXELS    16      /* And the most any one of them can draw. */
+
+
+/* Structures. */
+
+typedef struct
+{
+  pimoroni::Point pixels[TRANSIENT_PIXELS];
+  uint8_t         count;
+} transient_t;
+
+
+/* Class declaration. */
+
+class TransientLog
+{
+private:
+  transient_t                           mSlots[2][TRANSIENT_SLOTS];
+  uint_fast8_t                          mBuffer;
+
+public:
+                  TransientLog( void );
+
+  bool            record( uint_fast8_t, const pimoroni::Point & );
+  uint_fast8_t    erase( uint_fast8_t, const pimoroni::Point ** );
+  void            swap( void );
+};
+
+/* End of file transient.hpp */
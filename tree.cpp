@@ -16,41 +16,104 @@
 
 /* Local header files. */
 
-#include "pico/rand.h"
 #include "libraries/pico_graphics/pico_graphics_dv.hpp"
 
 #include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
+#include "tier.hpp"
 #include "tree.hpp"
 
 
+/* Module variables. */
+
+static uint32_t m_canopy_disc_pixels = 0;
+static uint32_t m_canopy_span_pixels = 0;
+static uint32_t m_canopy_dropped = 0;
+static uint32_t m_light_redirected = 0;
+static uint32_t m_light_shortened = 0;
+static uint32_t m_light_suppressed = 0;
+
+
 /* Functions. */
 
 
 /*
- * constructor; generates a random origin, and the initial (single) branch.
+ * isqrt; a simple integer square root, for working out leaf shapes.
  */
 
-Tree::Tree( pimoroni::PicoGraphics_PenDV_RGB555 *pGraphics )
+static int32_t isqrt( int32_t pValue )
 {
-  /* Save the references we're given. */
-  this->mGraphics = pGraphics;
+  int32_t lRoot = 0;
+
+  while( ( lRoot + 1 ) * ( lRoot + 1 ) <= pValue )
+  {
+    lRoot++;
+  }
+  return lRoot;
+}
+
 
-  /* So, the tree always originates on the ground, obviously. */
-  this->mOrigin.y = SCREEN_HEIGHT - ( GROUND_HEIGHT / 2 ) - ( get_rand_32() % GROUND_HEIGHT );
-  this->mOrigin.x = 1 + ( get_rand_32() % (SCREEN_WIDTH-2) );
+/*
+ * constructor; takes the origin (on the ground, obviously) and a seed which
+ *              decides everything else, and generates the initial (single)
+ *              branch. The same seed will always grow the same tree. Every
+ *              branch is recorded in the spatial index, for drawing. If we're
+ *              given a pattern library, the outer branches come from that; and
+ *              if we're given an offscreen heap, our baked canopy can be moved
+ *              out to it while we're not being drawn.
+ */
+
+Tree::Tree( RenderQueue *pQueue, SpatialIndex *pIndex, PatternLibrary *pPatterns, OffscreenHeap *pOffscreen,
+            pimoroni::Point pOrigin, uint32_t pSeed )
+{
+  /* Save the references we're given. */
+  this->mQueue = pQueue;
+  this->mIndex = pIndex;
+  this->mPatterns = pPatterns;
+  this->mOrigin = pOrigin;
+  this->mRandom = pSeed ? pSeed : 1;
 
   /* The trunk should be pretty much vertical. */
   this->mTrunk.end_point.x = this->mOrigin.x;
-  this->mTrunk.end_point.y = this->mOrigin.y - (SCREEN_HEIGHT/6) - ( get_rand_32() %(SCREEN_HEIGHT/8) );
+  this->mTrunk.end_point.y = this->mOrigin.y - (SCREEN_HEIGHT/6) - ( random_next( &this->mRandom ) %(SCREEN_HEIGHT/8) );
 
   /* And for now, without any branches. */
   for ( uint_fast8_t lIndex = 0; lIndex < BRANCHES_MAX; lIndex++ )
   {
     this->mTrunk.branches[lIndex] = nullptr;
+    this->mRefs[lIndex].pattern = PATTERN_NONE;
   }
+  this->mCanopy = new CanopyTier( pOffscreen, pQueue->ring() );
+
+  /* We don't have any leaves to crowd anyone else with, yet. */
+  for ( uint_fast8_t lWord = 0; lWord < TREE_LIGHT_WORDS; lWord++ )
+  {
+    this->mFootprint[lWord] = 0;
+  }
+  this->mLightBase = SpatialIndex::light_column( this->mOrigin.x - TREE_LIGHT_REACH );
   this->mHeight = 1;
   this->mAge = 1;
 
+  /* Even the trunk grows up out of the ground. */
+  this->mGrowLevel = 1;
+  this->mGrowStep = 0;
+
+  /* And is a long way from dying. */
+  this->mFade = 0;
+  this->mDecay = TREE_DECAY_NONE;
+  this->mBare = false;
+
+  /* Keep track of the area we cover, so we can be culled when off screen. */
+  this->mLeft = this->mOrigin.x - 20;
+  this->mRight = this->mOrigin.x + 20;
+  this->mTop = this->mOrigin.y;
+  this->widen( this->mTrunk.end_point );
+
+  /* And tell the index where the trunk is. */
+  this->mIndex->insert( this, this->mOrigin, this->mTrunk.end_point, 1, 0 );
+
   /* All done. */
   return;
 }
@@ -62,7 +125,24 @@ Tree::Tree( pimoroni::PicoGraphics_PenDV_RGB555 *pGraphics )
 
 Tree::~Tree( void )
 {
+  uint_fast16_t lBit;
+
+  /* Give our light back to the neighbours. */
+  for ( int_fast16_t lColumn = 0; lColumn < TREE_LIGHT_COLUMNS; lColumn++ )
+  {
+    for ( int_fast16_t lRow = 0; lRow < SPATIAL_LIGHT_ROWS; lRow++ )
+    {
+      if ( ( this->footprint( this->mLightBase + lColumn, lRow, &lBit ) ) &&
+           ( this->mFootprint[lBit / 32] & ( 1u << ( lBit % 32 ) ) ) )
+      {
+        this->mIndex->light_remove( this->mLightBase + lColumn, lRow );
+      }
+    }
+  }
+
+  this->mIndex->remove( this );
   free_branch( &this->mTrunk );
+  delete this->mCanopy;
   return;
 }
 
@@ -88,10 +168,34 @@ void Tree::free_branch( branch_t *pBranch )
 
 void Tree::update( void )
 {
-  /* Firstly, keep track of our age... */
-  this->mAge++;
+  /* Firstly, keep track of our age; once past dying, there's no need to count. */
+  if ( this->mAge <= AGE_DEATH )
+  {
+    this->mAge++;
+  }
+  this->mDecay = TREE_DECAY_NONE;
 
-  /* Deal with ageing and death. */
+  /* Deal with ageing and death; the leaves turn first, then the branches fall, outermost first. */
+  if ( this->mAge > AGE_DEATH )
+  {
+    if ( this->mFade < DEATH_FADE_STEPS )
+    {
+      this->mFade++;
+      this->mDecay = TREE_DECAY_FADE;
+      this->mDecayArea = this->bounds();
+    }
+    else if ( this->mIndex->remove_outermost( this, &this->mDecayArea ) )
+    {
+      /* The baked canopy is no use once the branches holding it start to go. */
+      this->mCanopy->drop();
+      this->mDecay = TREE_DECAY_SHED;
+    }
+    else
+    {
+      this->mBare = true;
+    }
+    return;
+  }
 
   /* And growth, if it seems to be the right time. */
   if ( (this->mAge < AGE_GROWTH ) && ( this->mAge % 4 == 0 ) )
@@ -100,18 +204,167 @@ void Tree::update( void )
     this->grow_branch( &this->mTrunk, 1 );
   }
 
+  /* Once it's stopped growing, its shape never changes again; so bake it, just the once. */
+  if ( ( this->mAge >= AGE_GROWTH ) && ( !this->mCanopy->baked() ) )
+  {
+    this->bake();
+  }
+
   return;
 }
 
 
+/*
+ * animate; moves the latest growth on by a number of frames; called every
+ *          frame, so that new branches extend smoothly out of their parents.
+ */
+
+void Tree::animate( uint_fast8_t pFrames )
+{
+  this->mGrowStep = ( this->mGrowStep + pFrames < GROWTH_FRAMES ) ? this->mGrowStep + pFrames : GROWTH_FRAMES;
+}
+
+
+/*
+ * is_growing; tells us if the latest growth still has frames to draw, in
+ *             either buffer.
+ */
+
+bool Tree::is_growing( void )
+{
+  return this->mGrowStep < GROWTH_FRAMES;
+}
+
+
+/*
+ * growth; works out how far grown a level is, at a given step of the latest
+ *         growth; everything older than that is fully grown.
+ */
+
+uint_fast8_t Tree::growth( uint_fast8_t pLevel, uint_fast8_t pStep )
+{
+  if ( ( pLevel != this->mGrowLevel ) || ( pStep > GROWTH_STEPS ) )
+  {
+    return GROWTH_STEPS;
+  }
+  return pStep;
+}
+
+
+/*
+ * control; works out the control point that bends a branch. It's pushed out
+ *          sideways from the middle of the branch, by an amount hashed from
+ *          where the branch is, so it's the same every time it's drawn.
+ */
+
+pimoroni::Point Tree::control( const primitive_t *pPrimitive )
+{
+  int32_t lBend = (int32_t)( random_hash(
+    ( (uint32_t)pPrimitive->start.x << 16 ) ^ (uint32_t)pPrimitive->start.y,
+    ( (uint32_t)pPrimitive->end.x << 16 ) ^ (uint32_t)pPrimitive->end.y
+  ) % ( BRANCH_BEND_MAX * 2 + 1 ) ) - BRANCH_BEND_MAX;
+
+  return pimoroni::Point(
+    ( pPrimitive->start.x + pPrimitive->end.x ) / 2 - ( pPrimitive->end.y - pPrimitive->start.y ) * lBend / 64,
+    ( pPrimitive->start.y + pPrimitive->end.y ) / 2 + ( pPrimitive->end.x - pPrimitive->start.x ) * lBend / 64
+  );
+}
+
+
+/*
+ * growth_curve; works out the piece of a growing branch's curve between two
+ *               steps of its growth, in frame coordinates. A piece of a
+ *               quadratic curve is itself a quadratic curve, so it can be
+ *               drawn in the same way as a whole branch.
+ */
+
+void Tree::growth_curve( const primitive_t *pPrimitive, uint_fast8_t pFrom, uint_fast8_t pTo, int32_t pOffset,
+                         pimoroni::Point *pStart, pimoroni::Point *pControl, pimoroni::Point *pEnd )
+{
+  const int32_t   lSteps = GROWTH_LINE_STEPS, lScale = GROWTH_LINE_STEPS * GROWTH_LINE_STEPS;
+  int32_t         lFrom = pFrom < GROWTH_LINE_STEPS ? pFrom : GROWTH_LINE_STEPS;
+  int32_t         lTo = pTo < GROWTH_LINE_STEPS ? pTo : GROWTH_LINE_STEPS;
+  pimoroni::Point lControl = Tree::control( pPrimitive );
+  pimoroni::Point lLeg1 = lControl - pPrimitive->start, lLeg2 = pPrimitive->end - lControl;
+
+  /* Most of the time, it's the whole branch; which is just where it is. */
+  if ( ( lFrom == 0 ) && ( lTo == lSteps ) )
+  {
+    *pStart = pimoroni::Point( pPrimitive->start.x - pOffset, pPrimitive->start.y );
+    *pControl = pimoroni::Point( lControl.x - pOffset, lControl.y );
+    *pEnd = pimoroni::Point( pPrimitive->end.x - pOffset, pPrimitive->end.y );
+    return;
+  }
+
+  /* Points on the curve are P0 + 2t(C - P0) + t^2(P2 - 2C + P0), with t = step / steps. */
+  *pStart = pimoroni::Point(
+    pPrimitive->start.x + ( 2 * lFrom * lSteps * lLeg1.x + lFrom * lFrom * ( lLeg2.x - lLeg1.x ) ) / lScale - pOffset,
+    pPrimitive->start.y + ( 2 * lFrom * lSteps * lLeg1.y + lFrom * lFrom * ( lLeg2.y - lLeg1.y ) ) / lScale
+  );
+  *pEnd = pimoroni::Point(
+    pPrimitive->start.x + ( 2 * lTo * lSteps * lLeg1.x + lTo * lTo * ( lLeg2.x - lLeg1.x ) ) / lScale - pOffset,
+    pPrimitive->start.y + ( 2 * lTo * lSteps * lLeg1.y + lTo * lTo * ( lLeg2.y - lLeg1.y ) ) / lScale
+  );
+
+  /* And the piece's control point lies along the tangent at its start. */
+  *pControl = pimoroni::Point(
+    pStart->x + ( lTo - lFrom ) * ( ( lSteps - lFrom ) * lLeg1.x + lFrom * lLeg2.x ) / lScale,
+    pStart->y + ( lTo - lFrom ) * ( ( lSteps - lFrom ) * lLeg1.y + lFrom * lLeg2.y ) / lScale
+  );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * leaf_radius; the size of the leaves on a fully grown branch, by level.
+ */
+
+int32_t Tree::leaf_radius( uint_fast8_t pLevel )
+{
+  return 20 - ( pLevel * 3 );
+}
+
+
+/*
+ * thickness; the thickness of the branches at each level, or zero for a plain
+ *            line. This is set by how tall the tree will grow, rather than how
+ *            tall it is, so that growing doesn't mean redrawing older branches.
+ */
+
+uint8_t Tree::thickness( uint_fast8_t pLevel )
+{
+  return pLevel < BRANCH_LEVELS_THICK ? ( BRANCH_LEVELS_THICK - pLevel ) * 2 : 0;
+}
+
+
+/*
+ * set_leaf_pen; sets the pen for the leaves at a given level, which shifts a
+ *               little with the time of day.
+ */
+
+void Tree::set_leaf_pen( uint_fast8_t pLevel, uint_fast16_t pTimeOfDay )
+{
+  int32_t lGreen = 95+(pLevel*3)+(sin(pTimeOfDay*3.14159f/1800.0f)*20);
+
+  /* Dying leaves turn towards the colour of the bark. */
+  this->mQueue->set_pen( 68 + ( 92 - 68 ) * this->mFade / DEATH_FADE_STEPS,
+                         lGreen + ( 64 - lGreen ) * this->mFade / DEATH_FADE_STEPS,
+                         21 + ( 51 - 21 ) * this->mFade / DEATH_FADE_STEPS );
+}
+
+
 /*
  * grow_branch; either adds sub-branches to a virgin branch, or recurses into
- *              the sub-branches that are already there.
+ *              the sub-branches that are already there. Once we reach the
+ *              level patterns grow from, they take over.
  */
 
 void Tree::grow_branch( branch_t *pBranch, uint_fast8_t pHeight )
 {
   bool lFoundBranch = false;
+  bool lPatterned = ( this->mPatterns != nullptr ) && ( pHeight + 1 == PATTERN_ROOT_LEVEL );
 
   /* Work through any branches we have. */
   for ( uint_fast8_t lIndex = 0; lIndex < BRANCHES_MAX; lIndex++ )
@@ -121,8 +374,15 @@ void Tree::grow_branch( branch_t *pBranch, uint_fast8_t pHeight )
       /* Remember we found it. */
       lFoundBranch = true;
 
-      /* Then grow it. */
-      this->grow_branch( pBranch->branches[lIndex], pHeight+1 );
+      /* Then grow it, or the pattern on the end of it. */
+      if ( lPatterned )
+      {
+        this->grow_pattern( lIndex );
+      }
+      else
+      {
+        this->grow_branch( pBranch->branches[lIndex], pHeight+1 );
+      }
     }
   }
 
@@ -133,7 +393,30 @@ void Tree::grow_branch( branch_t *pBranch, uint_fast8_t pHeight )
     pBranch->branches[0]->end_point.x -= ( 60 / pHeight );
     pBranch->branches[1] = alloc_branch( pBranch->end_point, pHeight );
     pBranch->branches[1]->end_point.x += ( 30 / pHeight );
-//    if ( get_rand_32()%2 == 0 )
+
+    /* Widen our bounds to cover the new branches, and index them; unless they'd be in deep shade. */
+    for ( uint_fast8_t lIndex = 0; lIndex < 2; lIndex++ )
+    {
+      if ( !this->find_light( pBranch->end_point, &pBranch->branches[lIndex]->end_point ) )
+      {
+        free( pBranch->branches[lIndex] );
+        pBranch->branches[lIndex] = nullptr;
+        continue;
+      }
+      this->widen( pBranch->branches[lIndex]->end_point );
+      this->mIndex->insert( this, pBranch->end_point, pBranch->branches[lIndex]->end_point, pHeight+1, 0 );
+      this->occupy( pBranch->branches[lIndex]->end_point );
+
+      /* Pick the pattern that will grow from here, and which way round. */
+      if ( lPatterned )
+      {
+        this->mRoots[lIndex] = pBranch->branches[lIndex]->end_point;
+        this->mRefs[lIndex].pattern = random_next( &this->mRandom ) % PATTERN_COUNT;
+        this->mRefs[lIndex].mirror = random_next( &this->mRandom ) & 1;
+        this->mRefs[lIndex].depth = 0;
+      }
+    }
+//    if ( random_next( &this->mRandom )%2 == 0 )
 //    {
 //      pBranch->branches[2] = alloc_branch( pBranch->end_point, pHeight );
 //    }
@@ -142,13 +425,330 @@ void Tree::grow_branch( branch_t *pBranch, uint_fast8_t pHeight )
     {
       this->mHeight = pHeight;
     }
+
+    /* And they grow out over the next few frames. */
+    this->mGrowLevel = pHeight + 1;
+    this->mGrowStep = 0;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * grow_pattern; reveals the next depth of the pattern growing from one of the
+ *               trunk's branches. Nothing is stored for the new branches except
+ *               their entries in the spatial index, which are grouped by the
+ *               branch the pattern grows from.
+ */
+
+void Tree::grow_pattern( uint_fast8_t pSlot )
+{
+  pattern_ref_t  *lRef = &this->mRefs[pSlot];
+  pimoroni::Point lRoot = this->mRoots[pSlot];
+  pimoroni::Point lStart, lEnd;
+  uint_fast8_t    lShaded = 0, lCount;
+
+  /* Patterns only go so deep. */
+  if ( lRef->depth >= PATTERN_DEPTH )
+  {
+    return;
+  }
+
+  /*
+   * The leaves of a whole depth are merged together, so it grows all at once
+   * or not at all; if most of it would be in the shade, it waits.
+   */
+  lCount = PatternLibrary::first_branch( lRef->depth + 1 ) - PatternLibrary::first_branch( lRef->depth );
+  for ( uint_fast8_t lIndex = PatternLibrary::first_branch( lRef->depth );
+        lIndex < PatternLibrary::first_branch( lRef->depth + 1 ); lIndex++ )
+  {
+    this->mPatterns->branch( lRef, lIndex, &lStart, &lEnd );
+    lShaded += this->shaded( lRoot + lEnd ) ? 1 : 0;
+  }
+  if ( lShaded * 2 > lCount )
+  {
+    m_light_suppressed += lCount;
+    return;
+  }
+
+  for ( uint_fast8_t lIndex = PatternLibrary::first_branch( lRef->depth );
+        lIndex < PatternLibrary::first_branch( lRef->depth + 1 ); lIndex++ )
+  {
+    this->mPatterns->branch( lRef, lIndex, &lStart, &lEnd );
+    this->widen( lRoot + lEnd );
+    this->mIndex->insert( this, lRoot + lStart, lRoot + lEnd,
+                          PATTERN_ROOT_LEVEL + lRef->depth + 1, pSlot + 1 );
+    this->occupy( lRoot + lEnd );
+  }
+
+  /* Keep the height in step, as though we'd grown them ourselves. */
+  if ( PATTERN_ROOT_LEVEL + lRef->depth > this->mHeight )
+  {
+    this->mHeight = PATTERN_ROOT_LEVEL + lRef->depth;
+  }
+  lRef->depth++;
+
+  /* And they grow out over the next few frames. */
+  this->mGrowLevel = PATTERN_ROOT_LEVEL + lRef->depth;
+  this->mGrowStep = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * gather_leaves; collects the ends of all our own branches at one level,
+ *                relative to our origin; these are where the leaves are.
+ */
+
+void Tree::gather_leaves( const branch_t *pBranch, uint_fast8_t pLevel, uint_fast8_t pTarget,
+                          pimoroni::Point *pLeaves, uint_fast8_t *pCount )
+{
+  if ( pLevel == pTarget )
+  {
+    if ( *pCount < CANOPY_LEAVES_MAX )
+    {
+      pLeaves[(*pCount)++] = pBranch->end_point - this->mOrigin;
+    }
+    return;
+  }
+
+  for ( uint_fast8_t lIndex = 0; lIndex < BRANCHES_MAX; lIndex++ )
+  {
+    if ( pBranch->branches[lIndex] != nullptr )
+    {
+      this->gather_leaves( pBranch->branches[lIndex], pLevel + 1, pTarget, pLeaves, pCount );
+    }
+  }
+}
+
+
+/*
+ * bake; called once the tree has finished growing. The leaves of each level
+ *       of our own branches are merged into spans once and for all (patterns
+ *       have already had theirs done by the library), and then the branches
+ *       themselves can go; the spatial index has everything needed to draw
+ *       them, and the pattern roots are kept separately. If there isn't the
+ *       memory, we just stay as we are and try again next time.
+ */
+
+void Tree::bake( void )
+{
+  pimoroni::Point lLeaves[CANOPY_LEAVES_MAX];
+  uint_fast8_t    lCount;
+  uint_fast16_t   lSpans[TREE_LEVELS_MAX], lTotal = 0;
+  uint32_t        lDiscPixels;
+  canopy_span_t  *lScratch;
+  tree_baked_t   *lBaked;
+  uint32_t        lSize;
+
+  /* First, find out how many spans each level merges into. */
+  lScratch = (canopy_span_t *)malloc( sizeof( canopy_span_t ) * CANOPY_SPANS_MAX );
+  if ( lScratch == nullptr )
+  {
+    return;
+  }
+  for ( uint_fast8_t lLevel = 0; lLevel < TREE_LEVELS_MAX; lLevel++ )
+  {
+    lCount = 0;
+    if ( lLevel >= 2 )
+    {
+      this->gather_leaves( &this->mTrunk, 1, lLevel, lLeaves, &lCount );
+    }
+    lSpans[lLevel] = lCount == 0 ? 0 :
+      Tree::build_canopy( lLeaves, lCount, Tree::leaf_radius( lLevel ), lScratch, CANOPY_SPANS_MAX, &lDiscPixels );
+    lTotal += lSpans[lLevel];
   }
+  free( lScratch );
+
+  /* Then they all go in one block, straight after the header; whole words, to suit PSRAM. */
+  lSize = ( sizeof( tree_baked_t ) + sizeof( canopy_span_t ) * lTotal + 3 ) & ~3;
+  lBaked = (tree_baked_t *)malloc( lSize );
+  if ( lBaked == nullptr )
+  {
+    return;
+  }
+  lTotal = 0;
+  for ( uint_fast8_t lLevel = 0; lLevel < TREE_LEVELS_MAX; lLevel++ )
+  {
+    lBaked->first[lLevel] = lTotal;
+    lBaked->disc[lLevel] = 0;
+    if ( lSpans[lLevel] > 0 )
+    {
+      lCount = 0;
+      this->gather_leaves( &this->mTrunk, 1, lLevel, lLeaves, &lCount );
+      lTotal += Tree::build_canopy( lLeaves, lCount, Tree::leaf_radius( lLevel ),
+                                    (canopy_span_t *)( lBaked + 1 ) + lTotal, lSpans[lLevel], &lDiscPixels );
+      lBaked->disc[lLevel] = lDiscPixels / lCount;
+    }
+  }
+  lBaked->first[TREE_LEVELS_MAX] = lTotal;
+  this->mCanopy->adopt( (uint32_t *)lBaked, lSize );
+
+  /* Nothing will grow from the branches again, so they can go. */
+  this->free_branch( &this->mTrunk );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * settle; called every frame, so that our baked canopy can move out to PSRAM
+ *         once we've gone a while without being drawn; growing and dying
+ *         trees keep theirs where it is.
+ */
+
+void Tree::settle( void )
+{
+  this->mCanopy->settle( this->is_growing(), this->mAge >= AGE_DEATH );
 
   /* All done. */
   return;
 }
 
 
+/*
+ * recall; asks for our baked canopy back from PSRAM, if that's where it is,
+ *         because we're about to be drawn. Until it's back, we're drawn leaf
+ *         by leaf instead. Returns true if it's on its way.
+ */
+
+bool Tree::recall( void )
+{
+  return this->mCanopy->recall();
+}
+
+
+/*
+ * widen; extends the bounds of the tree to cover a new branch end, and the
+ *        leaves that grow around it.
+ */
+
+void Tree::widen( const pimoroni::Point &pEnd )
+{
+  if ( pEnd.x - 20 < this->mLeft )
+  {
+    this->mLeft = pEnd.x - 20;
+  }
+  if ( pEnd.x + 20 > this->mRight )
+  {
+    this->mRight = pEnd.x + 20;
+  }
+  if ( pEnd.y - 20 < this->mTop )
+  {
+    this->mTop = pEnd.y - 20;
+  }
+}
+
+
+/*
+ * footprint; works out which bit of our footprint covers a light cell, if
+ *            it's close enough to us to be counted at all.
+ */
+
+bool Tree::footprint( int_fast16_t pColumn, int_fast16_t pRow, uint_fast16_t *pBit )
+{
+  if ( ( pColumn < this->mLightBase ) || ( pColumn >= this->mLightBase + TREE_LIGHT_COLUMNS ) ||
+       ( pRow < 0 ) || ( pRow >= SPATIAL_LIGHT_ROWS ) )
+  {
+    return false;
+  }
+  *pBit = ( pColumn - this->mLightBase ) * SPATIAL_LIGHT_ROWS + pRow;
+  return true;
+}
+
+
+/*
+ * others; returns how many trees other than us have leaves in a light cell.
+ */
+
+uint_fast8_t Tree::others( int_fast16_t pColumn, int_fast16_t pRow )
+{
+  uint_fast8_t  lCount = this->mIndex->light( pColumn, pRow );
+  uint_fast16_t lBit;
+
+  if ( ( lCount > 0 ) && ( this->footprint( pColumn, pRow, &lBit ) ) &&
+       ( this->mFootprint[lBit / 32] & ( 1u << ( lBit % 32 ) ) ) )
+  {
+    lCount--;
+  }
+  return lCount;
+}
+
+
+/*
+ * shaded; decides if a leaf at the given world position would be in too much
+ *         shade; the light comes from above, so the cell above counts too.
+ */
+
+bool Tree::shaded( const pimoroni::Point &pLeaf )
+{
+  int_fast16_t lColumn = SpatialIndex::light_column( pLeaf.x );
+  int_fast16_t lRow = SpatialIndex::light_row( pLeaf.y );
+
+  return this->others( lColumn, lRow ) + this->others( lColumn, lRow - 1 ) >= TREE_SHADE_LIMIT;
+}
+
+
+/*
+ * find_light; checks that a new branch, growing from the given base, doesn't
+ *             end in the shade. If it does, it tries leaning the other way,
+ *             and then not reaching so far, and moves the end to suit. Returns
+ *             false if there's no light to be had; the branch shouldn't grow.
+ */
+
+bool Tree::find_light( const pimoroni::Point &pBase, pimoroni::Point *pEnd )
+{
+  pimoroni::Point lReach = *pEnd - pBase;
+
+  if ( !this->shaded( *pEnd ) )
+  {
+    return true;
+  }
+
+  *pEnd = pimoroni::Point( pBase.x - lReach.x, pEnd->y );
+  if ( !this->shaded( *pEnd ) )
+  {
+    m_light_redirected++;
+    return true;
+  }
+
+  *pEnd = pimoroni::Point( pBase.x + lReach.x / 2, pBase.y + lReach.y / 2 );
+  if ( !this->shaded( *pEnd ) )
+  {
+    m_light_shortened++;
+    return true;
+  }
+
+  m_light_suppressed++;
+  return false;
+}
+
+
+/*
+ * occupy; notes that we have leaves at the given world position, counting
+ *         us in that light cell if we weren't already.
+ */
+
+void Tree::occupy( const pimoroni::Point &pLeaf )
+{
+  int_fast16_t  lColumn = SpatialIndex::light_column( pLeaf.x );
+  int_fast16_t  lRow = SpatialIndex::light_row( pLeaf.y );
+  uint_fast16_t lBit;
+
+  if ( ( this->footprint( lColumn, lRow, &lBit ) ) &&
+       ( ( this->mFootprint[lBit / 32] & ( 1u << ( lBit % 32 ) ) ) == 0 ) )
+  {
+    this->mFootprint[lBit / 32] |= 1u << ( lBit % 32 );
+    this->mIndex->light_add( lColumn, lRow );
+  }
+}
+
+
 /*
  * alloc_branch; creates a new branch, based on the provided origin and
  *               current tree height.
@@ -165,9 +765,9 @@ branch_t *Tree::alloc_branch( pimoroni::Point pOrigin, uint_fast8_t pHeight )
   }
 
   /* Set the end-point to something ... suitable. */
-  lNewBranch->end_point.x = pOrigin.x + get_rand_32() % ( 60 / pHeight );
+  lNewBranch->end_point.x = pOrigin.x + random_next( &this->mRandom ) % ( 60 / pHeight );
   lNewBranch->end_point.y = pOrigin.y - ( SCREEN_HEIGHT / 16 ) / pHeight - 
-                            get_rand_32() % ( ( SCREEN_HEIGHT / 4 ) / pHeight );
+                            random_next( &this->mRandom ) % ( ( SCREEN_HEIGHT / 4 ) / pHeight );
 
   /* And return the new branch. */
   return lNewBranch;
@@ -175,53 +775,187 @@ branch_t *Tree::alloc_branch( pimoroni::Point pOrigin, uint_fast8_t pHeight )
 
 
 /*
- * render; draws the tree onto the current buffer. As we're only ever drawing
- *         over previous growth, we don't need to clear anything. This is only
- *         called when we're sure something needs drawing.
+ * render; draws some of the tree's branches onto the current buffer, as found
+ *         in the spatial index; they must be sorted by level. As we're only
+ *         ever drawing over previous growth, we don't need to clear anything.
+ *         The offset is the world column at the left hand edge of the frame,
+ *         and the span buffer is scratch space for merging leaves into.
+ *
+ *         We work a level at a time; the branches of each level are drawn,
+ *         and then their leaves are merged into a single canopy, so that no
+ *         pixel is written more than once per level.
  */
 
-void Tree::render( uint_fast16_t pTimeOfDay )
+void Tree::render( const primitive_t **pPrimitives, uint_fast16_t pCount,
+                   uint_fast16_t pTimeOfDay, int32_t pOffset,
+                   canopy_span_t *pSpans, uint_fast16_t pMaxSpans )
 {
-  /* Fairly simple this; we just draw lines until we run out... */
-  this->render_branch( &this->mTrunk, &this->mOrigin, pTimeOfDay, 1 );
+  pimoroni::Point lLeaves[CANOPY_LEAVES_MAX];
+  pimoroni::Point lLow, lHigh;
+  uint_fast8_t    lLeafCount, lBakedCount, lLevel, lGroups, lStep;
+  int32_t         lRadius;
+  uint_fast16_t   lIndex = 0;
+
+  /* Being drawn at all keeps our canopy close at hand; if it's not back yet, we weren't expected. */
+  this->mCanopy->drawn();
+
+  while( lIndex < pCount )
+  {
+    /* Draw all the branches at this level, gathering up their leaves. */
+    lLevel = pPrimitives[lIndex]->level;
+    lStep = this->growth( lLevel, this->mGrowStep );
+    lLeafCount = lBakedCount = 0;
+    lGroups = 0;
+    this->mQueue->set_pen( 92, 64, 51 );
+    for ( ; ( lIndex < pCount ) && ( pPrimitives[lIndex]->level == lLevel ); lIndex++ )
+    {
+      /* Translate the world positions into frame positions. */
+      pimoroni::Point lStart, lControl, lEnd;
+      this->growth_curve( pPrimitives[lIndex], 0, lStep, pOffset, &lStart, &lControl, &lEnd );
+
+      /* Branches curve a little; the thickness depends on the level. */
+      this->mQueue->curve( lStart, lControl, lEnd, Tree::thickness( lLevel ) );
+
+      /* Remember where the leaves go; fully grown patterns already know, until they start shedding. */
+      if ( ( pPrimitives[lIndex]->group > 0 ) && ( lStep == GROWTH_STEPS ) && ( this->mFade < DEATH_FADE_STEPS ) )
+      {
+        lGroups |= 1 << ( pPrimitives[lIndex]->group - 1 );
+      }
+      else if ( ( this->mCanopy->canopy() != nullptr ) && ( lStep == GROWTH_STEPS ) && ( this->mFade < DEATH_FADE_STEPS ) )
+      {
+        /* As does our own baked canopy; we only need to know which part of it we're drawing. */
+        if ( lBakedCount++ == 0 )
+        {
+          lLow = lHigh = lEnd;
+        }
+        lLow = pimoroni::Point( lEnd.x < lLow.x ? lEnd.x : lLow.x, lEnd.y < lLow.y ? lEnd.y : lLow.y );
+        lHigh = pimoroni::Point( lEnd.x > lHigh.x ? lEnd.x : lHigh.x, lEnd.y > lHigh.y ? lEnd.y : lHigh.y );
+      }
+      else if ( lLeafCount < CANOPY_LEAVES_MAX )
+      {
+        lLeaves[lLeafCount++] = lEnd;
+      }
+    }
+
+    /* And then the leaves, which all share a colour at each level; growing ones are smaller. */
+    lRadius = lStep > GROWTH_LINE_STEPS ?
+              Tree::leaf_radius( lLevel ) * ( lStep - GROWTH_LINE_STEPS ) / GROWTH_LEAF_STEPS : 0;
+    if ( ( lLevel >= 2 ) && ( lRadius > 0 ) && ( ( lLeafCount > 0 ) || ( lGroups != 0 ) || ( lBakedCount > 0 ) ) )
+    {
+      this->set_leaf_pen( lLevel, pTimeOfDay );
+      if ( lLeafCount > 0 )
+      {
+        this->render_canopy( lLeaves, lLeafCount, lRadius, pSpans, pMaxSpans );
+      }
+      if ( lBakedCount > 0 )
+      {
+        this->render_baked_canopy( lLevel, lBakedCount, pOffset,
+                                   pimoroni::Rect( lLow.x - lRadius, lLow.y - lRadius,
+                                                   lHigh.x - lLow.x + lRadius * 2 + 1,
+                                                   lHigh.y - lLow.y + lRadius * 2 + 1 ) );
+      }
+      for ( uint_fast8_t lSlot = 0; lSlot < BRANCHES_MAX; lSlot++ )
+      {
+        if ( lGroups & ( 1 << lSlot ) )
+        {
+          this->render_pattern_canopy( lSlot, lLevel - PATTERN_ROOT_LEVEL - 1, pOffset );
+        }
+      }
+    }
+  }
 
   /* All done. */
   return;
 }
 
+
 /*
- * render_branch; draws an individual branch; called recursively.
+ * render_growth; draws just what the latest growth has added since this
+ *                buffer was last drawn, two frames ago; the newly covered
+ *                piece of each growing branch, or the new ring around each
+ *                growing leaf. Primitives belonging to anything else are
+ *                ignored.
  */
 
-void Tree::render_branch( const branch_t *pBranch, const pimoroni::Point *pOrigin,
-                          uint_fast16_t pTimeOfDay, uint_fast8_t pHeight )
+void Tree::render_growth( const primitive_t **pPrimitives, uint_fast16_t pCount,
+                          uint_fast16_t pTimeOfDay, int32_t pOffset )
 {
-  /* Fairly simple then - draw a line from the origin to the endpoint. */
-  this->mGraphics->set_pen( 92, 64, 51 );
+  uint_fast8_t lFrom, lTo;
+  int32_t      lInner, lOuter;
 
-  /* The thickness of the branch depends on the height. */
-  if ( ( this->mHeight < 2 ) || ( pHeight > ( this->mHeight - 1 ) ) )
+  /* Work out what's new, in this buffer. */
+  lTo = this->growth( this->mGrowLevel, this->mGrowStep );
+  lFrom = this->growth( this->mGrowLevel, this->mGrowStep > 2 ? this->mGrowStep - 2 : 0 );
+  if ( lFrom == lTo )
   {
-    this->mGraphics->line( *pOrigin, pBranch->end_point );
+    return;
   }
-  else
+
+  /* The branches extend first... */
+  if ( lFrom < GROWTH_LINE_STEPS )
   {
-    this->mGraphics->thick_line( *pOrigin, pBranch->end_point, ( this->mHeight - pHeight ) * 2 );
+    this->mQueue->set_pen( 92, 64, 51 );
+    for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+    {
+      if ( ( pPrimitives[lIndex]->owner != this ) || ( pPrimitives[lIndex]->level != this->mGrowLevel ) )
+      {
+        continue;
+      }
+      pimoroni::Point lStart, lControl, lEnd;
+      this->growth_curve( pPrimitives[lIndex], lFrom, lTo, pOffset, &lStart, &lControl, &lEnd );
+      this->mQueue->curve( lStart, lControl, lEnd, Tree::thickness( this->mGrowLevel ) );
+    }
   }
 
-  /* If we're not at the bottom of the tree, add some leaves. */
-  if ( pHeight >= 2 )
+  /* ...and then the leaves open out around their ends. */
+  lInner = lFrom > GROWTH_LINE_STEPS ?
+           Tree::leaf_radius( this->mGrowLevel ) * ( lFrom - GROWTH_LINE_STEPS ) / GROWTH_LEAF_STEPS : 0;
+  lOuter = lTo > GROWTH_LINE_STEPS ?
+           Tree::leaf_radius( this->mGrowLevel ) * ( lTo - GROWTH_LINE_STEPS ) / GROWTH_LEAF_STEPS : 0;
+  if ( ( this->mGrowLevel >= 2 ) && ( lOuter > lInner ) )
   {
-    this->mGraphics->set_pen( 68, 95+(pHeight*3)+(sin(pTimeOfDay*3.14159f/1800.0f)*20), 21 );
-    this->mGraphics->circle( pBranch->end_point, 20 - (pHeight*3) );
+    this->set_leaf_pen( this->mGrowLevel, pTimeOfDay );
+    for ( uint_fast16_t lIndex = 0; lIndex < pCount; lIndex++ )
+    {
+      if ( ( pPrimitives[lIndex]->owner == this ) && ( pPrimitives[lIndex]->level == this->mGrowLevel ) )
+      {
+        this->render_ring(
+          pimoroni::Point( pPrimitives[lIndex]->end.x - pOffset, pPrimitives[lIndex]->end.y ), lInner, lOuter
+        );
+      }
+    }
   }
 
-  /* And then recurse on ourselves for any deeper branches. */
-  for ( uint_fast8_t lIndex = 0; lIndex < BRANCHES_MAX; lIndex++ )
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_ring; fills the ring between two leaf sizes, a row at a time; with
+ *              no inner size, that's the whole leaf. Leaves are the same shape
+ *              as the ones the canopy is built from.
+ */
+
+void Tree::render_ring( const pimoroni::Point &pCentre, int32_t pInner, int32_t pOuter )
+{
+  int32_t lOuterWidth, lInnerWidth;
+
+  for ( int32_t lDistance = -pOuter; lDistance <= pOuter; lDistance++ )
   {
-    if ( pBranch->branches[lIndex] != nullptr )
+    lOuterWidth = isqrt( pOuter * pOuter + pOuter - lDistance * lDistance );
+    if ( ( pInner <= 0 ) || ( abs( lDistance ) > pInner ) )
+    {
+      this->mQueue->pixel_span( pimoroni::Point( pCentre.x - lOuterWidth, pCentre.y + lDistance ), lOuterWidth * 2 + 1 );
+      continue;
+    }
+
+    /* Otherwise, just the two ends of the row outside the inner leaf. */
+    lInnerWidth = isqrt( pInner * pInner + pInner - lDistance * lDistance );
+    if ( lOuterWidth > lInnerWidth )
     {
-      this->render_branch( pBranch->branches[lIndex], &pBranch->end_point, pTimeOfDay, pHeight+1 );
+      this->mQueue->pixel_span( pimoroni::Point( pCentre.x - lOuterWidth, pCentre.y + lDistance ), lOuterWidth - lInnerWidth );
+      this->mQueue->pixel_span( pimoroni::Point( pCentre.x + lInnerWidth + 1, pCentre.y + lDistance ), lOuterWidth - lInnerWidth );
     }
   }
 
@@ -230,13 +964,319 @@ void Tree::render_branch( const branch_t *pBranch, const pimoroni::Point *pOrigi
 }
 
 
+/*
+ * build_canopy; merges a set of equally sized leaf discs into a single shape,
+ *               as a union of spans on each scanline. Overlapping leaves are
+ *               very common, so this saves a lot of pixel writes compared to
+ *               drawing each disc on its own. Returns the number of spans,
+ *               and how many pixels the discs would have covered.
+ */
+
+uint_fast16_t Tree::build_canopy( const pimoroni::Point *pLeaves, uint_fast8_t pCount, int32_t pRadius,
+                                  canopy_span_t *pSpans, uint_fast16_t pMax, uint32_t *pDiscPixels )
+{
+  int32_t lWidths[LEAF_RADIUS_MAX+1];
+  int32_t lStarts[CANOPY_LEAVES_MAX], lEnds[CANOPY_LEAVES_MAX];
+  int32_t lTop, lBottom, lDistance, lStart, lEnd;
+  uint_fast8_t lSpans, lIndex, lSort;
+  uint_fast16_t lCount = 0;
+
+  /* Work out the half-width of a leaf at each distance from its centre. */
+  for ( lDistance = 0; lDistance <= pRadius; lDistance++ )
+  {
+    lWidths[lDistance] = isqrt( pRadius * pRadius + pRadius - lDistance * lDistance );
+  }
+
+  /* Find the rows the canopy covers. */
+  *pDiscPixels = 0;
+  lTop = lBottom = pLeaves[0].y;
+  for ( lIndex = 1; lIndex < pCount; lIndex++ )
+  {
+    if ( pLeaves[lIndex].y < lTop )
+    {
+      lTop = pLeaves[lIndex].y;
+    }
+    if ( pLeaves[lIndex].y > lBottom )
+    {
+      lBottom = pLeaves[lIndex].y;
+    }
+  }
+
+  /* Now work through them, a row at a time. */
+  for ( int32_t lRow = lTop - pRadius; lRow <= lBottom + pRadius; lRow++ )
+  {
+    /* Gather up the spans of every leaf on this row, sorted by their start. */
+    lSpans = 0;
+    for ( lIndex = 0; lIndex < pCount; lIndex++ )
+    {
+      lDistance = abs( lRow - pLeaves[lIndex].y );
+      if ( lDistance > pRadius )
+      {
+        continue;
+      }
+      lStart = pLeaves[lIndex].x - lWidths[lDistance];
+      lEnd = pLeaves[lIndex].x + lWidths[lDistance];
+      *pDiscPixels += lEnd - lStart + 1;
+
+      for ( lSort = lSpans; ( lSort > 0 ) && ( lStarts[lSort-1] > lStart ); lSort-- )
+      {
+        lStarts[lSort] = lStarts[lSort-1];
+        lEnds[lSort] = lEnds[lSort-1];
+      }
+      lStarts[lSort] = lStart;
+      lEnds[lSort] = lEnd;
+      lSpans++;
+    }
+    if ( lSpans == 0 )
+    {
+      continue;
+    }
+
+    /* And then merge any that touch, keeping each merged span once. */
+    lStart = lStarts[0];
+    lEnd = lEnds[0];
+    for ( lIndex = 1; lIndex <= lSpans; lIndex++ )
+    {
+      if ( ( lIndex < lSpans ) && ( lStarts[lIndex] <= lEnd + 1 ) )
+      {
+        if ( lEnds[lIndex] > lEnd )
+        {
+          lEnd = lEnds[lIndex];
+        }
+        continue;
+      }
+
+      /* This span is complete, so keep it (if there's room) and start the next. */
+      if ( lCount < pMax )
+      {
+        pSpans[lCount].x = lStart;
+        pSpans[lCount].y = lRow;
+        pSpans[lCount].length = lEnd - lStart + 1;
+        lCount++;
+      }
+      else
+      {
+        m_canopy_dropped++;
+      }
+      if ( lIndex < lSpans )
+      {
+        lStart = lStarts[lIndex];
+        lEnd = lEnds[lIndex];
+      }
+    }
+  }
+
+  /* All done. */
+  return lCount;
+}
+
+
+/*
+ * render_canopy; draws a set of equally sized leaf discs, merged into spans
+ *                in the buffer provided. If we weren't given one, we fall back
+ *                to drawing each disc on its own.
+ */
+
+void Tree::render_canopy( const pimoroni::Point *pLeaves, uint_fast8_t pCount, int32_t pRadius,
+                          canopy_span_t *pSpans, uint_fast16_t pMaxSpans )
+{
+  uint_fast16_t lCount;
+  uint32_t      lDiscPixels;
+
+  if ( pSpans == nullptr )
+  {
+    for ( uint_fast8_t lIndex = 0; lIndex < pCount; lIndex++ )
+    {
+      this->mQueue->circle( pLeaves[lIndex], pRadius );
+    }
+    return;
+  }
+
+  lCount = Tree::build_canopy( pLeaves, pCount, pRadius, pSpans, pMaxSpans, &lDiscPixels );
+  m_canopy_disc_pixels += lDiscPixels;
+
+  for ( uint_fast16_t lIndex = 0; lIndex < lCount; lIndex++ )
+  {
+    this->mQueue->pixel_span( pimoroni::Point( pSpans[lIndex].x, pSpans[lIndex].y ), pSpans[lIndex].length );
+    m_canopy_span_pixels += pSpans[lIndex].length;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_pattern_canopy; draws the leaves at one depth of the pattern growing
+ *                        from a trunk branch, from the spans the library has
+ *                        already merged for it.
+ */
+
+void Tree::render_pattern_canopy( uint_fast8_t pSlot, uint_fast8_t pDepth, int32_t pOffset )
+{
+  const pattern_ref_t *lRef = &this->mRefs[pSlot];
+  const canopy_span_t *lSpans;
+  pimoroni::Point      lRoot = this->mRoots[pSlot];
+  uint_fast16_t        lCount;
+  uint32_t             lDiscPixels;
+  int32_t              lStart;
+
+  lSpans = this->mPatterns->canopy( lRef, pDepth, &lCount, &lDiscPixels );
+  m_canopy_disc_pixels += lDiscPixels;
+
+  for ( uint_fast16_t lIndex = 0; lIndex < lCount; lIndex++ )
+  {
+    /* Spans are stored unmirrored; flipping one means flipping its far end. */
+    lStart = lRef->mirror ? -( lSpans[lIndex].x + lSpans[lIndex].length - 1 ) : lSpans[lIndex].x;
+    this->mQueue->pixel_span( pimoroni::Point( lRoot.x + lStart - pOffset, lRoot.y + lSpans[lIndex].y ),
+                              lSpans[lIndex].length );
+    m_canopy_span_pixels += lSpans[lIndex].length;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_baked_canopy; draws the leaves at one level of our own branches, from
+ *                      the spans baked once we were fully grown. Only the spans
+ *                      which fall within the area around the leaves we were
+ *                      asked for are drawn; it's in frame coordinates, as is
+ *                      everything else here.
+ */
+
+void Tree::render_baked_canopy( uint_fast8_t pLevel, uint_fast8_t pLeaves, int32_t pOffset,
+                                const pimoroni::Rect &pArea )
+{
+  const tree_baked_t  *lBaked = (const tree_baked_t *)this->mCanopy->canopy();
+  const canopy_span_t *lSpans = (const canopy_span_t *)( lBaked + 1 ), *lSpan;
+  int32_t              lLeft = this->mOrigin.x - pOffset, lTop = this->mOrigin.y;
+
+  for ( uint_fast16_t lIndex = lBaked->first[pLevel]; lIndex < lBaked->first[pLevel+1]; lIndex++ )
+  {
+    /* Spans go a row at a time, top to bottom, so there's nothing more once we're below the area. */
+    lSpan = &lSpans[lIndex];
+    if ( lTop + lSpan->y >= pArea.y + pArea.h )
+    {
+      break;
+    }
+    if ( ( lTop + lSpan->y < pArea.y ) || ( lLeft + lSpan->x >= pArea.x + pArea.w ) ||
+         ( lLeft + lSpan->x + lSpan->length <= pArea.x ) )
+    {
+      continue;
+    }
+    this->mQueue->pixel_span( pimoroni::Point( lLeft + lSpan->x, lTop + lSpan->y ), lSpan->length );
+    m_canopy_span_pixels += lSpan->length;
+  }
+  m_canopy_disc_pixels += pLeaves * lBaked->disc[pLevel];
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * canopy_stats; reports how many pixels the leaves would have taken if drawn
+ *               as individual discs, and how many the merged canopies actually
+ *               wrote; and how many spans were lost because a canopy didn't
+ *               fit in CANOPY_SPANS_MAX. Optionally resets the counts.
+ */
+
+void Tree::canopy_stats( uint32_t *pDiscPixels, uint32_t *pSpanPixels, uint32_t *pDropped, bool pReset )
+{
+  *pDiscPixels = m_canopy_disc_pixels;
+  *pSpanPixels = m_canopy_span_pixels;
+  *pDropped = m_canopy_dropped;
+
+  if ( pReset )
+  {
+    m_canopy_disc_pixels = m_canopy_span_pixels = m_canopy_dropped = 0;
+  }
+}
+
+
+/*
+ * light_stats; reports how many new branches have had to lean the other way,
+ *              been cut short, or not grown at all, to find some light.
+ *              Optionally resets the counts.
+ */
+
+void Tree::light_stats( uint32_t *pRedirected, uint32_t *pShortened, uint32_t *pSuppressed, bool pReset )
+{
+  *pRedirected = m_light_redirected;
+  *pShortened = m_light_shortened;
+  *pSuppressed = m_light_suppressed;
+
+  if ( pReset )
+  {
+    m_light_redirected = m_light_shortened = m_light_suppressed = 0;
+  }
+}
+
+
 /*
  * is_dead; simple test do decide if the current tree is still alive.
  */
 
 bool Tree::is_dead( void )
 {
-  return this->mAge > AGE_DEATH;
+  return this->mBare;
+}
+
+
+/*
+ * decay; reports what dying did to the tree on the last update, if anything,
+ *        and the world area which needs redrawing because of it.
+ */
+
+uint_fast8_t Tree::decay( pimoroni::Rect *pArea )
+{
+  *pArea = this->mDecayArea;
+  return this->mDecay;
+}
+
+
+/*
+ * is_visible; tests if any part of the tree falls within the given range of
+ *             world columns, so that we can skip rendering trees we can't see.
+ */
+
+bool Tree::is_visible( int32_t pLeft, int32_t pWidth )
+{
+  return ( this->mRight >= pLeft ) && ( this->mLeft < pLeft + pWidth );
+}
+
+
+/*
+ * bounds; returns the world rectangle the tree covers, leaves and all; the
+ *         base of a thick trunk pokes a little way below the origin.
+ */
+
+pimoroni::Rect Tree::bounds( void )
+{
+  return pimoroni::Rect( this->mLeft, this->mTop, this->mRight - this->mLeft + 1,
+                         this->mOrigin.y + 10 - this->mTop );
+}
+
+
+/*
+ * origin_x; returns the world column the tree is planted in.
+ */
+
+int32_t Tree::origin_x( void )
+{
+  return this->mOrigin.x;
+}
+
+
+/*
+ * age; returns how old the tree is, in updates.
+ */
+
+uint_fast8_t Tree::age( void )
+{
+  return this->mAge;
 }
 
 /* End of file tree.cpp */
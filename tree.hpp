@@ -12,8 +12,40 @@
 #include "libraries/pico_graphics/pico_graphics_dv.hpp"
 
 #include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
+#include "offscreen.hpp"
+#include "tier.hpp"
 
 
+/* Constants. */
+
+#define CANOPY_LEAVES_MAX   ( 1 << ( AGE_GROWTH / 4 ) )
+#define LEAF_RADIUS_MAX     20
+#define CANOPY_SPANS_MAX    192     /* The outermost leaves cover the most rows. */
+#define BRANCH_LEVELS_THICK ( AGE_GROWTH / 4 - 1 )    /* Levels below this are drawn thick. */
+#define BRANCH_BEND_MAX     8       /* In 64ths of the branch length, either way. */
+#define TREE_LEVELS_MAX     ( AGE_GROWTH / 4 + 2 )    /* The trunk is level 1, and each growth adds one. */
+
+/* New branches grow out over a number of frames, and then their leaves do. */
+#define GROWTH_LINE_STEPS   24
+#define GROWTH_LEAF_STEPS   16
+#define GROWTH_STEPS        ( GROWTH_LINE_STEPS + GROWTH_LEAF_STEPS )
+#define GROWTH_FRAMES       ( GROWTH_STEPS + 2 )    /* Both buffers need the last step. */
+
+/* Trees compete for light; new growth avoids cells that other trees' leaves crowd. */
+#define TREE_LIGHT_REACH    192     /* How far either side of the trunk our leaves are counted. */
+#define TREE_LIGHT_COLUMNS  ( TREE_LIGHT_REACH * 2 / SPATIAL_LIGHT_SIZE )
+#define TREE_LIGHT_WORDS    ( ( TREE_LIGHT_COLUMNS * SPATIAL_LIGHT_ROWS + 31 ) / 32 )
+#define TREE_SHADE_LIMIT    2       /* Other trees, in a cell and the one above it, that's too many. */
+
+/* Dying trees turn their leaves first, and then shed a branch at a time. */
+#define DEATH_FADE_STEPS    4
+#define TREE_DECAY_NONE     0
+#define TREE_DECAY_FADE     1       /* Redraw in place, in the new colours. */
+#define TREE_DECAY_SHED     2       /* Repaint from the background up. */
+
 /* Structures. */
 
 typedef struct branch_t branch_t;
@@ -23,30 +55,87 @@ struct branch_t
   branch_t       *branches[BRANCHES_MAX];
 };
 
+/* Once fully grown, a tree's own leaves are kept pre-merged, relative to its origin. */
+typedef struct
+{
+  uint16_t        first[TREE_LEVELS_MAX+1];   /* Each level runs up to where the next starts. */
+  uint16_t        disc[TREE_LEVELS_MAX];      /* The pixels in a single leaf, for the stats. */
+} tree_baked_t;                               /* The spans follow on, in the same block. */
+
+
 /* Class declaration. */
 
 class Tree
 {
 private:
-  pimoroni::PicoGraphics_PenDV_RGB555  *mGraphics;
+  RenderQueue                          *mQueue;
+  SpatialIndex                         *mIndex;
+  PatternLibrary                       *mPatterns;
   pimoroni::Point                       mOrigin;
   branch_t                              mTrunk;
+  pattern_ref_t                         mRefs[BRANCHES_MAX];
+  pimoroni::Point                       mRoots[BRANCHES_MAX];
+  CanopyTier                           *mCanopy;       /* Our baked canopy, wherever it is. */
   uint_fast8_t                          mHeight;
   uint_fast8_t                          mAge;
+  uint_fast8_t                          mGrowLevel, mGrowStep;
+  uint_fast8_t                          mFade, mDecay;
+  pimoroni::Rect                        mDecayArea;
+  uint32_t                              mFootprint[TREE_LIGHT_WORDS];
+  int_fast16_t                          mLightBase;
+  bool                                  mBare;
+  int32_t                               mLeft, mRight, mTop;
+  uint32_t                              mRandom;
 
   branch_t       *alloc_branch( pimoroni::Point, uint_fast8_t );
   void            free_branch( branch_t * );
   void            grow_branch( branch_t *, uint_fast8_t );
-  void            render_branch( const branch_t *, const pimoroni::Point *,
-                                 uint_fast16_t, uint_fast8_t );
+  void            grow_pattern( uint_fast8_t );
+  void            gather_leaves( const branch_t *, uint_fast8_t, uint_fast8_t, pimoroni::Point *, uint_fast8_t * );
+  void            bake( void );
+  void            widen( const pimoroni::Point & );
+  bool            footprint( int_fast16_t, int_fast16_t, uint_fast16_t * );
+  uint_fast8_t    others( int_fast16_t, int_fast16_t );
+  bool            shaded( const pimoroni::Point & );
+  bool            find_light( const pimoroni::Point &, pimoroni::Point * );
+  void            occupy( const pimoroni::Point & );
+  void            render_canopy( const pimoroni::Point *, uint_fast8_t, int32_t,
+                                 canopy_span_t *, uint_fast16_t );
+  void            render_pattern_canopy( uint_fast8_t, uint_fast8_t, int32_t );
+  void            render_baked_canopy( uint_fast8_t, uint_fast8_t, int32_t, const pimoroni::Rect & );
+  void            render_ring( const pimoroni::Point &, int32_t, int32_t );
+  void            set_leaf_pen( uint_fast8_t, uint_fast16_t );
+  uint_fast8_t    growth( uint_fast8_t, uint_fast8_t );
+  void            growth_curve( const primitive_t *, uint_fast8_t, uint_fast8_t, int32_t,
+                                pimoroni::Point *, pimoroni::Point *, pimoroni::Point * );
+  static pimoroni::Point control( const primitive_t * );
+  static uint8_t  thickness( uint_fast8_t );
 
 public:
-                  Tree( pimoroni::PicoGraphics_PenDV_RGB555 * );
+                  Tree( RenderQueue *, SpatialIndex *, PatternLibrary *, OffscreenHeap *,
+                        pimoroni::Point, uint32_t );
                  ~Tree( void );
 
   void            update( void );
-  void            render( uint_fast16_t );
+  void            animate( uint_fast8_t );
+  void            settle( void );
+  bool            recall( void );
+  bool            is_growing( void );
+  void            render_growth( const primitive_t **, uint_fast16_t, uint_fast16_t, int32_t );
+  void            render( const primitive_t **, uint_fast16_t, uint_fast16_t, int32_t,
+                          canopy_span_t *, uint_fast16_t );
   bool            is_dead( void );
+  uint_fast8_t    decay( pimoroni::Rect * );
+  bool            is_visible( int32_t, int32_t );
+  pimoroni::Rect  bounds( void );
+  int32_t         origin_x( void );
+  uint_fast8_t    age( void );
+
+  static int32_t  leaf_radius( uint_fast8_t );
+  static uint_fast16_t build_canopy( const pimoroni::Point *, uint_fast8_t, int32_t,
+                                     canopy_span_t *, uint_fast16_t, uint32_t * );
+  static void     canopy_stats( uint32_t *, uint32_t *, uint32_t *, bool );
+  static void     light_stats( uint32_t *, uint32_t *, uint32_t *, bool );
 
 };
 
@@ -10,6 +10,8 @@
 
 /* System header files. */
 
+#include <stdlib.h>
+
 
 /* Local header files. */
 
@@ -18,7 +20,13 @@
 #include "libraries/pico_graphics/pico_graphics_dv.hpp"
 
 #include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "arena.hpp"
+#include "offscreen.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
 #include "tree.hpp"
+#include "landscape.hpp"
 #include "world.hpp"
 
 #include "sprite_sun.hpp"
@@ -34,15 +42,46 @@
 
 
 /*
- * constructor; provided with the display and graphics objects, which we will
- *              use to render the world.
+ * compare_primitives; orders primitives for drawing; tree by tree, from left
+ *                     to right, and level by level within each tree.
+ */
+
+static int compare_primitives( const void *pFirst, const void *pSecond )
+{
+  const primitive_t *lFirst = *(const primitive_t * const *)pFirst;
+  const primitive_t *lSecond = *(const primitive_t * const *)pSecond;
+
+  if ( lFirst->owner != lSecond->owner )
+  {
+    if ( lFirst->owner->origin_x() != lSecond->owner->origin_x() )
+    {
+      return lFirst->owner->origin_x() < lSecond->owner->origin_x() ? -1 : 1;
+    }
+    return (uintptr_t)lFirst->owner < (uintptr_t)lSecond->owner ? -1 : 1;
+  }
+  return (int)lFirst->level - (int)lSecond->level;
+}
+
+
+/*
+ * constructor; provided with the display and graphics objects, which we use
+ *              to set things up, the render queue which we will use to
+ *              render the world, the arena for any scratch space we need
+ *              while doing so, and the clock to show in the corner.
  */
 
-World::World( pimoroni::DVDisplay *pDisplay, pimoroni::PicoGraphics_PenDV_RGB555 *pGraphics )
+World::World( pimoroni::DVDisplay *pDisplay, pimoroni::PicoGraphics_PenDV_RGB555 *pGraphics,
+              RenderQueue *pQueue, FrameArena *pArena, OffscreenHeap *pOffscreen, ClockOverlay *pClock )
 {
+  uint16_t *lTitle, *lHalos;
+
   /* Simply save the references we're given. */
   this->mDisplay = pDisplay;
   this->mGraphics = pGraphics;
+  this->mQueue = pQueue;
+  this->mArena = pArena;
+  this->mOffscreen = pOffscreen;
+  this->mClock = pClock;
 
   /* Set the default font. */
   this->mGraphics->set_font( "bitmap8" );
@@ -57,40 +96,116 @@ World::World( pimoroni::DVDisplay *pDisplay, pimoroni::PicoGraphics_PenDV_RGB555
   /* And position it slightly off screen to start with. */
   this->mTitleOffset = (SCREEN_WIDTH-this->mTitleLength) / 2;
 
+  /*
+   * It's drawn just the once, into a row of sprite tiles; there only need to
+   * be as many sprites as there can be tiles on screen at a time.
+   */
+  this->mTitleTiles = ( this->mTitleLength + TITLE_TILE_WIDTH - 1 ) / TITLE_TILE_WIDTH;
+  if ( this->mTitleTiles > TITLE_TILES_MAX )
+  {
+    this->mTitleTiles = TITLE_TILES_MAX;
+  }
+  this->mTitleSlots = SCREEN_WIDTH / TITLE_TILE_WIDTH + 1;
+  if ( this->mTitleSlots > this->mTitleTiles )
+  {
+    this->mTitleSlots = this->mTitleTiles;
+  }
+  this->mTitleShownFG = this->mTitleShownBG = 0;
+  lTitle = this->build_title();
+
+  /* The moon starts off full, and is cut from the base image a phase at a time. */
+  this->mMoonPhase = this->mMoonPhaseFG = this->mMoonPhaseBG = MOON_PHASES / 2;
+  moon_phase( this->mMoonSprite, sprite_moon_data, this->mMoonPhase );
+
+  /* The sun and moon glow, courtesy of a ring of blended sprites around each. */
+  lHalos = (uint16_t *)malloc( 8 * HALO_TILE_SIZE * HALO_TILE_SIZE * sizeof( uint16_t ) );
+  if ( lHalos != nullptr )
+  {
+    halo_generate( lHalos, 255, 220, 120, 14 );
+    halo_generate( lHalos + 4 * HALO_TILE_SIZE * HALO_TILE_SIZE, 170, 190, 255, 13 );
+  }
+
   /* Initialise our colours and dates to something basic. */
   this->mTimeOfDay = 0;
   this->mSkyFG.h = this->mSkyFG.s = this->mSkyFG.v = 0.0f;
   this->mSkyBG.h = this->mSkyBG.s = this->mSkyBG.v = 0.0f;
   this->mGroundFG.h = this->mGroundFG.s = this->mGroundFG.v = 0.0f;
   this->mGroundBG.h = this->mGroundBG.s = this->mGroundBG.v = 0.0f;
+  this->mGroundPensColour.h = this->mGroundPensColour.s = this->mGroundPensColour.v = -1.0f;
+  this->mStarsFG = this->mStarsBG = 0;
+
+  /* The camera starts at the beginning of the world, and pans right forever. */
+  this->mCamera = this->mCameraFG = this->mCameraBG = 0;
 
   /* Load up our sprite data; need to do it in both banks. */
   this->mDisplay->define_sprite( SPRITE_SUN, sprite_sun_width, sprite_sun_height, sprite_sun_data );
-  this->mDisplay->define_sprite( SPRITE_MOON, sprite_moon_width, sprite_moon_height, sprite_moon_data );
+  this->mDisplay->define_sprite( SPRITE_MOON, MOON_SIZE, MOON_SIZE, this->mMoonSprite );
   this->mDisplay->define_sprite( SPRITE_CLOUDL, sprite_cloudl_width, sprite_cloudl_height, sprite_cloudl_data );
   this->mDisplay->define_sprite( SPRITE_CLOUDR, sprite_cloudr_width, sprite_cloudr_height, sprite_cloudr_data );
   this->mDisplay->define_sprite( SPRITE_BIRD1, sprite_bird1_width, sprite_bird1_height, sprite_bird1_data );
   this->mDisplay->define_sprite( SPRITE_BIRD2, sprite_bird2_width, sprite_bird2_height, sprite_bird2_data );
   this->mDisplay->define_sprite( SPRITE_BIRD3, sprite_bird3_width, sprite_bird3_height, sprite_bird3_data );
+  for ( uint_fast8_t lTile = 0; lTile < this->mTitleTiles; lTile++ )
+  {
+    this->mDisplay->define_sprite( SPRITE_TITLE + lTile, TITLE_TILE_WIDTH, TITLE_TILE_HEIGHT,
+                                   lTitle + lTile * TITLE_TILE_WIDTH * TITLE_TILE_HEIGHT );
+  }
+  for ( uint_fast8_t lTile = 0; ( lHalos != nullptr ) && ( lTile < 8 ); lTile++ )
+  {
+    this->mDisplay->define_sprite( SPRITE_HALO_SUN + lTile, HALO_TILE_SIZE, HALO_TILE_SIZE,
+                                   lHalos + lTile * HALO_TILE_SIZE * HALO_TILE_SIZE );
+  }
+  this->mDisplay->set_scroll_idx_for_lines( SCROLL_GROUP_WORLD, TITLE_HEIGHT, SCREEN_HEIGHT );
   this->mDisplay->flip();
   this->mDisplay->define_sprite( SPRITE_SUN, sprite_sun_width, sprite_sun_height, sprite_sun_data );
-  this->mDisplay->define_sprite( SPRITE_MOON, sprite_moon_width, sprite_moon_height, sprite_moon_data );
+  this->mDisplay->define_sprite( SPRITE_MOON, MOON_SIZE, MOON_SIZE, this->mMoonSprite );
   this->mDisplay->define_sprite( SPRITE_CLOUDL, sprite_cloudl_width, sprite_cloudl_height, sprite_cloudl_data );
   this->mDisplay->define_sprite( SPRITE_CLOUDR, sprite_cloudr_width, sprite_cloudr_height, sprite_cloudr_data );
   this->mDisplay->define_sprite( SPRITE_BIRD1, sprite_bird1_width, sprite_bird1_height, sprite_bird1_data );
   this->mDisplay->define_sprite( SPRITE_BIRD2, sprite_bird2_width, sprite_bird2_height, sprite_bird2_data );
   this->mDisplay->define_sprite( SPRITE_BIRD3, sprite_bird3_width, sprite_bird3_height, sprite_bird3_data );
-
-  /* Initialise our forest. */
-  for ( uint_fast8_t lIndex = 0; lIndex < TREES_MAX; lIndex++ )
+  for ( uint_fast8_t lTile = 0; lTile < this->mTitleTiles; lTile++ )
+  {
+    this->mDisplay->define_sprite( SPRITE_TITLE + lTile, TITLE_TILE_WIDTH, TITLE_TILE_HEIGHT,
+                                   lTitle + lTile * TITLE_TILE_WIDTH * TITLE_TILE_HEIGHT );
+  }
+  for ( uint_fast8_t lTile = 0; ( lHalos != nullptr ) && ( lTile < 8 ); lTile++ )
   {
-    this->mForest[lIndex] = nullptr;
+    this->mDisplay->define_sprite( SPRITE_HALO_SUN + lTile, HALO_TILE_SIZE, HALO_TILE_SIZE,
+                                   lHalos + lTile * HALO_TILE_SIZE * HALO_TILE_SIZE );
   }
+  this->mDisplay->set_scroll_idx_for_lines( SCROLL_GROUP_WORLD, TITLE_HEIGHT, SCREEN_HEIGHT );
+
+  /* The display driver has its own copy of the title and halo tiles now. */
+  free( lTitle );
+  free( lHalos );
+  this->mHalos = ( lHalos != nullptr );
+
+  /* The landscape (and the forest growing on it) is generated as we go. */
+  this->mIndex = new SpatialIndex();
+#if FOREST_PATTERNS
+  this->mPatterns = new PatternLibrary( WORLD_SEED );
+  if ( !this->mPatterns->ready() )
+  {
+    delete this->mPatterns;
+    this->mPatterns = nullptr;
+  }
+#else
+  this->mPatterns = nullptr;
+#endif
+  this->mLandscape = new Landscape( this->mQueue, this->mIndex, this->mPatterns, this->mOffscreen, WORLD_SEED );
 
   /* And any other init stuff... */
   this->mRedrawSkyFG = this->mRedrawForestFG = true;
   this->mRedrawSkyBG = this->mRedrawForestBG = true;
+  this->mDamageCountFG = this->mDamageCountBG = 0;
+  this->mStarved = false;
+  this->mReasons = 0;
   this->mCloudActive = this->mBirdActive = false;
+  for ( uint_fast8_t lSlot = 0; lSlot < TRANSIENT_SLOTS; lSlot++ )
+  {
+    this->mEffects[lSlot].type = SKY_EFFECT_NONE;
+  }
 
   /* All done. */
   return;
@@ -103,15 +218,10 @@ World::World( pimoroni::DVDisplay *pDisplay, pimoroni::PicoGraphics_PenDV_RGB555
 
 World::~World( void )
 {
-  /* Free up any trees. */
-  for ( uint_fast8_t lIndex = 0; lIndex < TREES_MAX; lIndex++ )
-  {
-    if ( this->mForest[lIndex] != nullptr )
-    {
-      delete this->mForest[lIndex];
-      this->mForest[lIndex] = nullptr;
-    }
-  }
+  /* Free up the landscape, which takes any trees with it, then their index. */
+  delete this->mLandscape;
+  delete this->mIndex;
+  delete this->mPatterns;
 
   /* All done. */
   return;
@@ -156,6 +266,199 @@ const hsv_t *World::sky_colour( void )
 }
 
 
+/*
+ * star_level; returns the brightness of the stars, which depends on how high
+ *             the moon is. This is quantised, so that we only need to repaint
+ *             the sky when the stars visibly change.
+ */
+
+uint8_t World::star_level( void )
+{
+  float lMoonHeight = 0.0f - sin(this->mTimeOfDay*3.14159f/1800.0f);
+
+  /* No moon, no stars. */
+  if ( lMoonHeight <= 0.0f )
+  {
+    return 0;
+  }
+
+  return (uint8_t)( 255.0f * lMoonHeight ) & 0xF0;
+}
+
+
+/*
+ * same_colour; compares two colours, in terms of the pens they would actually
+ *              be drawn with. The HSV values drift a little every frame, but
+ *              the RGB555 pen only steps occasionally.
+ */
+
+bool World::same_colour( const hsv_t *pFirst, const hsv_t *pSecond )
+{
+  return pimoroni::RGB::from_hsv( pFirst->h, pFirst->s, pFirst->v ).to_rgb555() ==
+         pimoroni::RGB::from_hsv( pSecond->h, pSecond->s, pSecond->v ).to_rgb555();
+}
+
+
+/*
+ * build_title; draws the title text into a buffer of our own, and cuts it
+ *              into sprite tiles; drawn pixels are made opaque, and the rest
+ *              left transparent. The caller frees the tiles when done.
+ */
+
+uint16_t *World::build_title( void )
+{
+  uint16_t *lBanner, *lTiles, lPixel;
+  int32_t   lWidth = this->mTitleTiles * TITLE_TILE_WIDTH;
+
+  /* We need somewhere to draw the whole banner, and somewhere to cut it into. */
+  lBanner = (uint16_t *)calloc( lWidth * TITLE_TILE_HEIGHT, sizeof( uint16_t ) );
+  lTiles = (uint16_t *)malloc( lWidth * TITLE_TILE_HEIGHT * sizeof( uint16_t ) );
+  if ( ( lBanner == nullptr ) || ( lTiles == nullptr ) )
+  {
+    /* No room, no title; it's hardly essential. */
+    free( lBanner );
+    free( lTiles );
+    this->mTitleTiles = this->mTitleSlots = 0;
+    return nullptr;
+  }
+
+  /* Draw the text just as it used to be drawn into the frame. */
+  pimoroni::PicoGraphics_PenRGB555 lGraphics( lWidth, TITLE_TILE_HEIGHT, lBanner );
+  lGraphics.set_font( "bitmap8" );
+  lGraphics.set_pen( 255, 255, 255 );
+  lGraphics.text( this->mTitleText, pimoroni::Point( 0, 0 ), lWidth );
+
+  /* And then cut it up, tile by tile. */
+  for ( uint_fast8_t lTile = 0; lTile < this->mTitleTiles; lTile++ )
+  {
+    for ( uint_fast8_t lRow = 0; lRow < TITLE_TILE_HEIGHT; lRow++ )
+    {
+      for ( uint_fast8_t lColumn = 0; lColumn < TITLE_TILE_WIDTH; lColumn++ )
+      {
+        lPixel = lBanner[lRow * lWidth + lTile * TITLE_TILE_WIDTH + lColumn];
+        lTiles[( lTile * TITLE_TILE_HEIGHT + lRow ) * TITLE_TILE_WIDTH + lColumn] = lPixel ? lPixel | 0x8000 : 0;
+      }
+    }
+  }
+
+  /* All done. */
+  free( lBanner );
+  return lTiles;
+}
+
+
+/*
+ * frame_column; converts a world column into a column within the frame; the
+ *               frame is wrapped around horizontally as the camera pans.
+ */
+
+int32_t World::frame_column( int32_t pWorldColumn )
+{
+  return ( ( pWorldColumn % FRAME_WIDTH ) + FRAME_WIDTH ) % FRAME_WIDTH;
+}
+
+
+/*
+ * invalidate; forces a complete repaint of both buffers, for when something
+ *             else (like the benchmark) has scribbled all over the frame.
+ */
+
+void World::invalidate( void )
+{
+  this->mRedrawSkyFG = this->mRedrawSkyBG = true;
+  this->mRedrawForestFG = this->mRedrawForestBG = true;
+}
+
+
+/*
+ * heavy_ahead; predicts whether the next render will be an expensive one;
+ *              a full repaint, a forest redraw or some damage to fix up.
+ *              This uses the same tests as render, but changes nothing.
+ */
+
+bool World::heavy_ahead( void )
+{
+  return ( this->mRedrawSkyFG ) || ( this->mRedrawForestFG ) || ( this->mDamageCountFG > 0 ) ||
+         ( !this->same_colour( this->ground_colour(), &this->mGroundFG ) ) ||
+         ( !this->same_colour( this->sky_colour(), &this->mSkyFG ) ) ||
+         ( this->star_level() != this->mStarsFG ) ||
+         ( abs( this->mCamera - this->mCameraFG ) >= SCREEN_WIDTH );
+}
+
+
+/*
+ * record; fills in the World's part of a flight recorder frame; why it drew
+ *         what it did since the last time we were asked, and a census of the
+ *         trees we're holding.
+ */
+
+void World::record( flight_frame_t *pFrame )
+{
+  uint_fast16_t lPrimitives, lEntries;
+  uint_fast8_t  lAge;
+
+  pFrame->reasons = this->mReasons;
+  this->mReasons = 0;
+
+  this->mIndex->stats( &lPrimitives, &lEntries );
+  pFrame->primitives = lPrimitives;
+
+  pFrame->trees = pFrame->dying = 0;
+  pFrame->youngest = pFrame->oldest = 0;
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    chunk_t *lChunk = this->mLandscape->cached( lSlot );
+    if ( lChunk == nullptr )
+    {
+      continue;
+    }
+    for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+    {
+      if ( lChunk->trees[lIndex] == nullptr )
+      {
+        continue;
+      }
+      lAge = lChunk->trees[lIndex]->age();
+      if ( ( pFrame->trees == 0 ) || ( lAge < pFrame->youngest ) )
+      {
+        pFrame->youngest = lAge;
+      }
+      if ( lAge > pFrame->oldest )
+      {
+        pFrame->oldest = lAge;
+      }
+      pFrame->dying += ( lAge >= AGE_DEATH ) ? 1 : 0;
+      pFrame->trees++;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * add_damage; notes an area of the world which needs repainting in both
+ *             buffers; either from the background up, or just the trees in
+ *             it. If we run out of room, we just repaint everything.
+ */
+
+void World::add_damage( const pimoroni::Rect &pArea, bool pBackground )
+{
+  if ( ( this->mDamageCountFG >= DAMAGE_MAX ) || ( this->mDamageCountBG >= DAMAGE_MAX ) )
+  {
+    this->mRedrawSkyFG = this->mRedrawSkyBG = true;
+    return;
+  }
+
+  this->mDamageFG[this->mDamageCountFG].area = pArea;
+  this->mDamageFG[this->mDamageCountFG++].background = pBackground;
+  this->mDamageBG[this->mDamageCountBG].area = pArea;
+  this->mDamageBG[this->mDamageCountBG++].background = pBackground;
+  return;
+}
+
+
 /*
  * update; called each frame, to update the state of the world. No changes 
  *         should be sent to the display here, as it will be called asynchronously
@@ -168,6 +471,10 @@ void World::update( void )
   if ( ++this->mTimeOfDay > 3600 )
   {
     this->mTimeOfDay = 0;
+
+    /* ...and with every new day, the moon moves on a phase. */
+    this->mMoonPhase = ( this->mMoonPhase + 1 ) % MOON_PHASES;
+    moon_phase( this->mMoonSprite, sprite_moon_data, this->mMoonPhase );
   }
 
   /* Swap the current front buffer colours to the back. */
@@ -180,11 +487,46 @@ void World::update( void )
   memcpy( &this->mSkyBG, &this->mSkyFG, sizeof( hsv_t ) );
   memcpy( &this->mSkyFG, &lTempColour, sizeof( hsv_t ) );
 
+  uint8_t lTempStars = this->mStarsBG;
+  this->mStarsBG = this->mStarsFG;
+  this->mStarsFG = lTempStars;
+
+  uint16_t lTempShown = this->mTitleShownBG;
+  this->mTitleShownBG = this->mTitleShownFG;
+  this->mTitleShownFG = lTempShown;
+
+  uint_fast8_t lTempPhase = this->mMoonPhaseBG;
+  this->mMoonPhaseBG = this->mMoonPhaseFG;
+  this->mMoonPhaseFG = lTempPhase;
+  this->mClock->swap();
+
+  /* And the camera position each buffer was last drawn at. */
+  int32_t lTempCamera = this->mCameraBG;
+  this->mCameraBG = this->mCameraFG;
+  this->mCameraFG = lTempCamera;
+
   /* Also, bring forward the rear redraw flags. */
   this->mRedrawSkyFG = this->mRedrawSkyBG;
   this->mRedrawForestFG = this->mRedrawForestBG;
   this->mRedrawSkyBG = this->mRedrawForestBG = false;
 
+  /* And the damaged areas; the back buffer has had its turn. */
+  memcpy( this->mDamageFG, this->mDamageBG, sizeof( damage_t ) * this->mDamageCountBG );
+  this->mDamageCountFG = this->mDamageCountBG;
+  this->mDamageCountBG = 0;
+
+  /* If we ran out of scratch space last frame, the trees will need another go. */
+  if ( this->mStarved )
+  {
+    this->mRedrawForestFG = this->mRedrawForestBG = true;
+    this->mReasons |= REDRAW_STARVED;
+    this->mStarved = false;
+  }
+
+  /* Pan the camera slowly across the world, and keep the landscape ahead of it. */
+  this->mCamera += CAMERA_STEP;
+  this->mLandscape->update( this->mCamera );
+
   /* Scroll the title across the top of the screen. */
   this->mTitleOffset--;
   if ( ( this->mTitleOffset + this->mTitleLength ) < 0 )
@@ -195,39 +537,79 @@ void World::update( void )
   /* Update any trees we have; this is ~1 per second */
   if ( this->mTimeOfDay % 60 == 0 )
   {
-    for ( uint_fast8_t lIndex = 0; lIndex < TREES_MAX; lIndex++ )
+    for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
     {
-      if ( this->mForest[lIndex] != nullptr )
+      chunk_t *lChunk = this->mLandscape->cached( lSlot );
+      if ( lChunk == nullptr )
       {
-        this->mForest[lIndex]->update();
-        if ( this->mForest[lIndex]->is_dead() )
+        continue;
+      }
+
+      for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+      {
+        if ( lChunk->trees[lIndex] != nullptr )
         {
-          delete this->mForest[lIndex];
-          this->mForest[lIndex] = nullptr;
-          this->mRedrawSkyFG = this->mRedrawSkyBG = true;
+          lChunk->trees[lIndex]->update();
+
+          /* Once it has shed everything, there's nothing left to draw. */
+          if ( lChunk->trees[lIndex]->is_dead() )
+          {
+            this->mLandscape->fell_tree( lChunk, lIndex );
+            this->mReasons |= REDRAW_DEATH;
+            continue;
+          }
+
+          /* While dying, only what changed is worth a repaint, and only if we could see it. */
+          if ( lChunk->trees[lIndex]->is_visible( this->mCamera, SCREEN_WIDTH ) )
+          {
+            pimoroni::Rect lArea;
+            switch( lChunk->trees[lIndex]->decay( &lArea ) )
+            {
+              case TREE_DECAY_FADE:
+                this->add_damage( lArea, false );
+                this->mReasons |= REDRAW_DECAY;
+                break;
+              case TREE_DECAY_SHED:
+                this->add_damage( lArea, true );
+                this->mReasons |= REDRAW_DECAY;
+                break;
+            }
+          }
         }
-        this->mRedrawForestFG = this->mRedrawForestBG = true;
       }
     }
 
-    /* Occasionally spawn a new tree, if we have a free spot. */
-    if ( get_rand_32() % 15 == 0 )
+    /* The ecosystem moves on too, and may fill a gap left by a dead tree with a seedling. */
+    if ( this->mLandscape->tick() )
     {
-      /* See if there's a space in the forest. */
-      for ( uint_fast8_t lIndex = 0; lIndex < TREES_MAX; lIndex++ )
+      this->mReasons |= REDRAW_SPAWN;
+    }
+  }
+
+  /* New growth (and new trees) extend a little further every frame; idle trees move out to PSRAM,
+     and those about to scroll into view ask for theirs back, in time to be drawn. */
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    chunk_t *lChunk = this->mLandscape->cached( lSlot );
+    if ( lChunk == nullptr )
+    {
+      continue;
+    }
+    for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+    {
+      if ( lChunk->trees[lIndex] != nullptr )
       {
-        if ( this->mForest[lIndex] == nullptr )
+        lChunk->trees[lIndex]->animate( 1 );
+        lChunk->trees[lIndex]->settle();
+        if ( lChunk->trees[lIndex]->is_visible( this->mCamera + SCREEN_WIDTH, RECALL_AHEAD ) )
         {
-          /* Found one, so grow a tree and exit. */
-          this->mForest[lIndex] = new Tree( this->mGraphics );
-          this->mRedrawForestFG = this->mRedrawForestBG = true;
-          break;
+          lChunk->trees[lIndex]->recall();
         }
       }
     }
   }
 
-  /* Figure out where the sun should be. */
+  /* Figure out where the sun should be; it's far enough away to ignore the camera. */
   this->mSunLocation.x = ( SCREEN_WIDTH / 2 ) - ( cos(this->mTimeOfDay*3.14159f/1800.0f) * ( ( SCREEN_WIDTH / 2 ) - 16 ) ) - 16;
   this->mSunLocation.y = GROUND_LEVEL - ( sin(this->mTimeOfDay*3.14159f/1800.0f) * GROUND_LEVEL );
 
@@ -256,9 +638,10 @@ void World::update( void )
       }
     }
 
-    /* Drift to the right, until we drop off the end. */
+    /* Drift to the right, until we drop out of view. */
     this->mCloudLocation.x += 2;
-    if ( this->mCloudLocation.x > SCREEN_WIDTH )
+    if ( ( this->mCloudLocation.x > this->mCamera + SCREEN_WIDTH ) ||
+         ( this->mCloudLocation.x < this->mCamera - 128 ) )
     {
       this->mCloudActive = false;
     }
@@ -269,7 +652,7 @@ void World::update( void )
     if ( get_rand_32() % 600 == 0 )
     {
       this->mCloudActive = true;
-      this->mCloudLocation.x = -64;
+      this->mCloudLocation.x = this->mCamera - 64;
       this->mCloudLocation.y = get_rand_32() % ( SCREEN_HEIGHT/2 );
     }
   }
@@ -295,9 +678,10 @@ void World::update( void )
       }
     }
 
-    /* Drift to the left, until we drop off the end. */
-    this->mBirdLocation.x -= 1;
-    if ( this->mBirdLocation.x < -32 )
+    /* Fly to the left (faster than the camera pans), until we drop out of view. */
+    this->mBirdLocation.x -= 2;
+    if ( ( this->mBirdLocation.x < this->mCamera - 32 ) ||
+         ( this->mBirdLocation.x > this->mCamera + SCREEN_WIDTH ) )
     {
       this->mBirdActive = false;
     }
@@ -308,153 +692,663 @@ void World::update( void )
     if ( get_rand_32() % 900 == 0 )
     {
       this->mBirdActive = true;
-      this->mBirdLocation.x = SCREEN_WIDTH;
+      this->mBirdLocation.x = this->mCamera + SCREEN_WIDTH;
       this->mBirdLocation.y = get_rand_32() % GROUND_LEVEL;
     }
   }
 
+  /* And the shooting stars, and anything else fleeting in the night sky. */
+  this->update_effects();
+
   /* All done. */
   return;
 }
 
 
 /*
- * render; called each frame to render the current state of the world. As we're
- *         double buffered, we are always drawing on the *previous* frame
- *         content - ideally we don't want to waste cycles blanking the whole
- *         frame every time if we can think our way around it.
+ * update_effects; moves along any shooting stars or satellites, and sometimes
+ *                 starts a new one; these only appear when the stars are out.
  */
 
-void World::render( void )
+void World::update_effects( void )
+{
+  sky_effect_t *lEffect;
+
+  /* The effects have their own record of what they drew in each buffer. */
+  this->mTransients.swap();
+
+  for ( uint_fast8_t lSlot = 0; lSlot < TRANSIENT_SLOTS; lSlot++ )
+  {
+    lEffect = &this->mEffects[lSlot];
+
+    /* Move anything running, and retire it if it's burnt out or left the sky. */
+    if ( lEffect->type != SKY_EFFECT_NONE )
+    {
+      lEffect->location += lEffect->step;
+      if ( ( ++lEffect->age > lEffect->life ) ||
+           ( lEffect->location.x < this->mCamera ) || ( lEffect->location.x >= this->mCamera + SCREEN_WIDTH ) ||
+           ( lEffect->location.y < TITLE_HEIGHT ) || ( lEffect->location.y >= SKY_EFFECT_FLOOR ) )
+      {
+        lEffect->type = SKY_EFFECT_NONE;
+      }
+      continue;
+    }
+
+    /* Nothing in this slot, so maybe start something; but only at night. */
+    if ( this->star_level() == 0 )
+    {
+      continue;
+    }
+    lEffect->location.x = this->mCamera + ( get_rand_32() % SCREEN_WIDTH );
+    lEffect->location.y = TITLE_HEIGHT + ( get_rand_32() % ( SKY_EFFECT_FLOOR - TITLE_HEIGHT ) );
+    lEffect->age = 0;
+    if ( get_rand_32() % METEOR_CHANCE == 0 )
+    {
+      /* A shooting star is quick, and falls at a shallow angle, either way. */
+      lEffect->type = SKY_EFFECT_METEOR;
+      lEffect->step.x = 3 + ( get_rand_32() % 3 );
+      lEffect->step.y = 1 + ( get_rand_32() % 2 );
+      if ( get_rand_32() % 2 )
+      {
+        lEffect->step.x = -lEffect->step.x;
+      }
+      lEffect->life = 12 + ( get_rand_32() % 12 );
+    }
+    else if ( get_rand_32() % SATELLITE_CHANCE == 0 )
+    {
+      /* A satellite just plods steadily across, until it's out of sight. */
+      lEffect->type = SKY_EFFECT_SATELLITE;
+      lEffect->location.x = this->mCamera;
+      lEffect->step.x = CAMERA_STEP + 1;
+      lEffect->step.y = 0;
+      lEffect->life = SCREEN_WIDTH;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_columns; renders a range of world columns into the frame, between
+ *                 the given rows. The frame wraps around, so this may need
+ *                 splitting into two strips.
+ */
+
+void World::render_columns( int32_t pLeft, int32_t pWidth, int32_t pTop, int32_t pHeight,
+                            bool pBackground )
 {
-  const hsv_t *lCurrentColour;
-  float        lOffset;
-
-  /* Handle the ground first; see what colour it should be. */
-  lCurrentColour = this->ground_colour();
-
-  /* And if the front buffer isn't using this colour, update it. */
-  if ( ( this->mRedrawSkyFG ) ||
-       ( lCurrentColour->h != this->mGroundFG.h ) || 
-       ( lCurrentColour->s != this->mGroundFG.s ) || 
-       ( lCurrentColour->v != this->mGroundFG.v ) )
-  {
-    /* Redraw the ground in this colour. */
-    this->mGraphics->set_depth( 1 );
-    lOffset = 0.0f;
-    for ( uint_fast16_t lRow = GROUND_LEVEL; lRow < SCREEN_HEIGHT; lRow++ )
-    {
-      this->mGraphics->set_pen( 
-        pimoroni::RGB::from_hsv(
-          lCurrentColour->h,
-          lCurrentColour->s,
-          lCurrentColour->v - lOffset
-        ).to_rgb555()
+  int32_t lFrameLeft = this->frame_column( pLeft );
+  int32_t lRun;
+
+  while( pWidth > 0 )
+  {
+    /* Work out how much we can draw before we wrap. */
+    lRun = FRAME_WIDTH - lFrameLeft;
+    if ( lRun > pWidth )
+    {
+      lRun = pWidth;
+    }
+
+    /* Draw that strip. */
+    this->render_strip( pLeft, lFrameLeft, lRun, pTop, pHeight, pBackground );
+
+    /* And move on to whatever is left, from the start of the frame. */
+    pLeft += lRun;
+    pWidth -= lRun;
+    lFrameLeft = 0;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_strip; renders a strip of world columns into the same width of frame
+ *               columns, optionally including the background. Everything is
+ *               clipped to the strip, and only the branches which the spatial
+ *               index finds within it are drawn, so this is cheap for small
+ *               areas. Scratch space comes from the frame arena, and is given
+ *               back once we're done.
+ */
+
+void World::render_strip( int32_t pWorldLeft, int32_t pFrameLeft, int32_t pWidth,
+                          int32_t pTop, int32_t pHeight, bool pBackground )
+{
+  int32_t             lOffset = pWorldLeft - pFrameLeft;
+  uint_fast16_t       lCount, lIndex, lFirst;
+  uint32_t            lMark;
+  const primitive_t **lFound;
+  canopy_span_t      *lSpans;
+
+  /* Confine our drawing to the strip, below the title. */
+  if ( pTop < TITLE_HEIGHT )
+  {
+    pHeight -= TITLE_HEIGHT - pTop;
+    pTop = TITLE_HEIGHT;
+  }
+  if ( pHeight <= 0 )
+  {
+    return;
+  }
+  this->mQueue->set_clip( pimoroni::Rect( pFrameLeft, pTop, pWidth, pHeight ) );
+
+  if ( pBackground )
+  {
+    /* Fill the sky with whatever colour this buffer is using. */
+    this->mQueue->set_depth( 0 );
+    this->mQueue->set_pen( 
+      pimoroni::RGB::from_hsv( this->mSkyFG.h, this->mSkyFG.s, this->mSkyFG.v ).to_rgb555()
+    );
+    this->mQueue->rectangle( pimoroni::Rect( pFrameLeft, 0, pWidth, GROUND_LEVEL ) );
+
+    /* Make sure we have the right set of pens for the ground; the hills are a little lighter. */
+    if ( ( this->mGroundPensColour.h != this->mGroundFG.h ) ||
+         ( this->mGroundPensColour.s != this->mGroundFG.s ) ||
+         ( this->mGroundPensColour.v != this->mGroundFG.v ) )
+    {
+      float lShade = -0.003f * TERRAIN_RISE_MAX;
+      for ( uint_fast16_t lRow = GROUND_TOP; lRow < SCREEN_HEIGHT; lRow++ )
+      {
+        this->mGroundPens[lRow-GROUND_TOP] = pimoroni::RGB::from_hsv(
+          this->mGroundFG.h, this->mGroundFG.s, this->mGroundFG.v - lShade
+        ).to_rgb555();
+        lShade += 0.003f;
+      }
+      memcpy( &this->mGroundPensColour, &this->mGroundFG, sizeof( hsv_t ) );
+    }
+
+    /* The stars and terrain come from the chunks that the strip falls across. */
+    for ( int32_t lIndex = Landscape::chunk_index( pWorldLeft );
+          lIndex <= Landscape::chunk_index( pWorldLeft + pWidth - 1 ); lIndex++ )
+    {
+      chunk_t *lChunk = this->mLandscape->chunk( lIndex );
+
+      /* If it's night time, drop in the stars; they're sorted, so we can stop early. */
+      if ( this->mStarsFG > 0 )
+      {
+        this->mQueue->set_depth( 0 );
+        this->mQueue->set_pen( this->mStarsFG, this->mStarsFG, this->mStarsFG );
+        for ( uint_fast8_t lStar = 0; lStar < CHUNK_STARS_MAX; lStar++ )
+        {
+          if ( lChunk->stars[lStar].x >= pWorldLeft + pWidth )
+          {
+            break;
+          }
+          if ( lChunk->stars[lStar].x >= pWorldLeft )
+          {
+            this->mQueue->pixel( lChunk->stars[lStar] - pimoroni::Point( lOffset, 0 ) );
+          }
+        }
+      }
+
+      /* And then draw the ground, a span per row. */
+      this->mQueue->set_depth( 1 );
+      for ( int32_t lRow = pTop > GROUND_TOP ? pTop : GROUND_TOP; lRow < pTop + pHeight; lRow++ )
+      {
+        int32_t lStart, lEnd;
+        if ( !this->mLandscape->ground_span( lChunk, lRow, &lStart, &lEnd ) )
+        {
+          continue;
+        }
+        if ( lStart < pWorldLeft )
+        {
+          lStart = pWorldLeft;
+        }
+        if ( lEnd > pWorldLeft + pWidth )
+        {
+          lEnd = pWorldLeft + pWidth;
+        }
+        if ( lStart < lEnd )
+        {
+          this->mQueue->set_pen( this->mGroundPens[lRow-GROUND_TOP] );
+          this->mQueue->pixel_span( pimoroni::Point( lStart - lOffset, lRow ), lEnd - lStart );
+        }
+      }
+    }
+  }
+
+  /* Trees are drawn over the top, a tree at a time, if they fall within the strip. */
+  this->mQueue->set_depth( 1 );
+  lMark = this->mArena->mark();
+  lFound = (const primitive_t **)this->mArena->alloc( sizeof( const primitive_t * ) * SPATIAL_PRIMITIVES_MAX );
+  lSpans = (canopy_span_t *)this->mArena->alloc( sizeof( canopy_span_t ) * CANOPY_SPANS_MAX );
+  if ( lFound == nullptr )
+  {
+    /* No room to work out what's here; leave the trees until next time. */
+    this->mStarved = true;
+  }
+  else
+  {
+    /* Without room for spans, the trees will just draw their leaves the slow way. */
+    lCount = this->mIndex->query(
+      pimoroni::Rect( pWorldLeft, pTop, pWidth, pHeight ), lFound, SPATIAL_PRIMITIVES_MAX
+    );
+    qsort( lFound, lCount, sizeof( const primitive_t * ), compare_primitives );
+
+    for ( lIndex = 0; lIndex < lCount; )
+    {
+      for ( lFirst = lIndex; ( lIndex < lCount ) && ( lFound[lIndex]->owner == lFound[lFirst]->owner ); lIndex++ );
+      lFound[lFirst]->owner->render( &lFound[lFirst], lIndex - lFirst, this->mTimeOfDay, lOffset,
+                                     lSpans, lSpans == nullptr ? 0 : CANOPY_SPANS_MAX );
+    }
+  }
+  this->mArena->release( lMark );
+
+  /* Release the clipping. */
+  this->mQueue->remove_clip();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_growth; draws the newest growth of any visible tree which is still
+ *                growing. Each tree works out its own delta; we just find its
+ *                primitives, and clip it to the view (and the frame wrap).
+ */
+
+void World::render_growth( void )
+{
+  int32_t             lLeft, lWidth, lFrameLeft, lRun;
+  uint_fast16_t       lCount;
+  uint32_t            lMark;
+  const primitive_t **lFound;
+  Tree               *lTree;
+
+  this->mQueue->set_depth( 1 );
+  for ( uint_fast8_t lSlot = 0; lSlot < CHUNK_CACHE_SIZE; lSlot++ )
+  {
+    chunk_t *lChunk = this->mLandscape->cached( lSlot );
+    if ( lChunk == nullptr )
+    {
+      continue;
+    }
+
+    for ( uint_fast8_t lIndex = 0; lIndex < CHUNK_TREES_MAX; lIndex++ )
+    {
+      lTree = lChunk->trees[lIndex];
+      if ( ( lTree == nullptr ) || ( !lTree->is_growing() ) || ( !lTree->is_visible( this->mCamera, SCREEN_WIDTH ) ) )
+      {
+        continue;
+      }
+
+      /* Only the part of the tree in view, below the title. */
+      pimoroni::Rect lArea = lTree->bounds().intersection(
+        pimoroni::Rect( this->mCamera, TITLE_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT - TITLE_HEIGHT )
       );
-      this->mGraphics->line( pimoroni::Point( 0, lRow ), pimoroni::Point( SCREEN_WIDTH, lRow ) );
-      lOffset += 0.003f;
+      if ( lArea.empty() )
+      {
+        continue;
+      }
+
+      /* Which may be split across the wrap in the frame. */
+      lLeft = lArea.x;
+      lWidth = lArea.w;
+      lFrameLeft = this->frame_column( lLeft );
+      while( lWidth > 0 )
+      {
+        lRun = FRAME_WIDTH - lFrameLeft;
+        if ( lRun > lWidth )
+        {
+          lRun = lWidth;
+        }
+
+        lMark = this->mArena->mark();
+        lFound = (const primitive_t **)this->mArena->alloc( sizeof( const primitive_t * ) * SPATIAL_PRIMITIVES_MAX );
+        if ( lFound == nullptr )
+        {
+          /* No room to work out what's here; a full redraw will catch it up. */
+          this->mStarved = true;
+        }
+        else
+        {
+          lCount = this->mIndex->query(
+            pimoroni::Rect( lLeft, lArea.y, lRun, lArea.h ), lFound, SPATIAL_PRIMITIVES_MAX
+          );
+          this->mQueue->set_clip( pimoroni::Rect( lFrameLeft, lArea.y, lRun, lArea.h ) );
+          lTree->render_growth( lFound, lCount, this->mTimeOfDay, lLeft - lFrameLeft );
+          this->mQueue->remove_clip();
+          this->mReasons |= REDRAW_GROWTH;
+        }
+        this->mArena->release( lMark );
+
+        lLeft += lRun;
+        lWidth -= lRun;
+        lFrameLeft = 0;
+      }
     }
+  }
 
-    /* And remember that it's changed. */
-    memcpy( &this->mGroundFG, lCurrentColour, sizeof( hsv_t ) );
-    this->mRedrawForestFG = this->mRedrawForestBG = true;
+  /* All done. */
+  return;
+}
+
+
+/*
+ * restore_sky; puts a single pixel of sky back as it was, in the given sky
+ *              colour, or as a star if there's one there.
+ */
+
+void World::restore_sky( const pimoroni::Point &pPixel, uint16_t pSkyPen )
+{
+  chunk_t *lChunk;
+
+  /* Anything out of view will be repainted anyway, when it comes back in. */
+  if ( ( pPixel.x < this->mCamera ) || ( pPixel.x >= this->mCamera + SCREEN_WIDTH ) )
+  {
+    return;
+  }
+
+  /* Look for a star here, if they're out. */
+  this->mQueue->set_pen( pSkyPen );
+  if ( this->mStarsFG > 0 )
+  {
+    lChunk = this->mLandscape->chunk( Landscape::chunk_index( pPixel.x ) );
+    for ( uint_fast8_t lStar = 0; lStar < CHUNK_STARS_MAX; lStar++ )
+    {
+      if ( lChunk->stars[lStar].x > pPixel.x )
+      {
+        break;
+      }
+      if ( lChunk->stars[lStar] == pPixel )
+      {
+        this->mQueue->set_pen( this->mStarsFG, this->mStarsFG, this->mStarsFG );
+        break;
+      }
+    }
   }
+  this->mQueue->pixel( pimoroni::Point( this->frame_column( pPixel.x ), pPixel.y ) );
+}
+
 
-  /* Now do the same for the sky. */
-  lCurrentColour = this->sky_colour();
+/*
+ * render_effects; erases whatever the sky effects drew last time this buffer
+ *                 was drawn, and then draws them where they are now. They're
+ *                 behind the trees, so anything with a tree in the way isn't
+ *                 drawn this frame.
+ */
 
-  /* And if the front buffer isn't using this colour, update it. */
-  if ( ( this->mRedrawSkyFG ) ||
-       ( lCurrentColour->h != this->mSkyFG.h ) || 
-       ( lCurrentColour->s != this->mSkyFG.s ) || 
-       ( lCurrentColour->v != this->mSkyFG.v ) )
+void World::render_effects( void )
+{
+  const pimoroni::Point  *lPixels;
+  const primitive_t     **lFound;
+  sky_effect_t           *lEffect;
+  pimoroni::Point         lPixel;
+  uint_fast8_t            lCount, lLength, lBrightness;
+  int32_t                 lStride;
+  uint32_t                lMark;
+  uint16_t                lSkyPen;
+
+  /* First, put back everything that was drawn over. */
+  lSkyPen = pimoroni::RGB::from_hsv( this->mSkyFG.h, this->mSkyFG.s, this->mSkyFG.v ).to_rgb555();
+  this->mQueue->set_depth( 0 );
+  for ( uint_fast8_t lSlot = 0; lSlot < TRANSIENT_SLOTS; lSlot++ )
   {
-    /* Redraw the sky in this colour. */
-    this->mGraphics->set_depth( 0 );
-    this->mGraphics->set_pen( 
-      pimoroni::RGB::from_hsv(
-        lCurrentColour->h,
-        lCurrentColour->s,
-        lCurrentColour->v
-      ).to_rgb555()
+    lCount = this->mTransients.erase( lSlot, &lPixels );
+    for ( uint_fast8_t lIndex = 0; lIndex < lCount; lIndex++ )
+    {
+      this->restore_sky( lPixels[lIndex], lSkyPen );
+    }
+  }
+
+  /* Then draw everything that's running. */
+  lMark = this->mArena->mark();
+  lFound = (const primitive_t **)this->mArena->alloc( sizeof( const primitive_t * ) );
+  for ( uint_fast8_t lSlot = 0; ( lFound != nullptr ) && ( lSlot < TRANSIENT_SLOTS ); lSlot++ )
+  {
+    lEffect = &this->mEffects[lSlot];
+    if ( lEffect->type == SKY_EFFECT_NONE )
+    {
+      continue;
+    }
+
+    /* A shooting star trails a tail behind it, fading out; a satellite is a dot. */
+    lLength = ( lEffect->type == SKY_EFFECT_METEOR ) ? METEOR_TAIL : 1;
+    lStride = abs( lEffect->step.x ) > abs( lEffect->step.y ) ? abs( lEffect->step.x ) : abs( lEffect->step.y );
+
+    /* Skip it if there's a tree anywhere near. */
+    pimoroni::Point lTail( lEffect->location.x - lEffect->step.x * ( lLength - 1 ) / lStride,
+                           lEffect->location.y - lEffect->step.y * ( lLength - 1 ) / lStride );
+    pimoroni::Rect lBounds(
+      lTail.x < lEffect->location.x ? lTail.x : lEffect->location.x,
+      lTail.y < lEffect->location.y ? lTail.y : lEffect->location.y,
+      abs( lTail.x - lEffect->location.x ) + 1, abs( lTail.y - lEffect->location.y ) + 1
     );
-    this->mGraphics->rectangle( pimoroni::Rect( 0, 0, SCREEN_WIDTH, GROUND_LEVEL ) );
+    if ( this->mIndex->query( lBounds, lFound, 1 ) > 0 )
+    {
+      continue;
+    }
 
-    /* If it's night time, drop in some random, but repeatedly random, stars. */
-    float lMoonHeight = 0.0f - sin(this->mTimeOfDay*3.14159f/1800.0f);
-    if ( lMoonHeight > 0.0f )
+    /* Everything else, one pixel at a time; the head is brightest. */
+    for ( uint_fast8_t lIndex = 0; lIndex < lLength; lIndex++ )
     {
-      this->mGraphics->set_pen( 255.0f*lMoonHeight, 255.0f*lMoonHeight, 255.0f*lMoonHeight );
-      srand( 42 );
-      for ( uint_fast8_t lIndex = 0; lIndex < 100; lIndex++ )
+      lPixel.x = lEffect->location.x - lEffect->step.x * lIndex / lStride;
+      lPixel.y = lEffect->location.y - lEffect->step.y * lIndex / lStride;
+      if ( ( lPixel.x < this->mCamera ) || ( lPixel.x >= this->mCamera + SCREEN_WIDTH ) ||
+           ( lPixel.y < TITLE_HEIGHT ) || ( !this->mTransients.record( lSlot, lPixel ) ) )
+      {
+        continue;
+      }
+      lBrightness = ( lEffect->type == SKY_EFFECT_METEOR ) ? 255 - lIndex * 20 : 200;
+      if ( lEffect->age + 4 > lEffect->life )
       {
-        this->mGraphics->set_pixel( pimoroni::Point( rand()%SCREEN_WIDTH, rand()%GROUND_LEVEL ) );
+        lBrightness /= 2;
       }
+      this->mQueue->set_pen( lBrightness, lBrightness, lBrightness );
+      this->mQueue->pixel( pimoroni::Point( this->frame_column( lPixel.x ), lPixel.y ) );
     }
+  }
+  this->mArena->release( lMark );
 
-    /* And remember that it's changed. */
-    memcpy( &this->mSkyFG, lCurrentColour, sizeof( hsv_t ) );
-    this->mRedrawForestFG = this->mRedrawForestBG = true;
-    this->mRedrawSkyFG = false;
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render; called each frame to render the current state of the world. As we're
+ *         double buffered, we are always drawing on the *previous* frame
+ *         content - ideally we don't want to waste cycles blanking the whole
+ *         frame every time if we can think our way around it.
+ */
+
+void World::render( void )
+{
+  const hsv_t *lGroundColour, *lSkyColour;
+  uint8_t      lStars;
+  uint16_t     lReasons = 0;
+
+  /* Work out what colours the ground, sky and stars should be. */
+  lGroundColour = this->ground_colour();
+  lSkyColour = this->sky_colour();
+  lStars = this->star_level();
+
+  /*
+   * If any of those have stepped since this buffer was drawn, or the camera
+   * has moved by more than a screen, we need to repaint the whole view.
+   */
+  if ( this->mRedrawSkyFG )
+  {
+    lReasons |= REDRAW_SKY;
   }
+  if ( ( !this->same_colour( lGroundColour, &this->mGroundFG ) ) ||
+       ( !this->same_colour( lSkyColour, &this->mSkyFG ) ) )
+  {
+    lReasons |= REDRAW_COLOUR;
+  }
+  if ( lStars != this->mStarsFG )
+  {
+    lReasons |= REDRAW_STARS;
+  }
+  if ( abs( this->mCamera - this->mCameraFG ) >= SCREEN_WIDTH )
+  {
+    lReasons |= REDRAW_CAMERA;
+  }
+  this->mReasons |= lReasons;
+
+  if ( lReasons != 0 )
+  {
+    /* Remember the colours we're painting with. */
+    memcpy( &this->mGroundFG, lGroundColour, sizeof( hsv_t ) );
+    memcpy( &this->mSkyFG, lSkyColour, sizeof( hsv_t ) );
+    this->mStarsFG = lStars;
+
+    /* The title band doesn't scroll, so that gets painted on its own. */
+    this->mQueue->set_depth( 0 );
+    this->mQueue->set_pen( 
+      pimoroni::RGB::from_hsv( this->mSkyFG.h, this->mSkyFG.s, this->mSkyFG.v ).to_rgb555()
+    );
+    this->mQueue->rectangle( pimoroni::Rect( 0, 0, SCREEN_WIDTH, TITLE_HEIGHT ) );
+    this->mClock->invalidate();
+
+    /* And then the whole view, forest and all. */
+    this->render_columns( this->mCamera, SCREEN_WIDTH, TITLE_HEIGHT, SCREEN_HEIGHT - TITLE_HEIGHT, true );
+    this->mRedrawSkyFG = this->mRedrawForestFG = false;
+    this->mDamageCountFG = 0;
+  }
+  else if ( this->mCamera > this->mCameraFG )
+  {
+    /* Panning right, so only the columns exposed on the right need drawing. */
+    this->render_columns( this->mCameraFG + SCREEN_WIDTH, this->mCamera - this->mCameraFG,
+                          TITLE_HEIGHT, SCREEN_HEIGHT - TITLE_HEIGHT, true );
+  }
+  else if ( this->mCamera < this->mCameraFG )
+  {
+    /* Or the same on the left. */
+    this->render_columns( this->mCamera, this->mCameraFG - this->mCamera,
+                          TITLE_HEIGHT, SCREEN_HEIGHT - TITLE_HEIGHT, true );
+  }
+  this->mCameraFG = this->mCamera;
+
+  /* Repaint any damaged areas, or at least the parts of them still in view. */
+  if ( this->mDamageCountFG > 0 )
+  {
+    this->mReasons |= REDRAW_DAMAGE;
+  }
+  for ( uint_fast8_t lDamage = 0; lDamage < this->mDamageCountFG; lDamage++ )
+  {
+    pimoroni::Rect lArea = this->mDamageFG[lDamage].area.intersection(
+      pimoroni::Rect( this->mCamera, 0, SCREEN_WIDTH, SCREEN_HEIGHT )
+    );
+    if ( !lArea.empty() )
+    {
+      this->render_columns( lArea.x, lArea.w, lArea.y, lArea.h, this->mDamageFG[lDamage].background );
+    }
+  }
+  this->mDamageCountFG = 0;
+
+  /* Growing trees only draw what they've added since this buffer last saw them. */
+  this->render_growth();
 
   /*
-   * Now the title bar, which runs along the top of the screen - first we
-   * need to blank what's there.
+   * Now the title bar, which runs along the top of the screen; the tiles are
+   * sprites, so it's just a matter of moving them. A tile that scrolls off
+   * gives its slot up to the next one along.
    */
-  this->mGraphics->set_pen( 
-    pimoroni::RGB::from_hsv( this->mSkyFG.h, this->mSkyFG.s, this->mSkyFG.v ).to_rgb555()
-  );
-  this->mGraphics->set_depth( 0 );
-  this->mGraphics->rectangle(
-    pimoroni::Rect( this->mTitleOffset-1, 1, this->mTitleLength+2, 16 )
-  );
+  uint16_t lShown = 0;
+  for ( uint_fast8_t lTile = 0; lTile < this->mTitleTiles; lTile++ )
+  {
+    int32_t lTileX = this->mTitleOffset + lTile * TITLE_TILE_WIDTH;
+    if ( ( lTileX > -TITLE_TILE_WIDTH ) && ( lTileX < SCREEN_WIDTH ) )
+    {
+      this->mQueue->set_sprite( SPRITE_TITLE + lTile % this->mTitleSlots, SPRITE_TITLE + lTile,
+                                pimoroni::Point( lTileX, 1 ), pimoroni::DVDisplay::SpriteBlendMode::BLEND_NONE );
+      lShown |= 1 << ( lTile % this->mTitleSlots );
+    }
+  }
 
-  /* And then draw the text. */
-  this->mGraphics->set_pen( this->mWhitePen );
-  this->mGraphics->set_depth( 1 );
-  this->mGraphics->text( 
-    this->mTitleText, 
-    pimoroni::Point( this->mTitleOffset, 1 ),
-    SCREEN_WIDTH
-  );
+  /* Any slot in use last time this buffer was drawn, but not now, is cleared. */
+  for ( uint_fast8_t lSlot = 0; lSlot < this->mTitleSlots; lSlot++ )
+  {
+    if ( ( this->mTitleShownFG & ~lShown ) & ( 1 << lSlot ) )
+    {
+      this->mQueue->clear_sprite( SPRITE_TITLE + lSlot );
+    }
+  }
+  this->mTitleShownFG = lShown;
+
+  /* The clock sits in the corner of the title band, and only redraws digits that change. */
+  this->mClock->render( pimoroni::RGB::from_hsv( this->mSkyFG.h, this->mSkyFG.s, this->mSkyFG.v ).to_rgb555() );
+
+  /* Shooting stars go in before the trees, as they're behind them. */
+  this->render_effects();
 
   /* Trees, can be re-drawn in situ if we need to. */
   if ( this->mRedrawForestFG )
   {
-    this->mGraphics->set_depth( 1 );
-    for ( uint_fast8_t lIndex = 0; lIndex < TREES_MAX; lIndex++ )
-    {
-      if ( this->mForest[lIndex] != nullptr )
-      {
-        this->mForest[lIndex]->render( this->mTimeOfDay );
-      }
-    }
+    this->mReasons |= REDRAW_FOREST;
+    this->render_columns( this->mCamera, SCREEN_WIDTH, TITLE_HEIGHT, SCREEN_HEIGHT - TITLE_HEIGHT, false );
     this->mRedrawForestFG = false;
   }
 
+  /* Point the display at the right part of the frame. */
+  this->mQueue->setup_scroll_group(
+    pimoroni::Point( this->frame_column( this->mCamera ), 0 ), SCROLL_GROUP_WORLD, FRAME_WIDTH
+  );
+
   /* And put the sun and moon where it should be. */
-  this->mDisplay->set_sprite( SPRITE_SUN, SPRITE_SUN, this->mSunLocation );  
-  this->mDisplay->set_sprite( SPRITE_MOON, SPRITE_MOON, this->mMoonLocation );
+  /* A new moon phase needs uploading to each bank in turn, once. */
+  if ( this->mMoonPhaseFG != this->mMoonPhase )
+  {
+    this->mQueue->define_sprite( SPRITE_MOON, MOON_SIZE, MOON_SIZE, this->mMoonSprite );
+    this->mMoonPhaseFG = this->mMoonPhase;
+  }
 
-  /* And the clouds, if it's active. */
-  if ( this->mCloudActive )
+  this->mQueue->set_sprite( SPRITE_SUN, SPRITE_SUN, this->mSunLocation );  
+  this->mQueue->set_sprite( SPRITE_MOON, SPRITE_MOON, this->mMoonLocation );
+
+  /* Each with its glow around it; a quarter in each tile, centred on the body. */
+  for ( uint_fast8_t lTile = 0; ( this->mHalos ) && ( lTile < 4 ); lTile++ )
   {
-    this->mDisplay->set_sprite( SPRITE_CLOUDL, SPRITE_CLOUDL, this->mCloudLocation );
-    this->mDisplay->set_sprite(
+    pimoroni::Point lQuarter( ( lTile & 1 ) * HALO_TILE_SIZE - 16, ( lTile >> 1 ) * HALO_TILE_SIZE - 16 );
+    this->mQueue->set_sprite( SPRITE_HALO_SUN + lTile, SPRITE_HALO_SUN + lTile, this->mSunLocation + lQuarter,
+                              pimoroni::DVDisplay::SpriteBlendMode::BLEND_BLEND );
+
+    /* A new moon has nothing to glow, though. */
+    if ( this->mMoonPhase == 0 )
+    {
+      this->mQueue->clear_sprite( SPRITE_HALO_MOON + lTile );
+    }
+    else
+    {
+      this->mQueue->set_sprite( SPRITE_HALO_MOON + lTile, SPRITE_HALO_MOON + lTile, this->mMoonLocation + lQuarter,
+                                pimoroni::DVDisplay::SpriteBlendMode::BLEND_BLEND );
+    }
+  }
+
+  /* And the clouds, if it's active and in view. */
+  pimoroni::Point lCloudLocation = this->mCloudLocation - pimoroni::Point( this->mCamera, 0 );
+  if ( ( this->mCloudActive ) && ( lCloudLocation.x > -64 ) && ( lCloudLocation.x < SCREEN_WIDTH ) )
+  {
+    this->mQueue->set_sprite( SPRITE_CLOUDL, SPRITE_CLOUDL, lCloudLocation );
+    this->mQueue->set_sprite(
       SPRITE_CLOUDR, SPRITE_CLOUDR, 
-      this->mCloudLocation + pimoroni::Point( 32, 0 )
+      lCloudLocation + pimoroni::Point( 32, 0 )
     );
   }
+  else
+  {
+    this->mQueue->clear_sprite( SPRITE_CLOUDL );
+    this->mQueue->clear_sprite( SPRITE_CLOUDR );
+  }
 
   /* See also: bird. */
-  if ( this->mBirdActive )
+  pimoroni::Point lBirdLocation = this->mBirdLocation - pimoroni::Point( this->mCamera, 0 );
+  if ( ( this->mBirdActive ) && ( lBirdLocation.x > -32 ) && ( lBirdLocation.x < SCREEN_WIDTH ) )
   {
     /* Work out a suitable frame offset. */
     uint_fast8_t lFrame = abs( ( this->mBirdLocation.x / 2 ) % 3 );
-    this->mDisplay->set_sprite( SPRITE_BIRD, SPRITE_BIRD+lFrame, this->mBirdLocation,
+    this->mQueue->set_sprite( SPRITE_BIRD, SPRITE_BIRD+lFrame, lBirdLocation,
                                 pimoroni::DVDisplay::SpriteBlendMode::BLEND_NONE );
   }
+  else
+  {
+    this->mQueue->clear_sprite( SPRITE_BIRD );
+  }
 
   /* All done. */
   return;
@@ -14,7 +14,64 @@
 #include "libraries/pico_graphics/pico_graphics_dv.hpp"
 
 #include "arborescence.hpp"
+#include "renderqueue.hpp"
+#include "arena.hpp"
+#include "offscreen.hpp"
+#include "spatial.hpp"
+#include "pattern.hpp"
 #include "tree.hpp"
+#include "landscape.hpp"
+#include "transient.hpp"
+#include "overlay.hpp"
+#include "recorder.hpp"
+
+
+/* Constants. */
+
+#define DAMAGE_MAX    8
+#define RECALL_AHEAD  16      /* Columns past the view whose trees get their canopies back early. */
+
+#define SKY_EFFECT_NONE       0
+#define SKY_EFFECT_METEOR     1
+#define SKY_EFFECT_SATELLITE  2
+#define METEOR_TAIL           10
+#define METEOR_CHANCE         240     /* One in this many frames, at night. */
+#define SATELLITE_CHANCE      1800
+#define SKY_EFFECT_FLOOR      ( GROUND_TOP / 2 )
+
+#define TITLE_TILE_WIDTH  32
+#define TITLE_TILE_HEIGHT 16
+#define TITLE_TILES_MAX   12
+
+/* Why a frame drew more than the columns it scrolled; for the flight recorder. */
+#define REDRAW_SKY        0x0001    /* Invalidated, or out of room for damage. */
+#define REDRAW_COLOUR     0x0002    /* The sky or ground stepped to a new colour. */
+#define REDRAW_STARS      0x0004
+#define REDRAW_CAMERA     0x0008    /* The camera jumped more than a screen. */
+#define REDRAW_FOREST     0x0010
+#define REDRAW_DAMAGE     0x0020
+#define REDRAW_GROWTH     0x0040
+#define REDRAW_STARVED    0x0080    /* The arena ran dry, so the trees go again. */
+#define REDRAW_DECAY      0x0100    /* A visible tree faded or shed a branch. */
+#define REDRAW_DEATH      0x0200
+#define REDRAW_SPAWN      0x0400
+
+
+/* Structures. */
+
+typedef struct
+{
+  pimoroni::Rect  area;             /* In world coordinates. */
+  bool            background;       /* Or just redraw the trees in it. */
+} damage_t;
+
+typedef struct
+{
+  uint8_t         type;
+  uint16_t        age, life;
+  pimoroni::Point location;         /* In world coordinates. */
+  pimoroni::Point step;             /* How far it moves each frame. */
+} sky_effect_t;
 
 
 /* Class declaration. */
@@ -24,10 +81,19 @@ class World
 private:
   pimoroni::DVDisplay                  *mDisplay;
   pimoroni::PicoGraphics_PenDV_RGB555  *mGraphics;
+  RenderQueue                          *mQueue;
+  FrameArena                           *mArena;
+  OffscreenHeap                        *mOffscreen;
+  ClockOverlay                         *mClock;
   pimoroni::Pen                         mBlackPen;
   pimoroni::Pen                         mWhitePen;
 
   pimoroni::Point                       mSunLocation, mMoonLocation;
+  bool                                  mHalos;
+  uint_fast8_t                          mMoonPhase, mMoonPhaseFG, mMoonPhaseBG;
+  uint16_t                              mMoonSprite[MOON_SIZE*MOON_SIZE];
+
+  int32_t                               mCamera, mCameraFG, mCameraBG;
 
   pimoroni::Point                       mCloudLocation;
   bool                                  mCloudActive;
@@ -36,27 +102,59 @@ private:
 
   int_fast16_t  mTitleLength;
   int_fast16_t  mTitleOffset;
+  uint_fast8_t  mTitleTiles, mTitleSlots;
+  uint16_t      mTitleShownFG, mTitleShownBG;
   const char   *mTitleText = "~ ARBORESCENCE ~ AHNLAK ~";
 
   uint_fast16_t mTimeOfDay;
 
   hsv_t         mGroundFG, mGroundBG;
   hsv_t         mSkyFG, mSkyBG;
+  uint8_t       mStarsFG, mStarsBG;
+
+  hsv_t         mGroundPensColour;
+  uint16_t      mGroundPens[SCREEN_HEIGHT-GROUND_TOP];
 
   bool          mRedrawSkyFG, mRedrawSkyBG;
   bool          mRedrawForestFG, mRedrawForestBG;
 
-  Tree         *mForest[TREES_MAX];
+  damage_t        mDamageFG[DAMAGE_MAX], mDamageBG[DAMAGE_MAX];
+  uint_fast8_t    mDamageCountFG, mDamageCountBG;
+
+  Landscape          *mLandscape;
+  SpatialIndex       *mIndex;
+  PatternLibrary     *mPatterns;
+  bool                mStarved;
+  uint16_t            mReasons;
+
+  sky_effect_t        mEffects[TRANSIENT_SLOTS];
+  TransientLog        mTransients;
 
   const hsv_t  *ground_colour( void );
   const hsv_t  *sky_colour( void );
+  uint8_t       star_level( void );
+  bool          same_colour( const hsv_t *, const hsv_t * );
+  uint16_t     *build_title( void );
+
+  int32_t       frame_column( int32_t );
+  void          add_damage( const pimoroni::Rect &, bool );
+  void          render_columns( int32_t, int32_t, int32_t, int32_t, bool );
+  void          render_strip( int32_t, int32_t, int32_t, int32_t, int32_t, bool );
+  void          render_growth( void );
+  void          restore_sky( const pimoroni::Point &, uint16_t );
+  void          update_effects( void );
+  void          render_effects( void );
 
 public:
-                World( pimoroni::DVDisplay *, pimoroni::PicoGraphics_PenDV_RGB555 * );
+                World( pimoroni::DVDisplay *, pimoroni::PicoGraphics_PenDV_RGB555 *, RenderQueue *,
+                       FrameArena *, OffscreenHeap *, ClockOverlay * );
                ~World( void );
 
   void          update( void );
   void          render( void );
+  void          invalidate( void );
+  bool          heavy_ahead( void );
+  void          record( flight_frame_t * );
 };
 
 /* End of file world.hpp */